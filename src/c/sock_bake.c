@@ -0,0 +1,361 @@
+// sock-bake: Pre-decodes the images in a game's assets directory into atlas pages the runtime can
+// upload without decoding.
+//
+// Usage:
+//   sock-bake [--page-size=n] <assets dir>
+//
+// Writes [.bake/] inside the assets directory:
+//   index.txt    "sock-bake <version> <page size> <page count>", then one line per image, sorted by
+//                path: "<page>\t<x>\t<y>\t<width>\t<height>\t<file size>\t<mtime>\t<path>". Paths are
+//                relative to the assets directory, separated with '/'. The file size and last write time
+//                (seconds since the Unix epoch) let the runtime skip images changed since baking.
+//   page<n>.rgba [BAKE_HEADER_SIZE] byte header ("SKBP", version, width, height as little endian
+//                uint32s) followed by raw RGBA pixels.
+//
+// Images are packed with the runtime's skyline packer (see [sock_skyline.h]), with a border of extruded
+// edge pixels like its atlases. Images too large for a page are left to be decoded at load time.
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#if defined _WIN32_ || defined _WIN32 || defined WIN32
+
+	#include <windows.h>
+	#include <direct.h>
+	#include <sys/stat.h>
+
+	#define mkdir(path) _mkdir(path)
+	#define strdup _strdup
+
+#else
+
+	#include <dirent.h>
+	#include <sys/stat.h>
+
+	#define mkdir(path) mkdir(path, 0755)
+
+#endif
+
+#define STBI_NO_PSD
+#define STBI_NO_TGA
+#define STBI_NO_HDR
+#define STBI_NO_PIC
+#define STBI_NO_PNM
+#define STB_IMAGE_IMPLEMENTATION
+#define STBI_FAILURE_USERMSG
+#include "stb_image.h"
+
+#include "sock_skyline.h"
+
+// Must match the runtime.
+#define BAKE_VERSION 2
+#define BAKE_HEADER_SIZE 16
+#define BAKE_PADDING 1
+
+#define DEFAULT_PAGE_SIZE 2048
+
+typedef struct {
+	char* path;
+	uint32_t* pixels;
+	int64_t fileSize;
+	int64_t fileTime;
+	int width;
+	int height;
+	int page;
+	int x;
+	int y;
+} Image;
+
+static Image* images = NULL;
+static int imageCount = 0;
+static int imageCapacity = 0;
+
+static Skyline* pages = NULL;
+static int pageCount = 0;
+static int pageSize = DEFAULT_PAGE_SIZE;
+
+// IMAGES
+
+bool isImagePath(const char* path) {
+	const char* ext = strrchr(path, '.');
+	if (!ext) return false;
+
+	const char* exts[] = { ".png", ".jpg", ".jpeg", ".gif", ".bmp" };
+	for (int i = 0; i < 5; i++) {
+		#if defined _WIN32
+			if (_stricmp(ext, exts[i]) == 0) return true;
+		#else
+			if (strcasecmp(ext, exts[i]) == 0) return true;
+		#endif
+	}
+
+	return false;
+}
+
+void addImage(const char* root, const char* path) {
+	char fullPath[4096];
+	snprintf(fullPath, sizeof(fullPath), "%s/%s", root, path);
+
+	// Recorded so the runtime can tell if the image changed since.
+	struct stat st;
+	if (stat(fullPath, &st) != 0) {
+		fprintf(stderr, "skipped %s: can't read file info\n", path);
+		return;
+	}
+
+	int width, height, channelCount;
+	stbi_uc* pixels = stbi_load(fullPath, &width, &height, &channelCount, 4);
+	if (!pixels) {
+		fprintf(stderr, "skipped %s: %s\n", path, stbi_failure_reason());
+		return;
+	}
+
+	if (width + 2 * BAKE_PADDING > pageSize || height + 2 * BAKE_PADDING > pageSize) {
+		fprintf(stderr, "skipped %s: larger than a page\n", path);
+		stbi_image_free(pixels);
+		return;
+	}
+
+	if (imageCount == imageCapacity) {
+		imageCapacity = imageCapacity == 0 ? 64 : imageCapacity * 2;
+		images = realloc(images, imageCapacity * sizeof(Image));
+		if (!images) {
+			fprintf(stderr, "out of memory\n");
+			exit(1);
+		}
+	}
+
+	Image* img = &images[imageCount++];
+	img->path = strdup(path);
+	img->pixels = (uint32_t*)pixels;
+	img->fileSize = (int64_t)st.st_size;
+	img->fileTime = (int64_t)st.st_mtime;
+	img->width = width;
+	img->height = height;
+}
+
+// Adds the images in [root]/[dir] and its sub directories. [dir] is "" or ends with '/'.
+void walk(const char* root, const char* dir) {
+	char path[4096];
+
+	#if defined _WIN32
+
+		char pattern[4096];
+		snprintf(pattern, sizeof(pattern), "%s/%s*", root, dir);
+
+		WIN32_FIND_DATAA data;
+		HANDLE find = FindFirstFileA(pattern, &data);
+		if (find == INVALID_HANDLE_VALUE) return;
+
+		do {
+			const char* name = data.cFileName;
+			if (name[0] == '.') continue;
+
+			if (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) {
+				snprintf(path, sizeof(path), "%s%s/", dir, name);
+				walk(root, path);
+			} else if (isImagePath(name)) {
+				snprintf(path, sizeof(path), "%s%s", dir, name);
+				addImage(root, path);
+			}
+		} while (FindNextFileA(find, &data));
+
+		FindClose(find);
+
+	#else
+
+		char dirPath[4096];
+		snprintf(dirPath, sizeof(dirPath), "%s/%s", root, dir);
+
+		DIR* d = opendir(dirPath);
+		if (!d) return;
+
+		struct dirent* entry;
+		while ((entry = readdir(d)) != NULL) {
+			const char* name = entry->d_name;
+			if (name[0] == '.') continue;
+
+			char fullPath[4096];
+			if (snprintf(fullPath, sizeof(fullPath), "%s%s", dirPath, name) >= (int)sizeof(fullPath)) continue;
+
+			struct stat st;
+			if (stat(fullPath, &st) != 0) continue;
+
+			if (S_ISDIR(st.st_mode)) {
+				snprintf(path, sizeof(path), "%s%s/", dir, name);
+				walk(root, path);
+			} else if (S_ISREG(st.st_mode) && isImagePath(name)) {
+				snprintf(path, sizeof(path), "%s%s", dir, name);
+				addImage(root, path);
+			}
+		}
+
+		closedir(d);
+
+	#endif
+}
+
+int compareImageHeight(const void* a, const void* b) {
+	const Image* ia = (const Image*)a;
+	const Image* ib = (const Image*)b;
+	if (ia->height != ib->height) return ib->height - ia->height;
+	return ib->width - ia->width;
+}
+
+int compareImagePath(const void* a, const void* b) {
+	return strcmp(((const Image*)a)->path, ((const Image*)b)->path);
+}
+
+// PACKING
+
+void pack() {
+	// Tallest first packs tighter.
+	qsort(images, imageCount, sizeof(Image), compareImageHeight);
+
+	for (int i = 0; i < imageCount; i++) {
+		Image* img = &images[i];
+		int width = img->width + 2 * BAKE_PADDING;
+		int height = img->height + 2 * BAKE_PADDING;
+
+		int p = 0;
+		while (p < pageCount && !skylineInsert(&pages[p], width, height, &img->x, &img->y)) p++;
+
+		if (p == pageCount) {
+			pages = realloc(pages, (pageCount + 1) * sizeof(Skyline));
+			if (!pages || !skylineInit(&pages[pageCount], pageSize)) {
+				fprintf(stderr, "out of memory\n");
+				exit(1);
+			}
+
+			pageCount++;
+
+			skylineInsert(&pages[p], width, height, &img->x, &img->y);
+		}
+
+		img->page = p;
+		img->x += BAKE_PADDING;
+		img->y += BAKE_PADDING;
+	}
+}
+
+// OUTPUT
+
+void writeUint32(uint8_t* out, uint32_t n) {
+	out[0] = n & 0xff;
+	out[1] = (n >> 8) & 0xff;
+	out[2] = (n >> 16) & 0xff;
+	out[3] = (n >> 24) & 0xff;
+}
+
+bool writePage(const char* root, int p) {
+	size_t pixelCount = (size_t)pageSize * pageSize;
+	uint32_t* pixels = calloc(pixelCount, 4);
+	if (!pixels) return false;
+
+	for (int i = 0; i < imageCount; i++) {
+		Image* img = &images[i];
+		if (img->page != p) continue;
+
+		// Copy with the edges extruded into the padding.
+		for (int py = -BAKE_PADDING; py < img->height + BAKE_PADDING; py++) {
+			int sy = py < 0 ? 0 : (py >= img->height ? img->height - 1 : py);
+			const uint32_t* src = img->pixels + (size_t)sy * img->width;
+			uint32_t* dst = pixels + (size_t)(img->y + py) * pageSize + img->x;
+
+			for (int px = 1; px <= BAKE_PADDING; px++) {
+				dst[-px] = src[0];
+				dst[img->width - 1 + px] = src[img->width - 1];
+			}
+			memcpy(dst, src, (size_t)img->width * 4);
+		}
+	}
+
+	char path[4096];
+	snprintf(path, sizeof(path), "%s/.bake/page%d.rgba", root, p);
+
+	FILE* file = fopen(path, "wb");
+	if (!file) {
+		free(pixels);
+		return false;
+	}
+
+	uint8_t header[BAKE_HEADER_SIZE];
+	memcpy(header, "SKBP", 4);
+	writeUint32(header + 4, BAKE_VERSION);
+	writeUint32(header + 8, pageSize);
+	writeUint32(header + 12, pageSize);
+
+	bool ok = fwrite(header, 1, BAKE_HEADER_SIZE, file) == BAKE_HEADER_SIZE && fwrite(pixels, 4, pixelCount, file) == pixelCount;
+	ok = fclose(file) == 0 && ok;
+
+	free(pixels);
+	return ok;
+}
+
+bool writeIndex(const char* root) {
+	qsort(images, imageCount, sizeof(Image), compareImagePath);
+
+	char path[4096];
+	snprintf(path, sizeof(path), "%s/.bake/index.txt", root);
+
+	FILE* file = fopen(path, "wb");
+	if (!file) return false;
+
+	fprintf(file, "sock-bake %d %d %d\n", BAKE_VERSION, pageSize, pageCount);
+	for (int i = 0; i < imageCount; i++) {
+		Image* img = &images[i];
+		fprintf(file, "%d\t%d\t%d\t%d\t%d\t%lld\t%lld\t%s\n", img->page, img->x, img->y, img->width, img->height, (long long)img->fileSize, (long long)img->fileTime, img->path);
+	}
+
+	return fclose(file) == 0;
+}
+
+int main(int argc, char** argv) {
+	const char* root = NULL;
+
+	for (int i = 1; i < argc; i++) {
+		if (strncmp(argv[i], "--page-size=", 12) == 0) {
+			pageSize = atoi(argv[i] + 12);
+			if (pageSize < 64) {
+				fprintf(stderr, "page size must be at least 64\n");
+				return 1;
+			}
+		} else if (argv[i][0] == '-') {
+			fprintf(stderr, "unknown option %s\n", argv[i]);
+			return 1;
+		} else {
+			root = argv[i];
+		}
+	}
+
+	if (!root) {
+		fprintf(stderr, "usage: sock-bake [--page-size=n] <assets dir>\n");
+		return 1;
+	}
+
+	walk(root, "");
+	pack();
+
+	char dir[4096];
+	snprintf(dir, sizeof(dir), "%s/.bake", root);
+	mkdir(dir);
+
+	for (int p = 0; p < pageCount; p++) {
+		if (!writePage(root, p)) {
+			fprintf(stderr, "failed to write page %d\n", p);
+			return 1;
+		}
+	}
+
+	if (!writeIndex(root)) {
+		fprintf(stderr, "failed to write index\n");
+		return 1;
+	}
+
+	printf("baked %d images into %d pages of %dx%d\n", imageCount, pageCount, pageSize, pageSize);
+
+	return 0;
+}
@@ -5,7 +5,17 @@
 #include <stdint.h>
 #include "wren.h"
 
-#if defined _WIN32_ || defined _WIN32 || defined WIN32
+// Emscripten is checked first, as some versions define __linux__ too.
+#if defined __EMSCRIPTEN__
+
+	#define SOCK_WEB
+	#define SOCK_PLATFORM "web"
+
+	#include "emscripten.h"
+
+	#define _strdup strdup
+
+#elif defined _WIN32_ || defined _WIN32 || defined WIN32
 
 	#define SOCK_DESKTOP
 	#define SOCK_WIN
@@ -25,19 +35,54 @@
    	#include "stb_image.h"
 	#include <windows.h>
 	#include "sock_audio.h"
+	#include "sock_skyline.h"
 	#include <time.h>
 
-#elif defined __EMSCRIPTEN__
+#elif defined __linux__ || defined __APPLE__
 
-	#define SOCK_WEB
-	#define SOCK_PLATFORM "web"
+	#define SOCK_DESKTOP
+	#define SOCK_POSIX
+	#define SOCK_PLATFORM "desktop"
+	#ifdef __APPLE__
+		#define SOCK_OS "macos"
+	#else
+		#define SOCK_OS "linux"
+	#endif
 
-	#include "emscripten.h"
+	#include <stdlib.h>
+	#include "SDL2/SDL.h"
+	#include "glad/gl.h"
+	#define STBI_NO_STDIO
+	#define STBI_NO_PSD
+	#define STBI_NO_TGA
+	#define STBI_NO_HDR
+	#define STBI_NO_PIC
+	#define STBI_NO_PNM
+	#define STB_IMAGE_IMPLEMENTATION
+	#define STBI_FAILURE_USERMSG
+   	#include "stb_image.h"
+	#include <unistd.h>
+	#include <sys/stat.h>
+	#include <sys/mman.h>
+	#include <fcntl.h>
+	#include "sock_audio.h"
+	#include "sock_skyline.h"
+	#include <time.h>
 
+	// Provided by <windows.h> on Windows.
 	#define _strdup strdup
+	#define _time64 time
+	#define min(a, b) (((a) < (b)) ? (a) : (b))
+	#define max(a, b) (((a) > (b)) ? (a) : (b))
 
 #endif
 
+// SSE2 is part of every x64 target, other targets use scalar code.
+#if defined __SSE2__ || defined _M_X64 || (defined _M_IX86_FP && _M_IX86_FP >= 2)
+	#define SOCK_SSE2
+	#include <emmintrin.h>
+#endif
+
 #define TAU 6.28318530717958647692528676655900577
 
 typedef struct {
@@ -364,6 +409,15 @@ typedef struct
 	void* data;
 } Buffer;
 
+// Puts Buffer class handle in slot 0.
+void buffer_putClassHandle(WrenVM* vm) {
+	if (handle_Buffer) {
+		wrenSetSlotHandle(vm, 0, handle_Buffer);
+	} else {
+		handle_Buffer = wrenGetVariableHandle("sock", "Buffer");
+	}
+}
+
 uint32_t wren_buffer_validateLength(WrenVM* vm, int slot) {
 	if (wrenGetSlotType(vm, slot) != WREN_TYPE_NUM) {
 		wrenAbort(vm, "Buffer size must be a number");
@@ -498,6 +552,60 @@ void wren_buffer_uint8_iterate(WrenVM* vm) {
 	}
 }
 
+// 32-bit word accessors, indices are in words so a Buffer can be used as a packed float32/uint32
+// array (see Sprite.drawBuffer).
+
+void wren_buffer_wordCount(WrenVM* vm) {
+	wrenSetSlotDouble(vm, 0, ((Buffer*)wrenGetSlotForeign(vm, 0))->length / 4);
+}
+
+void wren_buffer_float32_get(WrenVM* vm) {
+	Buffer* buffer = (Buffer*)wrenGetSlotForeign(vm, 0);
+
+	uint32_t index = wren_validateIndex(vm, buffer->length / 4, 1);
+	if (index == UINT32_MAX) return;
+
+	wrenSetSlotDouble(vm, 0, ((float*)buffer->data)[index]);
+}
+
+void wren_buffer_float32_set(WrenVM* vm) {
+	Buffer* buffer = (Buffer*)wrenGetSlotForeign(vm, 0);
+
+	uint32_t index = wren_validateIndex(vm, buffer->length / 4, 1);
+	if (index == UINT32_MAX) return;
+
+	if (wren_buffer_validateValue(vm, 2)) return;
+
+	((float*)buffer->data)[index] = (float)wrenGetSlotDouble(vm, 2);
+}
+
+void wren_buffer_uint32_get(WrenVM* vm) {
+	Buffer* buffer = (Buffer*)wrenGetSlotForeign(vm, 0);
+
+	uint32_t index = wren_validateIndex(vm, buffer->length / 4, 1);
+	if (index == UINT32_MAX) return;
+
+	wrenSetSlotDouble(vm, 0, ((uint32_t*)buffer->data)[index]);
+}
+
+void wren_buffer_uint32_set(WrenVM* vm) {
+	Buffer* buffer = (Buffer*)wrenGetSlotForeign(vm, 0);
+
+	uint32_t index = wren_validateIndex(vm, buffer->length / 4, 1);
+	if (index == UINT32_MAX) return;
+
+	if (wren_buffer_validateValue(vm, 2)) return;
+
+	// Casting anything outside the range to uint32_t is undefined.
+	double value = wrenGetSlotDouble(vm, 2);
+	if (!(value >= 0 && value <= UINT32_MAX)) {
+		wrenAbort(vm, "value must be between 0 and 0xffffffff");
+		return;
+	}
+
+	((uint32_t*)buffer->data)[index] = (uint32_t)value;
+}
+
 void wren_buffer_toString(WrenVM* vm) {
 	Buffer* buffer = (Buffer*)wrenGetSlotForeign(vm, 0);
 
@@ -1208,6 +1316,11 @@ WrenForeignMethodFn wren_coreBindForeignMethod(WrenVM* vm, const char* moduleNam
 				if (strcmp(signature, "setByteAt(_,_)") == 0) return wren_buffer_uint8_set;
 				if (strcmp(signature, "fillBytes(_)") == 0) return wren_buffer_uint8_fill;
 				if (strcmp(signature, "iterateByte_(_)") == 0) return wren_buffer_uint8_iterate;
+				if (strcmp(signature, "wordCount") == 0) return wren_buffer_wordCount;
+				if (strcmp(signature, "floatAt(_)") == 0) return wren_buffer_float32_get;
+				if (strcmp(signature, "setFloatAt(_,_)") == 0) return wren_buffer_float32_set;
+				if (strcmp(signature, "uintAt(_)") == 0) return wren_buffer_uint32_get;
+				if (strcmp(signature, "setUintAt(_,_)") == 0) return wren_buffer_uint32_set;
 				if (strcmp(signature, "setFromString(_)") == 0) return wren_buffer_copyFromString;
 			}
 		} else if (strcmp(className, "Transform") == 0) {
@@ -1291,6 +1404,16 @@ const char* wren_resolveModule(WrenVM* vm, const char* importer, const char* nam
 	static GLuint mainFramebufferVertexArray;
 	static GLuint mainFramebufferTriangles;
 	static GLint mainFramebufferScaleFilter = GL_NEAREST;
+	// If the frame is drawn straight into the window, skipping [mainFramebuffer] and the scaling pass.
+	// Only with [mainFramebufferAllowDirect], for frames at 1:1 scale which follow a frame that started with
+	// a full Game.clear(), as the window's contents aren't kept between frames.
+	static bool mainFramebufferDirect = false;
+	// Set with "--present=direct", for games that start every frame with Game.clear().
+	// Off by default, as a frame that doesn't clear would draw over an undefined window, and be lost to
+	// the frames after it.
+	static bool mainFramebufferAllowDirect = false;
+	// Set with "--present=shader", always draw into [mainFramebuffer] and scale it with the shader pass.
+	static bool mainFramebufferAlwaysShader = false;
 
 	static int game_windowWidth = 400;
 	static int game_windowHeight = 300;
@@ -1309,9 +1432,32 @@ const char* wren_resolveModule(WrenVM* vm, const char* importer, const char* nam
 	static uint32_t game_printColor = 0xffffffffU;
 	static SDL_SystemCursor game_cursor = SDL_SYSTEM_CURSOR_ARROW;
 	static SDL_Cursor* game_sdl_cursor = NULL;
+	static bool game_headless = false;
+
+	// Swap interval as reported by SDL: 0 = off, 1 = vsync, -1 = adaptive vsync.
+	static int game_swapInterval = 1;
+
+	// Set with Game.redrawMode = "onDemand", frames then only run on events or when a redraw is due.
+	static bool game_redrawOnDemand = false;
+	// When the next frame is due in on demand mode, from [pacingNow()], INFINITY if none is.
+	// Set with Game.requestRedraw().
+	static double game_redrawAt = 0;
+
+	// Frame pacing state, in seconds, see [pacingWaitUntil()].
+	static double pacing_perfFrequency = 1.0;
+	static double pacing_displayPeriod = 1.0 / 60.0;
+	static double pacing_sleepTime = 0;
+	static double pacing_spinTime = 0;
+
+	// Benchmark mode, set with "--bench=N".
+	// When [bench_frameCount] is non-zero the game runs for that many frames with a fixed delta and no waiting,
+	// unless "--bench-paced" is given, in which case frames are paced and timed as normal.
+	static uint32_t bench_frameCount = 0;
+	static bool bench_paced = false;
+	static const char* bench_outPath = NULL;
+	static double* bench_frameTimes = NULL;
+	static double* bench_frameIntervals = NULL;
 
-	static WrenHandle* handle_Time = NULL;
-	static WrenHandle* handle_Input = NULL;
 	static WrenHandle* handle_Game = NULL;
 	static WrenHandle* handle_Game_arguments = NULL;
 
@@ -1319,7 +1465,125 @@ const char* wren_resolveModule(WrenVM* vm, const char* importer, const char* nam
 	static WrenHandle* callHandle_update_0 = NULL;
 	static WrenHandle* callHandle_update_2 = NULL;
 	static WrenHandle* callHandle_update_3 = NULL;
-	static WrenHandle* callHandle_updateMouse_3 = NULL;
+	static WrenHandle* callHandle_frame_5 = NULL;
+
+
+	// === MEMORY ===
+
+	// Small Wren allocations are served from per size class free lists, carved out of larger chunks.
+	// Wren only runs on the main thread, so the pools need no locking.
+	// Set with "--alloc=system" to use malloc/realloc for everything instead, for A/B comparisons.
+	static bool pool_enabled = true;
+
+	#define POOL_CLASS_COUNT 8
+	#define POOL_MAX_SIZE 256
+	#define POOL_CHUNK_SIZE (64 * 1024)
+
+	static const uint32_t POOL_CLASS_SIZES[POOL_CLASS_COUNT] = { 16, 32, 48, 64, 96, 128, 192, 256 };
+
+	// Size class for each allocation size, indexed by the size rounded up to 16 bytes, divided by 16.
+	static const uint8_t POOL_CLASS_BY_16[17] = { 0, 0, 1, 2, 3, 4, 4, 5, 5, 6, 6, 6, 6, 7, 7, 7, 7 };
+
+	typedef struct PoolBlock {
+		struct PoolBlock* next;
+	} PoolBlock;
+
+	static PoolBlock* pool_freeLists[POOL_CLASS_COUNT] = { NULL };
+
+	// Allocation stats.
+	static uint64_t pool_allocCount = 0;
+	static uint64_t pool_systemAllocCount = 0;
+	static uint64_t pool_chunkBytes = 0;
+
+	// Returns the size class for [size], or -1 if it's too big for the pools.
+	int poolClassOf(size_t size) {
+		return size <= POOL_MAX_SIZE ? POOL_CLASS_BY_16[(size + 15) >> 4] : -1;
+	}
+
+	// Allocates a block of [blockSize] bytes from size class [sizeClass].
+	// [blockSize] must be the same for every call with the same class.
+	void* poolAlloc(int sizeClass, size_t blockSize) {
+		PoolBlock* block = pool_freeLists[sizeClass];
+
+		if (!block) {
+			// Carve a new chunk into blocks.
+			char* chunk = (char*)malloc(POOL_CHUNK_SIZE);
+			if (!chunk) return NULL;
+
+			pool_chunkBytes += POOL_CHUNK_SIZE;
+
+			size_t count = POOL_CHUNK_SIZE / blockSize;
+			for (size_t i = 0; i < count; i++) {
+				PoolBlock* b = (PoolBlock*)(chunk + i * blockSize);
+				b->next = block;
+				block = b;
+			}
+		}
+
+		pool_freeLists[sizeClass] = block->next;
+		pool_allocCount++;
+
+		return block;
+	}
+
+	void poolFree(int sizeClass, void* memory) {
+		PoolBlock* block = (PoolBlock*)memory;
+		block->next = pool_freeLists[sizeClass];
+		pool_freeLists[sizeClass] = block;
+	}
+
+	// The frame arena hands out memory that lives until the end of the current frame, for engine temporaries.
+	// Allocations that don't fit (or all allocations when the pools are disabled) fall back to malloc,
+	// and are freed at the end of the frame too.
+	#define FRAME_ARENA_SIZE (256 * 1024)
+
+	static char* frameArena = NULL;
+	static size_t frameArena_used = 0;
+	static size_t frameArena_peak = 0;
+	static void** frameArena_overflow = NULL;
+	static uint32_t frameArena_overflowCount = 0;
+	static uint32_t frameArena_overflowCapacity = 0;
+
+	// Allocates [size] bytes that are freed at the end of the frame.
+	void* frameAlloc(size_t size) {
+		size = (size + 15) & ~(size_t)15;
+
+		if (pool_enabled) {
+			if (!frameArena) frameArena = (char*)malloc(FRAME_ARENA_SIZE);
+
+			if (frameArena && frameArena_used + size <= FRAME_ARENA_SIZE) {
+				void* result = frameArena + frameArena_used;
+				frameArena_used += size;
+				if (frameArena_used > frameArena_peak) frameArena_peak = frameArena_used;
+				return result;
+			}
+		}
+
+		if (frameArena_overflowCount == frameArena_overflowCapacity) {
+			uint32_t capacity = frameArena_overflowCapacity == 0 ? 16 : frameArena_overflowCapacity * 2;
+			void** overflow = (void**)realloc(frameArena_overflow, capacity * sizeof(void*));
+			if (!overflow) return NULL;
+
+			frameArena_overflow = overflow;
+			frameArena_overflowCapacity = capacity;
+		}
+
+		void* result = malloc(size);
+		if (result) {
+			frameArena_overflow[frameArena_overflowCount++] = result;
+		}
+
+		return result;
+	}
+
+	void frameArenaReset() {
+		for (uint32_t i = 0; i < frameArena_overflowCount; i++) {
+			free(frameArena_overflow[i]);
+		}
+
+		frameArena_overflowCount = 0;
+		frameArena_used = 0;
+	}
 
 
 	// === IO UTILS ==
@@ -1331,6 +1595,43 @@ const char* wren_resolveModule(WrenVM* vm, const char* importer, const char* nam
 
 			return attr != INVALID_FILE_ATTRIBUTES && !(attr & FILE_ATTRIBUTE_DIRECTORY);
 		
+		#elif defined SOCK_POSIX
+
+			struct stat st;
+
+			return stat(fileName, &st) == 0 && S_ISREG(st.st_mode);
+
+		#else
+
+			return false;
+
+		#endif
+	}
+
+	// Gets the size and last write time (in seconds since the Unix epoch) of [fileName].
+	bool fileStat(const char* fileName, int64_t* size, int64_t* mtime) {
+		#ifdef SOCK_WIN
+
+			WIN32_FILE_ATTRIBUTE_DATA data;
+			if (!GetFileAttributesExA(fileName, GetFileExInfoStandard, &data)) return false;
+
+			// FILETIMEs count 100ns intervals since 1601.
+			int64_t time = ((int64_t)data.ftLastWriteTime.dwHighDateTime << 32) | data.ftLastWriteTime.dwLowDateTime;
+			*size = ((int64_t)data.nFileSizeHigh << 32) | data.nFileSizeLow;
+			*mtime = time / 10000000 - 11644473600LL;
+
+			return true;
+
+		#elif defined SOCK_POSIX
+
+			struct stat st;
+			if (stat(fileName, &st) != 0) return false;
+
+			*size = st.st_size;
+			*mtime = st.st_mtime;
+
+			return true;
+
 		#else
 
 			return false;
@@ -1369,7 +1670,7 @@ const char* wren_resolveModule(WrenVM* vm, const char* importer, const char* nam
 
 			if (res == NULL) {
 				quitError = printBuffer;
-				snprintf(printBuffer, PRINT_BUFFER_SIZE, "alloc file memory %Id bytes %s", size, fileName);
+				snprintf(printBuffer, PRINT_BUFFER_SIZE, "alloc file memory %lld bytes %s", (long long)size, fileName);
 			} else {
 				// Read into buffer bit by bit.
 				Sint64 nb_read_total = 0;
@@ -1387,7 +1688,7 @@ const char* wren_resolveModule(WrenVM* vm, const char* importer, const char* nam
 					free(res);
 					res = NULL;
 					quitError = printBuffer;
-					snprintf(printBuffer, PRINT_BUFFER_SIZE, "only read %Id of %Id bytes from %s", nb_read_total, size, fileName);
+					snprintf(printBuffer, PRINT_BUFFER_SIZE, "only read %lld of %lld bytes from %s", (long long)nb_read_total, (long long)size, fileName);
 				} else {
 					// Null terminate.
 					res[nb_read_total] = '\0';
@@ -1410,7 +1711,7 @@ const char* wren_resolveModule(WrenVM* vm, const char* importer, const char* nam
 		int pathLen = (int)strlen(path);
 		int len = basePathLen + pathLen;
 
-		char* absPath = malloc(len + 1);
+		char* absPath = frameAlloc(len + 1);
 		if (absPath == NULL) {
 			quitError = printBuffer;
 			snprintf(printBuffer, PRINT_BUFFER_SIZE, "alloc memory %s", path);
@@ -1420,14 +1721,11 @@ const char* wren_resolveModule(WrenVM* vm, const char* importer, const char* nam
 			memcpy(absPath + basePathLen, path, pathLen);
 			absPath[len] = '\0';
 
-			char* result = fileRead(absPath, NULL);
-
-			free(absPath);
-
-			return result;
+			return fileRead(absPath, NULL);
 		}
 	}
 
+	// Returns the absolute path of an asset, allocated with [frameAlloc()].
 	char* resolveAssetPath(const char* path) {
 		bool startingSlash = path[0] == '/';
 
@@ -1435,7 +1733,7 @@ const char* wren_resolveModule(WrenVM* vm, const char* importer, const char* nam
 		int len = basePathLen + 6 + pathLen;
 		if (!startingSlash) len++;
 
-		char* absPath = malloc(len + 1);
+		char* absPath = frameAlloc(len + 1);
 		if (absPath == NULL) {
 			quitError = printBuffer;
 			snprintf(printBuffer, PRINT_BUFFER_SIZE, "alloc memory %s", path);
@@ -1460,16 +1758,81 @@ const char* wren_resolveModule(WrenVM* vm, const char* importer, const char* nam
 		char* absPath = resolveAssetPath(path);
 
 		if (absPath) {
-			char* result = fileRead(absPath, size);
-
-			free(absPath);
-
-			return result;
+			return fileRead(absPath, size);
 		} else {
 			return NULL;
 		}
 	}
 
+	// Maps the entire file into memory read only, to be released with [fileUnmap()].
+	// Falls back to reading the file where mapping isn't supported.
+	//
+	// Returns NULL on error.
+	void* fileMap(const char* fileName, int64_t* fileSize) {
+		#ifdef SOCK_WIN
+
+			HANDLE file = CreateFileA(fileName, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+			if (file == INVALID_HANDLE_VALUE) return NULL;
+
+			LARGE_INTEGER size;
+			void* data = NULL;
+
+			if (GetFileSizeEx(file, &size) && size.QuadPart > 0) {
+				HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+
+				if (mapping) {
+					// The view keeps the mapping open.
+					data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+					CloseHandle(mapping);
+				}
+			}
+
+			CloseHandle(file);
+
+			if (data) *fileSize = size.QuadPart;
+			return data;
+
+		#elif defined SOCK_POSIX
+
+			int fd = open(fileName, O_RDONLY);
+			if (fd < 0) return NULL;
+
+			struct stat st;
+			void* data = NULL;
+
+			if (fstat(fd, &st) == 0 && st.st_size > 0) {
+				data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+				if (data == MAP_FAILED) data = NULL;
+			}
+
+			close(fd);
+
+			if (data) *fileSize = st.st_size;
+			return data;
+
+		#else
+
+			return fileRead(fileName, fileSize);
+
+		#endif
+	}
+
+	void fileUnmap(void* data, int64_t fileSize) {
+		#ifdef SOCK_WIN
+
+			UnmapViewOfFile(data);
+
+		#elif defined SOCK_POSIX
+
+			munmap(data, fileSize);
+
+		#else
+
+			free(data);
+
+		#endif
+	}
+
 	bool fileWrite(const char* fileName, const char* data, size_t length) {
 		SDL_RWops* file = SDL_RWFromFile(fileName, "wb");
 		if (file == NULL) {
@@ -1514,6 +1877,14 @@ const char* wren_resolveModule(WrenVM* vm, const char* importer, const char* nam
 			if (error == ERROR_ACCESS_DENIED) return 2;
 			return 3;
 		
+		#elif defined SOCK_POSIX
+
+			if (unlink(fileName) == 0) return 0;
+
+			if (errno == ENOENT) return 1;
+			if (errno == EACCES || errno == EPERM) return 2;
+			return 3;
+
 		#else
 
 			return 3;
@@ -1541,6 +1912,7 @@ const char* wren_resolveModule(WrenVM* vm, const char* importer, const char* nam
 		return i;
 	}
 
+	// Returns the file path for the storage key in [slot], allocated with [frameAlloc()].
 	char* storageKeyToPath(WrenVM* vm, int slot) {
 		if (storageID == NULL || storagePath == NULL) {
 			wrenAbort(vm, "id must be set before using other Storage methods");
@@ -1560,7 +1932,7 @@ const char* wren_resolveModule(WrenVM* vm, const char* importer, const char* nam
 		}
 
 		int storagePathLen = (int)strlen(storagePath);
-		char* path = malloc(storagePathLen + keyLen + 5);
+		char* path = frameAlloc(storagePathLen + keyLen + 5);
 		if (path == NULL) return NULL;
 
 		memcpy(path, storagePath, storagePathLen);
@@ -1610,8 +1982,6 @@ const char* wren_resolveModule(WrenVM* vm, const char* importer, const char* nam
 		char* path = storageKeyToPath(vm, 1);
 		if (path) {
 			wrenSetSlotBool(vm, 0, fileExists(path));
-
-			free(path);
 		}
 	}
 
@@ -1644,8 +2014,6 @@ const char* wren_resolveModule(WrenVM* vm, const char* importer, const char* nam
 
 				wrenSetSlotNull(vm, 0);
 			}
-
-			free(path);
 		}
 	}
 	
@@ -1661,8 +2029,6 @@ const char* wren_resolveModule(WrenVM* vm, const char* importer, const char* nam
 			const char* value = wrenGetSlotBytes(vm, 2, &len);
 
 			fileWrite(path, value, len);
-
-			free(path);
 		}
 	}
 
@@ -1683,8 +2049,6 @@ const char* wren_resolveModule(WrenVM* vm, const char* importer, const char* nam
 				(void)status;
 
 			#endif
-
-			free(path);
 		}
 	}
 
@@ -1796,6 +2160,42 @@ const char* wren_resolveModule(WrenVM* vm, const char* importer, const char* nam
 	static int mouseWindowPosY = 0;
 	static int mouseWheel = 0;
 
+	// Input codes are SDL scancodes for keys, followed by the mouse buttons.
+	#define INPUT_CODE_MOUSE_LEFT SDL_NUM_SCANCODES
+	#define INPUT_CODE_MOUSE_MIDDLE (SDL_NUM_SCANCODES + 1)
+	#define INPUT_CODE_MOUSE_RIGHT (SDL_NUM_SCANCODES + 2)
+	#define INPUT_CODE_COUNT (SDL_NUM_SCANCODES + 3)
+
+	typedef struct {
+		// Value 0..1
+		float value;
+		// Input frame the value last moved across [inputHoldCutoff].
+		uint32_t frame;
+	} InputCodeState;
+
+	static InputCodeState inputStates[INPUT_CODE_COUNT];
+	static float inputHoldCutoff = 0.5f;
+	// Advanced after each update by [Input.pupdate_()], starts at 1 so untouched inputs are never pressed or released.
+	static uint32_t inputFrame = 1;
+
+	bool inputIsHeld(int code) {
+		return inputStates[code].value > inputHoldCutoff;
+	}
+
+	bool inputIsPressed(int code) {
+		return inputStates[code].frame == inputFrame && inputIsHeld(code);
+	}
+
+	bool inputIsReleased(int code) {
+		return inputStates[code].frame == inputFrame && !inputIsHeld(code);
+	}
+
+	void inputSetValue(int code, float value) {
+		bool held = inputIsHeld(code);
+		inputStates[code].value = value;
+		if (held != inputIsHeld(code)) inputStates[code].frame = inputFrame;
+	}
+
 	const char* sdlScancodeToInputID(SDL_Scancode code) {
 		switch (code) {
 			// Alphabet.
@@ -1889,6 +2289,8 @@ const char* wren_resolveModule(WrenVM* vm, const char* importer, const char* nam
 			case SDL_SCANCODE_RIGHT: return INPUT_ID_ARROW_RIGHT;
 			case SDL_SCANCODE_UP: return INPUT_ID_ARROW_UP;
 			case SDL_SCANCODE_DOWN: return INPUT_ID_ARROW_DOWN;
+			// Anything else has no input ID.
+			default: break;
 		}
 
 		return NULL;
@@ -1963,6 +2365,24 @@ const char* wren_resolveModule(WrenVM* vm, const char* importer, const char* nam
 		return SDL_SCANCODE_UNKNOWN;
 	}
 
+	// Returns the input code for an input ID, or -1 if there is none.
+	int inputIDToCode(const char* id) {
+		if (strcmp(id, INPUT_ID_MOUSE_LEFT) == 0) return INPUT_CODE_MOUSE_LEFT;
+		if (strcmp(id, INPUT_ID_MOUSE_MIDDLE) == 0) return INPUT_CODE_MOUSE_MIDDLE;
+		if (strcmp(id, INPUT_ID_MOUSE_RIGHT) == 0) return INPUT_CODE_MOUSE_RIGHT;
+
+		SDL_Scancode scancode = inputIDToSDLScancode(id);
+		return scancode == SDL_SCANCODE_UNKNOWN ? -1 : (int)scancode;
+	}
+
+	const char* inputCodeToID(int code) {
+		if (code == INPUT_CODE_MOUSE_LEFT) return INPUT_ID_MOUSE_LEFT;
+		if (code == INPUT_CODE_MOUSE_MIDDLE) return INPUT_ID_MOUSE_MIDDLE;
+		if (code == INPUT_CODE_MOUSE_RIGHT) return INPUT_ID_MOUSE_RIGHT;
+
+		return sdlScancodeToInputID((SDL_Scancode)code);
+	}
+
 	SDL_Scancode sdlDirectKeyCodeToScancode(SDL_KeyCode keycode) {
 		if (keycode >= SDLK_a && keycode <= SDLK_z) return SDL_SCANCODE_A + (keycode - SDLK_a);
 		if (keycode >= SDLK_1 && keycode <= SDLK_9) return SDL_SCANCODE_1 + (keycode - SDLK_1);
@@ -1978,72 +2398,364 @@ const char* wren_resolveModule(WrenVM* vm, const char* importer, const char* nam
 			case SDLK_LEFTBRACKET: return SDL_SCANCODE_LEFTBRACKET;
 			case SDLK_RIGHTBRACKET: return SDL_SCANCODE_RIGHTBRACKET;
 			case SDLK_BACKSLASH: return SDL_SCANCODE_BACKSLASH;
+			default: break;
 		}
 
 		return SDL_SCANCODE_UNKNOWN;
 	}
 
 
-	// === OpenGL ===
+	// === PROFILER ===
 
-	#if DEBUG
+	// A zone is a named, timed section of a frame.
+	// [end] is 0 while the zone is still open.
+	typedef struct {
+		const char* name;
+		uint64_t start;
+		uint64_t end;
+		uint32_t frame;
+		uint32_t depth;
+	} ProfilerZone;
+
+	// Total zones kept, older zones are overwritten.
+	#define PROFILER_CAPACITY 16384
+	#define PROFILER_MAX_DEPTH 32
+	#define PROFILER_MAX_NAMES 256
+
+	// Number of frames averaged for each overlay refresh.
+	#define PROFILER_OVERLAY_FRAMES 30
+	#define PROFILER_OVERLAY_ROWS 24
 
-		void GLAPIENTRY myGlDebugCallback( GLenum source, GLenum type, GLuint id, GLenum severity, GLsizei length, const GLchar* message, const void* userParam) {
-			const char* sErrorType = "?";
-			const char* sSeverity = "?";
-			
-			switch (type) {
-				case GL_DEBUG_TYPE_ERROR:
-					sErrorType = "ERROR";
-					break;
-				case GL_DEBUG_TYPE_DEPRECATED_BEHAVIOR:
-					sErrorType = "DEPRECATED_BEHAVIOR";
-					break;
-				case GL_DEBUG_TYPE_UNDEFINED_BEHAVIOR:
-					sErrorType = "UNDEFINED_BEHAVIOR";
-					break;
-				case GL_DEBUG_TYPE_PORTABILITY:
-					sErrorType = "PORTABILITY";
-					break;
-				case GL_DEBUG_TYPE_PERFORMANCE:
-					sErrorType = "PERFORMANCE";
-					break;
-				case GL_DEBUG_TYPE_OTHER:
-					sErrorType = "OTHER";
-					break;
-			}
-			
-			switch (severity){
-				case GL_DEBUG_SEVERITY_LOW:
-					sSeverity = "LOW";
-					break;
-				case GL_DEBUG_SEVERITY_MEDIUM:
-					sSeverity = "MEDM";
-					break;
-				case GL_DEBUG_SEVERITY_HIGH:
-					sSeverity = "HIGH";
-					break;
-				case GL_DEBUG_SEVERITY_NOTIFICATION:
-					return;
-			}
-			
-			printf("[GL] type=%s id=%d severity=%s: %s\n", sErrorType, id, sSeverity, message);
-		}
+	typedef struct {
+		const char* name;
+		uint32_t depth;
+		uint64_t total;
+	} ProfilerOverlayRow;
+
+	static bool profiler_enabled = false;
+	static bool profiler_overlay = false;
+	static const char* profiler_outPath = NULL;
+	static ProfilerZone* profiler_zones = NULL;
+	// Total number of zones ever started, the ring buffer index is this modulo [PROFILER_CAPACITY].
+	static uint64_t profiler_zoneCount = 0;
+	static uint64_t profiler_frameFirstZone = 0;
+	static uint32_t profiler_frame = 0;
+	static uint32_t profiler_stack[PROFILER_MAX_DEPTH];
+	static uint32_t profiler_depth = 0;
+	// Zones started with Profiler.begin() and still open, on top of the engine's own.
+	// Zones dropped for being too deep are counted separately, so their Profiler.end() is ignored too.
+	static uint32_t profiler_scriptDepth = 0;
+	static uint32_t profiler_scriptDropped = 0;
+	static char* profiler_names[PROFILER_MAX_NAMES];
+	static uint32_t profiler_nameCount = 0;
+	static ProfilerOverlayRow profiler_overlayRows[PROFILER_OVERLAY_ROWS];
+	static uint32_t profiler_overlayRowCount = 0;
+	static uint32_t profiler_overlayFrames = 0;
+	static char profiler_overlayText[PROFILER_OVERLAY_ROWS * 48];
+
+	bool profilerSetEnabled(bool enabled) {
+		// Setting it again mid frame must keep the open zones, or the next Profiler.end() would be unmatched.
+		if (enabled == profiler_enabled) return true;
+
+		if (enabled && !profiler_zones) {
+			profiler_zones = (ProfilerZone*)malloc(PROFILER_CAPACITY * sizeof(ProfilerZone));
+			if (!profiler_zones) return false;
+		}
+
+		// Zones open while actually toggling are discarded.
+		profiler_depth = 0;
+		profiler_scriptDepth = 0;
+		profiler_scriptDropped = 0;
+		profiler_enabled = enabled;
 
-		bool debug_checkGlError(const char* where) {
-			GLenum error;
-			while ((error = glGetError()) != 0) {
-				const char* msg = "?";
-				if (error == GL_INVALID_ENUM) msg = "invalid enum";
-				else if (error == GL_INVALID_VALUE) msg = "invalid value";
-				else if (error == GL_INVALID_OPERATION) msg = "invalid operation";
-				else if (error == GL_INVALID_FRAMEBUFFER_OPERATION) msg = "invalid framebuffer operation";
-				else if (error == GL_OUT_OF_MEMORY) msg = "out of memory";
-				// missing constants from glad...
-				else if (error == 0x504) msg = "stack underflow";
-				else if (error == 0x503) msg = "stack overflow";
+		return true;
+	}
 
-				printf("[GL] error at '%s': %s\n", where, msg);
+	// Returns a copy of [name] that lives as long as the program, so zone names can be compared by pointer.
+	const char* profilerInternName(const char* name) {
+		for (uint32_t i = 0; i < profiler_nameCount; i++) {
+			if (strcmp(profiler_names[i], name) == 0) return profiler_names[i];
+		}
+
+		if (profiler_nameCount == PROFILER_MAX_NAMES) return NULL;
+
+		char* copy = _strdup(name);
+		if (copy) {
+			profiler_names[profiler_nameCount++] = copy;
+		}
+
+		return copy;
+	}
+
+	// Starts a zone, [name] must be a static or interned string.
+	void profilerBegin(const char* name) {
+		if (!profiler_enabled || profiler_depth == PROFILER_MAX_DEPTH) return;
+
+		uint32_t index = (uint32_t)(profiler_zoneCount % PROFILER_CAPACITY);
+		ProfilerZone* zone = profiler_zones + index;
+		zone->name = name;
+		zone->start = SDL_GetPerformanceCounter();
+		zone->end = 0;
+		zone->frame = profiler_frame;
+		zone->depth = profiler_depth;
+
+		profiler_stack[profiler_depth++] = index;
+		profiler_zoneCount++;
+	}
+
+	// Ends the most recently started zone.
+	void profilerEnd() {
+		if (!profiler_enabled || profiler_depth == 0) return;
+
+		profiler_zones[profiler_stack[--profiler_depth]].end = SDL_GetPerformanceCounter();
+	}
+
+	// Ends the zones a script left open, so they don't take the place of the engine's.
+	void profilerEndScriptZones() {
+		while (profiler_scriptDepth > 0) {
+			profiler_scriptDepth--;
+			profilerEnd();
+		}
+
+		profiler_scriptDropped = 0;
+	}
+
+	// Rebuilds [profiler_overlayText] from the averaged rows.
+	void profilerUpdateOverlayText() {
+		double toMS = 1000.0 / (double)SDL_GetPerformanceFrequency() / profiler_overlayFrames;
+
+		size_t length = 0;
+		size_t size = sizeof(profiler_overlayText);
+		profiler_overlayText[0] = '\0';
+
+		for (uint32_t i = 0; i < profiler_overlayRowCount && length < size; i++) {
+			ProfilerOverlayRow* row = profiler_overlayRows + i;
+
+			int n = snprintf(
+				profiler_overlayText + length,
+				size - length,
+				"%*s%s %.2fms\n",
+				(int)(row->depth * 2), "",
+				row->name,
+				row->total * toMS
+			);
+			if (n < 0) break;
+			length += n;
+		}
+	}
+
+	// Adds up the zones of the frame that just ended for the overlay, then starts a new frame.
+	void profilerEndFrame() {
+		if (!profiler_enabled) return;
+
+		// Nothing should be open by now, but a frame cut short may have left zones behind.
+		profilerEndScriptZones();
+		while (profiler_depth > 0) profilerEnd();
+
+		if (profiler_overlay) {
+			uint64_t first = profiler_frameFirstZone;
+			if (profiler_zoneCount - first > PROFILER_CAPACITY) first = profiler_zoneCount - PROFILER_CAPACITY;
+
+			for (uint64_t i = first; i < profiler_zoneCount; i++) {
+				ProfilerZone* zone = profiler_zones + (i % PROFILER_CAPACITY);
+				if (zone->end == 0) continue;
+
+				// Rows are unique by name and depth, in the order they were first seen.
+				ProfilerOverlayRow* row = NULL;
+				for (uint32_t r = 0; r < profiler_overlayRowCount; r++) {
+					if (profiler_overlayRows[r].name == zone->name && profiler_overlayRows[r].depth == zone->depth) {
+						row = profiler_overlayRows + r;
+						break;
+					}
+				}
+
+				if (!row) {
+					if (profiler_overlayRowCount == PROFILER_OVERLAY_ROWS) continue;
+
+					row = profiler_overlayRows + profiler_overlayRowCount++;
+					row->name = zone->name;
+					row->depth = zone->depth;
+					row->total = 0;
+				}
+
+				row->total += zone->end - zone->start;
+			}
+
+			profiler_overlayFrames++;
+			if (profiler_overlayFrames == PROFILER_OVERLAY_FRAMES) {
+				profilerUpdateOverlayText();
+				profiler_overlayRowCount = 0;
+				profiler_overlayFrames = 0;
+			}
+		}
+
+		profiler_frame++;
+		profiler_frameFirstZone = profiler_zoneCount;
+	}
+
+	void profilerAddJSONString(StringBuilder* sb, const char* str) {
+		sbAddByte(sb, '"');
+		for (const char* c = str; *c; c++) {
+			if (*c == '"' || *c == '\\') {
+				sbAddByte(sb, '\\');
+				sbAddByte(sb, *c);
+			} else if ((unsigned char)*c < 0x20) {
+				sbAddByte(sb, ' ');
+			} else {
+				sbAddByte(sb, *c);
+			}
+		}
+		sbAddByte(sb, '"');
+	}
+
+	// Writes all completed zones still in the ring buffer to [path], in the Chrome trace event format.
+	// Open with chrome://tracing, or https://ui.perfetto.dev.
+	bool profilerWriteTrace(const char* path) {
+		if (!profiler_zones) return false;
+
+		double toUS = 1000000.0 / (double)SDL_GetPerformanceFrequency();
+
+		uint64_t first = profiler_zoneCount > PROFILER_CAPACITY ? profiler_zoneCount - PROFILER_CAPACITY : 0;
+		uint64_t epoch = profiler_zones[first % PROFILER_CAPACITY].start;
+
+		StringBuilder sb;
+		sbInit(&sb);
+		sbAddStr(&sb, "{\"traceEvents\":[");
+
+		bool comma = false;
+		char buffer[128];
+
+		for (uint64_t i = first; i < profiler_zoneCount; i++) {
+			ProfilerZone* zone = profiler_zones + (i % PROFILER_CAPACITY);
+			if (zone->end == 0) continue;
+
+			if (comma) sbAddByte(&sb, ',');
+			comma = true;
+
+			sbAddStr(&sb, "\n{\"name\":");
+			profilerAddJSONString(&sb, zone->name);
+			snprintf(
+				buffer,
+				128,
+				",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"frame\":%u}}",
+				(double)(zone->start - epoch) * toUS,
+				(double)(zone->end - zone->start) * toUS,
+				zone->frame
+			);
+			sbAddStr(&sb, buffer);
+		}
+
+		sbAddStr(&sb, "\n]}\n");
+
+		bool ok = fileWrite(path, sb.data, sb.size);
+
+		sbFree(&sb);
+
+		return ok;
+	}
+
+
+	// === RENDER STATS ===
+
+	// Counters for the work sent to OpenGL, to spot batching regressions.
+	typedef struct {
+		uint32_t drawCalls;
+		uint32_t vertices;
+		uint64_t bufferBytesUploaded;
+		uint32_t textureBinds;
+		// Blend and scissor state changes.
+		uint32_t stateChanges;
+		// Sprites and quads dropped by culling.
+		uint32_t culled;
+	} RenderStats;
+
+	// Stats of the current frame, and the last completed frame.
+	static RenderStats renderStats = { 0 };
+	static RenderStats renderStatsLast = { 0 };
+	// Bytes of texture memory currently allocated, this is not reset each frame.
+	static int64_t renderStats_textureMemory = 0;
+
+	void renderStatsEndFrame() {
+		renderStatsLast = renderStats;
+		memset(&renderStats, 0, sizeof(RenderStats));
+	}
+
+	// The main framebuffer texture is re-allocated on resize, so its size is tracked separately.
+	static int64_t renderStats_framebufferMemory = 0;
+
+	void renderStatsFramebufferResized(int width, int height) {
+		int64_t bytes = (int64_t)width * height * 4;
+		renderStats_textureMemory += bytes - renderStats_framebufferMemory;
+		renderStats_framebufferMemory = bytes;
+	}
+
+	// Counts a draw call of [vertexCount] vertices.
+	void renderStatsDraw(uint32_t vertexCount) {
+		renderStats.drawCalls++;
+		renderStats.vertices += vertexCount;
+	}
+
+
+	// === OpenGL ===
+
+	#if DEBUG
+
+		void GLAPIENTRY myGlDebugCallback( GLenum source, GLenum type, GLuint id, GLenum severity, GLsizei length, const GLchar* message, const void* userParam) {
+			const char* sErrorType = "?";
+			const char* sSeverity = "?";
+			
+			switch (type) {
+				case GL_DEBUG_TYPE_ERROR:
+					sErrorType = "ERROR";
+					break;
+				case GL_DEBUG_TYPE_DEPRECATED_BEHAVIOR:
+					sErrorType = "DEPRECATED_BEHAVIOR";
+					break;
+				case GL_DEBUG_TYPE_UNDEFINED_BEHAVIOR:
+					sErrorType = "UNDEFINED_BEHAVIOR";
+					break;
+				case GL_DEBUG_TYPE_PORTABILITY:
+					sErrorType = "PORTABILITY";
+					break;
+				case GL_DEBUG_TYPE_PERFORMANCE:
+					sErrorType = "PERFORMANCE";
+					break;
+				case GL_DEBUG_TYPE_OTHER:
+					sErrorType = "OTHER";
+					break;
+			}
+			
+			switch (severity){
+				case GL_DEBUG_SEVERITY_LOW:
+					sSeverity = "LOW";
+					break;
+				case GL_DEBUG_SEVERITY_MEDIUM:
+					sSeverity = "MEDM";
+					break;
+				case GL_DEBUG_SEVERITY_HIGH:
+					sSeverity = "HIGH";
+					break;
+				case GL_DEBUG_SEVERITY_NOTIFICATION:
+					return;
+			}
+			
+			printf("[GL] type=%s id=%d severity=%s: %s\n", sErrorType, id, sSeverity, message);
+		}
+
+		bool debug_checkGlError(const char* where) {
+			GLenum error;
+			while ((error = glGetError()) != 0) {
+				const char* msg = "?";
+				if (error == GL_INVALID_ENUM) msg = "invalid enum";
+				else if (error == GL_INVALID_VALUE) msg = "invalid value";
+				else if (error == GL_INVALID_OPERATION) msg = "invalid operation";
+				else if (error == GL_INVALID_FRAMEBUFFER_OPERATION) msg = "invalid framebuffer operation";
+				else if (error == GL_OUT_OF_MEMORY) msg = "out of memory";
+				// missing constants from glad...
+				else if (error == 0x504) msg = "stack underflow";
+				else if (error == 0x503) msg = "stack overflow";
+
+				printf("[GL] error at '%s': %s\n", where, msg);
 
 				return true;
 			}
@@ -2059,7 +2771,7 @@ const char* wren_resolveModule(WrenVM* vm, const char* importer, const char* nam
 
 	typedef struct {
 		int attributeCount;
-		const char* attributes[4];
+		const char* attributes[5];
 		int vertexUnifomCount;
 		const char* vertexUniforms[4];
 		int fragmentUnifomCount;
@@ -2098,6 +2810,15 @@ const char* wren_resolveModule(WrenVM* vm, const char* importer, const char* nam
 
 	static float cameraMatrix[9] = { NAN };
 	float* getCameraMatrix();
+	void setCameraOrigin(float x, float y, float* tf);
+	bool getCameraRect(float* rect);
+
+	// Returns true if the quad with corners [x1], [y1] to [x4], [y4] should be dropped, as it is outside the
+	// camera's view. Always false unless Game.culling is on.
+	bool renderCullQuad(float x1, float y1, float x2, float y2, float x3, float y3, float x4, float y4);
+
+	// Quads addressable by the 16 bit indices, larger draws are split and offset with a base vertex.
+	#define QUAD_INDEX_MAX_QUADS 16384
 
 	static GLuint quadIndexBuffer = 0;
 	static uint16_t* quadIndexBufferData = NULL;
@@ -2108,7 +2829,12 @@ const char* wren_resolveModule(WrenVM* vm, const char* importer, const char* nam
 	// 
 	// [indexCount] is the number of indices needed.
 	// Should be a multiple of 6 (each quad used 2 triangles = 6 indices). e.g. [vertexCount * 1.5].
+	// At most [QUAD_INDEX_MAX_QUADS] quads are indexed, past that the indices would wrap.
 	void bindQuadIndexBuffer(uint32_t indexCount) {
+		if (indexCount > QUAD_INDEX_MAX_QUADS * 6) {
+			indexCount = QUAD_INDEX_MAX_QUADS * 6;
+		}
+
 		if (quadIndexBufferData == NULL) {
 			glGenBuffers(1, &quadIndexBuffer);
 		}
@@ -2121,6 +2847,10 @@ const char* wren_resolveModule(WrenVM* vm, const char* importer, const char* nam
 				quadIndexBufferSize *= 2;
 			}
 
+			if (quadIndexBufferSize > QUAD_INDEX_MAX_QUADS * 6) {
+				quadIndexBufferSize = QUAD_INDEX_MAX_QUADS * 6;
+			}
+
 			// Create new indices array.
 			uint16_t* newIndices = (uint16_t*)realloc(quadIndexBufferData, quadIndexBufferSize * sizeof(uint16_t));
 			if (!newIndices) {
@@ -2144,12 +2874,231 @@ const char* wren_resolveModule(WrenVM* vm, const char* importer, const char* nam
 			}
 
 			glBufferData(GL_ELEMENT_ARRAY_BUFFER, quadIndexBufferSize * sizeof(uint16_t), quadIndexBufferData, GL_DYNAMIC_DRAW);
+			renderStats.bufferBytesUploaded += quadIndexBufferSize * sizeof(uint16_t);
+		}
+	}
+
+
+	// Vertex stream buffer.
+	//
+	// All batchers upload their vertices into one shared ring buffer instead of re-specifying their own
+	// buffers each flush, which would stall on buffers the GPU is still reading.
+	// With ARB_buffer_storage the ring is mapped once (persistent + coherent) and written with memcpy.
+	// It is split into segments, each fenced after the draws reading what was written into it are issued,
+	// so we only wait when wrapping around onto data the GPU has not consumed yet.
+	// Without it, writes are unsynchronized maps and the buffer is orphaned on wrap.
+
+	#define STREAM_BUFFER_INITIAL_SIZE (1024 * 1024)
+	#define STREAM_BUFFER_SEGMENTS 4
+
+	#ifndef GL_MAP_PERSISTENT_BIT
+		#define GL_MAP_PERSISTENT_BIT 0x0040
+	#endif
+
+	#ifndef GL_MAP_COHERENT_BIT
+		#define GL_MAP_COHERENT_BIT 0x0080
+	#endif
+
+	// glBufferStorage is GL 4.4 / ARB_buffer_storage, which our glad does not load.
+	typedef void (GLAD_API_PTR *SOCK_PFNGLBUFFERSTORAGEPROC)(GLenum target, GLsizeiptr size, const void* data, GLbitfield flags);
+
+	static SOCK_PFNGLBUFFERSTORAGEPROC sock_glBufferStorage = NULL;
+
+	static GLuint streamBuffer = 0;
+	static uint32_t streamBufferSize = 0;
+	// Offset to write the next upload at.
+	static uint32_t streamBufferHead = 0;
+	// Persistently mapped data, NULL if not using ARB_buffer_storage.
+	static uint8_t* streamBufferMapped = NULL;
+	static GLsync streamBufferFences[STREAM_BUFFER_SEGMENTS];
+	// Segments written since the last [streamBufferFence()].
+	static bool streamBufferWritten[STREAM_BUFFER_SEGMENTS];
+	// Number of times we had to wait for the GPU to release a segment.
+	static uint32_t streamBuffer_waitCount = 0;
+	// Incremented each time [streamBuffer] is replaced, so vertex arrays know to point at the new one.
+	static uint32_t streamBufferGeneration = 0;
+
+	bool streamBufferCreate(uint32_t size) {
+		glGenBuffers(1, &streamBuffer);
+		glBindBuffer(GL_ARRAY_BUFFER, streamBuffer);
+
+		if (sock_glBufferStorage) {
+			GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+			sock_glBufferStorage(GL_ARRAY_BUFFER, size, NULL, flags);
+			streamBufferMapped = (uint8_t*)glMapBufferRange(GL_ARRAY_BUFFER, 0, size, flags);
+
+			if (!streamBufferMapped) {
+				// Fall back to orphaning from now on.
+				sock_glBufferStorage = NULL;
+				glDeleteBuffers(1, &streamBuffer);
+				return streamBufferCreate(size);
+			}
+		} else {
+			glBufferData(GL_ARRAY_BUFFER, size, NULL, GL_STREAM_DRAW);
+		}
+
+		streamBufferSize = size;
+		streamBufferHead = 0;
+		streamBufferGeneration++;
+
+		for (int i = 0; i < STREAM_BUFFER_SEGMENTS; i++) {
+			streamBufferFences[i] = NULL;
+			streamBufferWritten[i] = false;
+		}
+
+		return !debug_checkGlError("create stream buffer");
+	}
+
+	bool streamBufferInit() {
+		if (SDL_GL_ExtensionSupported("GL_ARB_buffer_storage")) {
+			sock_glBufferStorage = (SOCK_PFNGLBUFFERSTORAGEPROC)SDL_GL_GetProcAddress("glBufferStorage");
+		}
+
+		#ifdef DEBUG
+
+			printf("stream buffer %s\n", sock_glBufferStorage ? "persistent" : "orphaning");
+
+		#endif
+
+		return streamBufferCreate(STREAM_BUFFER_INITIAL_SIZE);
+	}
+
+	void streamBufferDestroy() {
+		for (int i = 0; i < STREAM_BUFFER_SEGMENTS; i++) {
+			if (streamBufferFences[i]) glDeleteSync(streamBufferFences[i]);
+		}
+
+		if (streamBufferMapped) {
+			glBindBuffer(GL_ARRAY_BUFFER, streamBuffer);
+			glUnmapBuffer(GL_ARRAY_BUFFER);
+			streamBufferMapped = NULL;
+		}
+
+		glDeleteBuffers(1, &streamBuffer);
+		streamBuffer = 0;
+	}
+
+	// Fences the segments written since the last call, so they can't be overwritten while still in use.
+	// Must be called once the draws reading them are issued, as a fence inserted before a draw can signal
+	// before the draw is done.
+	void streamBufferFence() {
+		for (int i = 0; i < STREAM_BUFFER_SEGMENTS; i++) {
+			if (!streamBufferWritten[i]) continue;
+			streamBufferWritten[i] = false;
+
+			if (streamBufferMapped) {
+				// The new fence signals after the old one.
+				if (streamBufferFences[i]) glDeleteSync(streamBufferFences[i]);
+				streamBufferFences[i] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+			}
+		}
+	}
+
+	// Waits for the GPU to finish with the segment the write head is entering.
+	void streamBufferEnterSegment(int segment) {
+		GLsync fence = streamBufferFences[segment];
+		if (!fence) return;
+
+		GLenum result = glClientWaitSync(fence, 0, 0);
+		if (result == GL_TIMEOUT_EXPIRED) {
+			streamBuffer_waitCount++;
+			
+			do {
+				result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+			} while (result == GL_TIMEOUT_EXPIRED);
+		}
+
+		glDeleteSync(fence);
+		streamBufferFences[segment] = NULL;
+	}
+
+	// Ensures a single put of [bytes] fits, replacing the buffer with a larger one if needed.
+	// Data put before this call is lost if the buffer is replaced.
+	void streamBufferReserve(uint32_t bytes) {
+		if (bytes > streamBufferSize / STREAM_BUFFER_SEGMENTS) {
+			// Too big to fence, grow the ring. This is rare, so just wait for the GPU to be idle.
+			uint32_t size = streamBufferSize;
+			while (bytes > size / STREAM_BUFFER_SEGMENTS) size *= 2;
+
+			glFinish();
+			streamBufferDestroy();
+			if (!streamBufferCreate(size)) {
+				printf("failed to resize stream buffer\n");
+			}
+		}
+	}
+
+	// Copies [count] blocks of [data], [blockBytes] each, one after another into the stream buffer, and leaves
+	// it bound to GL_ARRAY_BUFFER. They are written as one put, so they share storage even when orphaning.
+	// Returns the offset the first block was written to, which is a multiple of [stride], so it can be
+	// addressed as a base vertex or instance. Each block after it starts where the one before ends.
+	uint32_t streamBufferPut(const void* const* data, const uint32_t* blockBytes, uint32_t count, uint32_t stride) {
+		uint32_t bytes = 0;
+		for (uint32_t i = 0; i < count; i++) {
+			bytes += blockBytes[i];
+		}
+
+		if (bytes == 0) return 0;
+
+		streamBufferReserve(bytes);
+		glBindBuffer(GL_ARRAY_BUFFER, streamBuffer);
+
+		uint32_t segmentSize = streamBufferSize / STREAM_BUFFER_SEGMENTS;
+
+		uint32_t offset = ((streamBufferHead + stride - 1) / stride) * stride;
+		bool wrap = offset + bytes > streamBufferSize;
+		if (wrap) offset = 0;
+
+		// Walk the head through every segment boundary this upload crosses.
+		int segment = streamBufferHead == 0 ? 0 : (streamBufferHead - 1) / segmentSize;
+		int lastSegment = (offset + bytes - 1) / segmentSize;
+
+		while (segment != lastSegment) {
+			segment = (segment + 1) % STREAM_BUFFER_SEGMENTS;
+			streamBufferEnterSegment(segment);
+		}
+
+		// Fenced by [streamBufferFence()] once drawn from.
+		for (int i = offset / segmentSize; i <= lastSegment; i++) {
+			streamBufferWritten[i] = true;
+		}
+
+		uint8_t* dst;
+
+		if (streamBufferMapped) {
+			dst = streamBufferMapped + offset;
+		} else {
+			if (wrap) {
+				// Orphan, the driver gives us fresh storage while the GPU finishes with the old.
+				glBufferData(GL_ARRAY_BUFFER, streamBufferSize, NULL, GL_STREAM_DRAW);
+			}
+
+			dst = (uint8_t*)glMapBufferRange(GL_ARRAY_BUFFER, offset, bytes, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+		}
+
+		if (dst) {
+			for (uint32_t i = 0; i < count; i++) {
+				if (blockBytes[i]) memcpy(dst, data[i], blockBytes[i]);
+				dst += blockBytes[i];
+			}
+
+			if (!streamBufferMapped) glUnmapBuffer(GL_ARRAY_BUFFER);
 		}
+
+		streamBufferHead = offset + bytes;
+		renderStats.bufferBytesUploaded += bytes;
+
+		return offset;
 	}
 
 
 	#define PRIMITIVE_BUFFER_INITIAL_CAPACITY 128
 
+	// Max vertices (or sprite instances) a batcher grows to.
+	// Draws are split to keep indices in range, so this is only a memory limit.
+	#define BATCHER_MAX_CAPACITY (1 << 24)
+
 	typedef struct {
 		// Number of vertices we can fit.
 		uint32_t capacity;
@@ -2159,8 +3108,6 @@ const char* wren_resolveModule(WrenVM* vm, const char* importer, const char* nam
 		//  x     y     z     rgba
 		// [----][----][----][----]
 		void* vertexData;
-		GLuint vertexBuffer;
-		GLuint vertexArray;
 	} PrimitiveBatcher;
 
 	static PrimitiveBatcher quadBatcher;
@@ -2174,8 +3121,6 @@ const char* wren_resolveModule(WrenVM* vm, const char* importer, const char* nam
 		pb->capacity = PRIMITIVE_BUFFER_INITIAL_CAPACITY;
 		pb->vertexCount = UINT32_MAX;
 		pb->vertexData = vertexData;
-		glGenBuffers(1, &pb->vertexBuffer);
-		glGenVertexArrays(1, &pb->vertexArray);
 
 		return true;
 	}
@@ -2183,18 +3128,22 @@ const char* wren_resolveModule(WrenVM* vm, const char* importer, const char* nam
 	bool primitiveBatcherCheckResize(PrimitiveBatcher* pb, uint32_t vertexCount) {
 		if (pb->vertexCount + vertexCount > pb->capacity) {
 			// Grow capacity.
-			if (pb->capacity * 2 >= 0xfffff) {
-				return false;
-			}
+			uint32_t capacity = pb->capacity;
+			while (pb->vertexCount + vertexCount > capacity) {
+				if (capacity >= BATCHER_MAX_CAPACITY) {
+					return false;
+				}
 
-			pb->capacity *= 2;
+				capacity *= 2;
+			}
 			
 			// Resize vertex data.
-			void* newVertexData = realloc(pb->vertexData, pb->capacity * 16);
+			void* newVertexData = realloc(pb->vertexData, capacity * 16);
 			if (!newVertexData) {
 				return false;
 			}
 
+			pb->capacity = capacity;
 			pb->vertexData = newVertexData;
 		}
 
@@ -2214,38 +3163,40 @@ const char* wren_resolveModule(WrenVM* vm, const char* importer, const char* nam
 	}
 
 	void primitiveBatcherDrawQuad(PrimitiveBatcher* pb, float x1, float y1, float x2, float y2, float x3, float y3, float x4, float y4, float z, uint32_t color, Transform* transform) {
+		if (transform) {
+			float* tf = transform->matrix;
+
+			float tx1 = x1 * tf[0] + y1 * tf[2] + tf[4];
+			float ty1 = x1 * tf[1] + y1 * tf[3] + tf[5];
+			float tx2 = x2 * tf[0] + y2 * tf[2] + tf[4];
+			float ty2 = x2 * tf[1] + y2 * tf[3] + tf[5];
+			float tx3 = x3 * tf[0] + y3 * tf[2] + tf[4];
+			float ty3 = x3 * tf[1] + y3 * tf[3] + tf[5];
+			float tx4 = x4 * tf[0] + y4 * tf[2] + tf[4];
+			float ty4 = x4 * tf[1] + y4 * tf[3] + tf[5];
+
+			float tfox = transform->originX;
+			float tfoy = transform->originY;
+			bool haveOrigin = !isnan(tfox);
+
+			tfox = haveOrigin ? (x1 + tfox) : ((x1 + x2) / 2);
+			tfoy = haveOrigin ? (y1 + tfoy) : ((y1 + y2) / 2);
+			float dx = tfox - tf[0] * tfox - tf[2] * tfoy;
+			float dy = tfoy - tf[1] * tfox - tf[3] * tfoy;
+
+			x1 = tx1 + dx; y1 = ty1 + dy;
+			x2 = tx2 + dx; y2 = ty2 + dy;
+			x3 = tx3 + dx; y3 = ty3 + dy;
+			x4 = tx4 + dx; y4 = ty4 + dy;
+		}
+
+		if (renderCullQuad(x1, y1, x2, y2, x3, y3, x4, y4)) return;
+
 		if (primitiveBatcherCheckResize(pb, 4)) {
-			if (transform) {
-				float* tf = transform->matrix;
-
-				float tx1 = x1 * tf[0] + y1 * tf[2] + tf[4];
-				float ty1 = x1 * tf[1] + y1 * tf[3] + tf[5];
-				float tx2 = x2 * tf[0] + y2 * tf[2] + tf[4];
-				float ty2 = x2 * tf[1] + y2 * tf[3] + tf[5];
-				float tx3 = x3 * tf[0] + y3 * tf[2] + tf[4];
-				float ty3 = x3 * tf[1] + y3 * tf[3] + tf[5];
-				float tx4 = x4 * tf[0] + y4 * tf[2] + tf[4];
-				float ty4 = x4 * tf[1] + y4 * tf[3] + tf[5];
-
-				float tfox = transform->originX;
-				float tfoy = transform->originY;
-				bool haveOrigin = !isnan(tfox);
-
-				tfox = haveOrigin ? (x1 + tfox) : ((x1 + x2) / 2);
-				tfoy = haveOrigin ? (y1 + tfoy) : ((y1 + y2) / 2);
-				float dx = tfox - tf[0] * tfox - tf[2] * tfoy;
-				float dy = tfoy - tf[1] * tfox - tf[3] * tfoy;
-
-				primitiveBatcherAddVertex(pb, tx1 + dx, ty1 + dy, z, color);
-				primitiveBatcherAddVertex(pb, tx2 + dx, ty2 + dy, z, color);
-				primitiveBatcherAddVertex(pb, tx3 + dx, ty3 + dy, z, color);
-				primitiveBatcherAddVertex(pb, tx4 + dx, ty4 + dy, z, color);
-			} else {
-				primitiveBatcherAddVertex(pb, x1, y1, z, color);
-				primitiveBatcherAddVertex(pb, x2, y2, z, color);
-				primitiveBatcherAddVertex(pb, x3, y3, z, color);
-				primitiveBatcherAddVertex(pb, x4, y4, z, color);
-			}
+			primitiveBatcherAddVertex(pb, x1, y1, z, color);
+			primitiveBatcherAddVertex(pb, x2, y2, z, color);
+			primitiveBatcherAddVertex(pb, x3, y3, z, color);
+			primitiveBatcherAddVertex(pb, x4, y4, z, color);
 		}
 	}
 
@@ -2266,119 +3217,54 @@ const char* wren_resolveModule(WrenVM* vm, const char* importer, const char* nam
 		pb->vertexCount = 0;
 	}
 
-	// End and draw a primitive batch.
-	// [elementType] should be GL_TRIANGLES
-	void primitiveBatcherEnd(PrimitiveBatcher* pb, int elementType) {
-		if (pb) {
-			if (pb->vertexCount != 0) {
-				glUseProgram(shaderPrimitiveBatcher.program);
 
-				glBindVertexArray(pb->vertexArray);
 
-				// Put vertex data.
-				glBindBuffer(GL_ARRAY_BUFFER, pb->vertexBuffer);
+	#define SPRITE_BUFFER_INITIAL_CAPACITY 128
+	#define SPRITE_BUFFER_CACHE_SIZE 32
 
-				GLint bufferSize;
-				glGetBufferParameteriv(GL_ARRAY_BUFFER, GL_BUFFER_SIZE, &bufferSize);
+	// Bytes per sprite instance.
+	#define SPRITE_INSTANCE_SIZE 48
 
-				if (pb->vertexCount * 16 > (uint32_t)bufferSize) {
-					// Re-allocate vertex data.
-					glBufferData(GL_ARRAY_BUFFER, pb->vertexCount * 16, pb->vertexData, GL_DYNAMIC_DRAW);
-				} else {
-					// Put in sub-data.
-					glBufferSubData(GL_ARRAY_BUFFER, 0, pb->vertexCount * 16, pb->vertexData);
-				}
-				
-				// Configure/enable attributes.
-				glVertexAttribPointer(
-					0,
-					3,
-					GL_FLOAT,
-					GL_FALSE,
-					16,
-					(void*)0
-				);
-				glEnableVertexAttribArray(0);
-				
-				glVertexAttribPointer(
-					1,
-					4,
-					GL_UNSIGNED_BYTE,
-					GL_TRUE,
-					16,
-					(void*)12
-				);
-				glEnableVertexAttribArray(1);
+	typedef struct {
+		// Number of instances we can fit.
+		uint32_t capacity;
+		// The number of buffered instances in [instanceData].
+		uint32_t instanceCount;
+		// Instance data array, one per sprite, expanded to a quad by the vertex shader.
+		// x, y is the quad's first corner, ax, ay and bx, by its transformed sides, so any 2x3 transform
+		// is folded in. slot is overwritten with the texture slot when the render queue is flushed.
+		//  x     y     slot  rgba  ax    ay    bx    by    u     v     uw    vh
+		// [----][----][----][----][----][----][----][----][----][----][----][----]
+		void* instanceData;
+	} SpriteBatcher;
 
-				// Set shader camera matrix.
-				glUniformMatrix3fv(shaderPrimitiveBatcher.uniforms[0], 1, GL_FALSE, getCameraMatrix());
-			
-				// Setup index buffer.
-				// 6 indices for every 4 vertices. 6:4 -> 3:2
-				uint32_t indexCount = (pb->vertexCount * 3) / 2;
+	static SpriteBatcher* spriteBufferCache[SPRITE_BUFFER_CACHE_SIZE];
+	static int spriteBufferCacheCount = 0;
 
-				bindQuadIndexBuffer(indexCount);
+	typedef struct {
+		Texture texture;
+		Transform transform;
+		char* path;
+		SpriteBatcher* batcher;
+		uint32_t color;
+		// The atlas page holding the image, or NULL if the Sprite owns [texture.id].
+		struct AtlasPage* atlasPage;
+		// The image's rect in the texture: u, v, width, height.
+		float uv[4];
+	} Sprite;
 
-				// Draw!
-				glBindVertexArray(pb->vertexArray);
+	SpriteBatcher* spriteBatcherNew() {
+		void* instanceData = malloc(SPRITE_BUFFER_INITIAL_CAPACITY * SPRITE_INSTANCE_SIZE);
+		if (!instanceData) {
+			return NULL;
+		}
 
-				glDrawElements(elementType, indexCount, GL_UNSIGNED_SHORT, 0);
+		SpriteBatcher* sb = malloc(sizeof(SpriteBatcher));
 
-				// Clean up.
-				glUseProgram(0);
-				glBindVertexArray(0);
-				glDisableVertexAttribArray(0);
-				glDisableVertexAttribArray(1);
-			}
-
-			// Mark as out of batch.
-			pb->vertexCount = UINT32_MAX;
-		}
-	}
-
-
-
-	#define SPRITE_BUFFER_INITIAL_CAPACITY 128
-	#define SPRITE_BUFFER_CACHE_SIZE 32
-
-	typedef struct {
-		// Number of vertices we can fit.
-		uint32_t capacity;
-		// The number of buffered vertices in [vertexData].
-		uint32_t vertexCount;
-		// Vertex data array.
-		//  x     y     z     rgba  u     v
-		// [----][----][----][----][----][----]
-		void* vertexData;
-		GLuint vertexBuffer;
-		GLuint vertexArray;
-	} SpriteBatcher;
-
-	static SpriteBatcher* spriteBufferCache[SPRITE_BUFFER_CACHE_SIZE];
-	static int spriteBufferCacheCount = 0;
-
-	typedef struct {
-		Texture texture;
-		Transform transform;
-		char* path;
-		SpriteBatcher* batcher;
-		uint32_t color;
-	} Sprite;
-
-	SpriteBatcher* spriteBatcherNew() {
-		void* vertexData = malloc(SPRITE_BUFFER_INITIAL_CAPACITY * 24);
-		if (!vertexData) {
-			return NULL;
-		}
-
-		SpriteBatcher* sb = malloc(sizeof(SpriteBatcher));
-
-		if (sb) {
-			sb->capacity = SPRITE_BUFFER_INITIAL_CAPACITY;
-			sb->vertexCount = 0;
-			sb->vertexData = vertexData;
-			glGenBuffers(1, &sb->vertexBuffer);
-			glGenVertexArrays(1, &sb->vertexArray);
+		if (sb) {
+			sb->capacity = SPRITE_BUFFER_INITIAL_CAPACITY;
+			sb->instanceCount = 0;
+			sb->instanceData = instanceData;
 
 			#if DEBUG
 
@@ -2392,9 +3278,7 @@ const char* wren_resolveModule(WrenVM* vm, const char* importer, const char* nam
 
 	void spriteBatcherFree(SpriteBatcher* sb) {
 		if (sb) {
-			if (sb->vertexData) free(sb->vertexData);
-			glDeleteBuffers(1, &sb->vertexBuffer);
-			glDeleteVertexArrays(1, &sb->vertexArray);
+			if (sb->instanceData) free(sb->instanceData);
 			free(sb);
 		}
 	}
@@ -2419,575 +3303,1657 @@ const char* wren_resolveModule(WrenVM* vm, const char* importer, const char* nam
 		}
 	}
 
-	// Get a SpriteBatcher instance that will be help temorary (i.e. not indefinetely by a Wren script).
-	// If possible, it re-uses an existing SpriteBatcher.
-	SpriteBatcher* spriteBatcherTemp() {
-		if (spriteBufferCacheCount == 0) {
-			SpriteBatcher* sb = spriteBatcherNew();
-			if (sb) {
-				spriteBufferCache[0] = sb;
-				spriteBufferCacheCount++;
+	void spriteBatcherBegin(SpriteBatcher* sb) {
+		sb->instanceCount = 0;
+	}
+	
+	bool spriteBatcherCheckResize(SpriteBatcher* sb, uint32_t instanceCount) {
+		if (sb->instanceCount + instanceCount > sb->capacity) {
+			// Grow capacity.
+			uint32_t capacity = sb->capacity;
+			while (sb->instanceCount + instanceCount > capacity) {
+				if (capacity >= BATCHER_MAX_CAPACITY) {
+					return false;
+				}
+
+				capacity *= 2;
 			}
-			return sb;
-		} else {
-			return spriteBufferCache[0];
+			
+			// Resize instance data.
+			void* newInstanceData = realloc(sb->instanceData, capacity * SPRITE_INSTANCE_SIZE);
+			if (!newInstanceData) {
+				return false;
+			}
+
+			sb->capacity = capacity;
+			sb->instanceData = newInstanceData;
 		}
+
+		return true;
 	}
 
-	void spriteBatcherBegin(SpriteBatcher* sb) {
-		sb->vertexCount = 0;
+	void spriteBatcherAddInstance(SpriteBatcher* sb, float x, float y, float ax, float ay, float bx, float by, uint32_t color, float u1, float v1, float u2, float v2) {
+		float* floatPtr = ((float*)sb->instanceData) + (sb->instanceCount * 12);
+		uint32_t* int32ptr = (uint32_t*)floatPtr;
+
+		floatPtr[0] = x;
+		floatPtr[1] = y;
+		floatPtr[2] = 0;
+		int32ptr[3] = color;
+		floatPtr[4] = ax;
+		floatPtr[5] = ay;
+		floatPtr[6] = bx;
+		floatPtr[7] = by;
+		floatPtr[8] = u1;
+		floatPtr[9] = v1;
+		floatPtr[10] = u2 - u1;
+		floatPtr[11] = v2 - v1;
+
+		sb->instanceCount++;
 	}
 	
-	void spriteBatcherEnd(SpriteBatcher* sb, GLuint textureID) {
-		if (sb && sb->vertexCount != 0) {
-			glUseProgram(shaderSpriteBatcher.program);
+	void spriteBatcherDrawRect(SpriteBatcher* sb, float x1, float y1, float x2, float y2, float u1, float v1, float u2, float v2, uint32_t color, Transform* transform) {
+		float w = x2 - x1;
+		float h = y2 - y1;
 
-			glBindVertexArray(sb->vertexArray);
+		// The first corner and the two sides from it.
+		float x = x1, y = y1;
+		float ax = w, ay = 0;
+		float bx = 0, by = h;
 
-			// Put vertex data.
-			glBindBuffer(GL_ARRAY_BUFFER, sb->vertexBuffer);
+		if (transform) {
+			float* tf = transform->matrix;
 
-			GLint bufferSize;
-			glGetBufferParameteriv(GL_ARRAY_BUFFER, GL_BUFFER_SIZE, &bufferSize);
+			float tfox = transform->originX;
+			float tfoy = transform->originY;
+			bool haveOrigin = !isnan(tfox);
 
-			if (sb->vertexCount * 24 > (uint32_t)bufferSize) {
-				// Re-allocate vertex data.
-				glBufferData(GL_ARRAY_BUFFER, sb->vertexCount * 24, sb->vertexData, GL_DYNAMIC_DRAW);
-			} else {
-				// Put in sub-data.
-				glBufferSubData(GL_ARRAY_BUFFER, 0, sb->vertexCount * 24, sb->vertexData);
-			}
-			
-			// Configure/enable attributes.
-			glVertexAttribPointer(
-				0,
-				3,
-				GL_FLOAT,
-				GL_FALSE,
-				24,
-				(void*)0
-			);
-			glEnableVertexAttribArray(0);
-			
-			glVertexAttribPointer(
-				1,
-				4,
-				GL_UNSIGNED_BYTE,
-				GL_TRUE,
-				24,
-				(void*)12
-			);
-			glEnableVertexAttribArray(1);
-
-			glVertexAttribPointer(
-				2,
-				2,
-				GL_FLOAT,
-				GL_FALSE,
-				24,
-				(void*)16
-			);
-			glEnableVertexAttribArray(2);
+			tfox = haveOrigin ? (x1 + tfox) : ((x1 + x2) / 2);
+			tfoy = haveOrigin ? (y1 + tfoy) : ((y1 + y2) / 2);
+			float dx = tfox - tf[0] * tfox - tf[2] * tfoy;
+			float dy = tfoy - tf[1] * tfox - tf[3] * tfoy;
+
+			x = x1 * tf[0] + y1 * tf[2] + tf[4] + dx;
+			y = x1 * tf[1] + y1 * tf[3] + tf[5] + dy;
+			ax = w * tf[0];
+			ay = w * tf[1];
+			bx = h * tf[2];
+			by = h * tf[3];
+		}
 
-			// Set shader camera matrix.
-			glUniformMatrix3fv(shaderSpriteBatcher.uniforms[0], 1, GL_FALSE, getCameraMatrix());
+		if (renderCullQuad(x, y, x + ax, y + ay, x + bx, y + by, x + ax + bx, y + ay + by)) return;
 
-			// Set shader texture.
-			glActiveTexture(GL_TEXTURE0);
-			glBindTexture(GL_TEXTURE_2D, textureID);
-			glUniform1i(shaderSpriteBatcher.uniforms[1], 0);
-		
-			// Setup index buffer.
-			// 6 indices for every 4 vertices. 6:4 -> 3:2
-			uint32_t indexCount = (sb->vertexCount * 3) / 2;
+		if (spriteBatcherCheckResize(sb, 1)) {
+			spriteBatcherAddInstance(sb, x, y, ax, ay, bx, by, color, u1, v1, u2, v2);
+		}
+	}
+
+	// Render queue.
+	//
+	// Draws are not sent to OpenGL straight away. Each one records a command into the queue, which is
+	// flushed at the end of the frame, or before anything that needs the framebuffer to be up to date
+	// (e.g. Game.clear).
+	// Commands are drawn in the order they were submitted, unless they were drawn on different layers
+	// (see Game.layer), lower layers are drawn first.
+	// On flush, consecutive commands with the same shader, texture and render state are merged into a
+	// single draw call, so Sprites, Quads and text no longer each cost their own draw call.
+	// Sprites are drawn instanced, a unit quad expanded by a 48 byte instance per sprite, instead of
+	// 4 vertices of 24 bytes.
+
+	#define RENDER_SHADER_SPRITE 0
+	#define RENDER_SHADER_PRIMITIVE 1
+	// Replays static batches, which have their own buffers and draw with either shader.
+	#define RENDER_SHADER_STATIC 2
+
+	// Max primitive quads per draw call, as the quad indices are 16 bit.
+	#define RENDER_QUEUE_MAX_QUADS QUAD_INDEX_MAX_QUADS
+
+	// Texture units a sprite draw call can sample from, GL 3.3 guarantees at least 16.
+	// Each sprite instance stores which unit to sample.
+	#define RENDER_TEXTURE_SLOTS 16
+
+	// Units to batch across, set with --texture-slots. 1 gives a draw call per texture change.
+	static int renderQueue_textureSlots = RENDER_TEXTURE_SLOTS;
+
+	// GL binding cache.
+	//
+	// The program, vertex array and textures last bound, so flushes only call GL for what changed.
+	// Code outside the render queue binds textures through it too, so it stays correct.
+	typedef struct {
+		GLuint program;
+		GLuint vertexArray;
+		GLenum activeTexture;
+		GLuint textures[RENDER_TEXTURE_SLOTS];
+		// [renderCameraVersion] last set as each render shader's camera uniform.
+		uint32_t cameraVersion[2];
+	} GlCache;
 
-			bindQuadIndexBuffer(indexCount);
+	static GlCache glCache;
 
-			// Draw!
-			glBindVertexArray(sb->vertexArray);
+	// Incremented whenever the camera changes.
+	static uint32_t renderCameraVersion = 0;
 
-			glDrawElements(GL_TRIANGLES, indexCount, GL_UNSIGNED_SHORT, 0);
+	// Forgets everything bound, for after GL was called directly.
+	void glCacheInvalidate() {
+		glCache.program = UINT32_MAX;
+		glCache.vertexArray = UINT32_MAX;
+		glCache.activeTexture = 0;
 
-			// Clean up.
-			glUseProgram(0);
-			glBindVertexArray(0);
-			glDisableVertexAttribArray(0);
-			glDisableVertexAttribArray(1);
-			glDisableVertexAttribArray(2);
+		for (int i = 0; i < RENDER_TEXTURE_SLOTS; i++) {
+			glCache.textures[i] = UINT32_MAX;
 		}
+
+		glCache.cameraVersion[0] = UINT32_MAX;
+		glCache.cameraVersion[1] = UINT32_MAX;
 	}
-	
-	bool spriteBatcherCheckResize(SpriteBatcher* sb, uint32_t vertexCount) {
-		if (sb->vertexCount + vertexCount > sb->capacity) {
-			// Grow capacity.
-			if (sb->capacity * 2 >= 0xfffff) {
-				return false;
-			}
 
-			sb->capacity *= 2;
-			
-			// Resize vertex data.
-			void* newVertexData = realloc(sb->vertexData, sb->capacity * 24);
-			if (!newVertexData) {
-				return false;
-			}
+	void glCacheUseProgram(GLuint program) {
+		if (glCache.program != program) {
+			glUseProgram(program);
+			glCache.program = program;
+		}
+	}
 
-			sb->vertexData = newVertexData;
+	void glCacheBindVertexArray(GLuint vertexArray) {
+		if (glCache.vertexArray != vertexArray) {
+			glBindVertexArray(vertexArray);
+			glCache.vertexArray = vertexArray;
+		}
+	}
+
+	// Binds [texture] to texture [unit]. Returns false if it was already bound.
+	bool glCacheBindTexture(uint32_t unit, GLuint texture) {
+		if (glCache.textures[unit] == texture) return false;
+
+		if (glCache.activeTexture != GL_TEXTURE0 + unit) {
+			glActiveTexture(GL_TEXTURE0 + unit);
+			glCache.activeTexture = GL_TEXTURE0 + unit;
 		}
 
+		glBindTexture(GL_TEXTURE_2D, texture);
+		glCache.textures[unit] = texture;
+
 		return true;
 	}
 
-	void spriteBatcherAddVertex(SpriteBatcher* sb, float x, float y, float z, uint32_t color, float u, float v) {
-		float* floatPtr = ((float*)sb->vertexData) + (sb->vertexCount * 6);
-		uint32_t* int32ptr = (uint32_t*)floatPtr;
-
-		floatPtr[0] = x;
-		floatPtr[1] = y;
-		floatPtr[2] = z;
-		int32ptr[3] = color;
-		floatPtr[4] = u;
-		floatPtr[5] = v;
+	// Binds [texture] to texture unit 0 and makes it active, so it can be uploaded to or configured.
+	void glCacheEditTexture(GLuint texture) {
+		if (glCache.activeTexture != GL_TEXTURE0) {
+			glActiveTexture(GL_TEXTURE0);
+			glCache.activeTexture = GL_TEXTURE0;
+		}
 
-		sb->vertexCount++;
+		glCacheBindTexture(0, texture);
 	}
-	
-	void spriteBatcherDrawRect(SpriteBatcher* sb, float x1, float y1, float x2, float y2, float z, float u1, float v1, float u2, float v2, uint32_t color, Transform* transform) {
-		if (spriteBatcherCheckResize(sb, 4)) {
-			if (transform) {
-				float* tf = transform->matrix;
-
-				float tx1 = x1 * tf[0] + y1 * tf[2] + tf[4];
-				float ty1 = x1 * tf[1] + y1 * tf[3] + tf[5];
-				float tx2 = x1 * tf[0] + y2 * tf[2] + tf[4];
-				float ty2 = x1 * tf[1] + y2 * tf[3] + tf[5];
-				float tx3 = x2 * tf[0] + y1 * tf[2] + tf[4];
-				float ty3 = x2 * tf[1] + y1 * tf[3] + tf[5];
-				float tx4 = x2 * tf[0] + y2 * tf[2] + tf[4];
-				float ty4 = x2 * tf[1] + y2 * tf[3] + tf[5];
-
-				float tfox = transform->originX;
-				float tfoy = transform->originY;
-				bool haveOrigin = !isnan(tfox);
-
-				tfox = haveOrigin ? (x1 + tfox) : ((x1 + x2) / 2);
-				tfoy = haveOrigin ? (y1 + tfoy) : ((y1 + y2) / 2);
-				float dx = tfox - tf[0] * tfox - tf[2] * tfoy;
-				float dy = tfoy - tf[1] * tfox - tf[3] * tfoy;
-
-				spriteBatcherAddVertex(sb, tx1 + dx, ty1 + dy, z, color, u1, v1);
-				spriteBatcherAddVertex(sb, tx2 + dx, ty2 + dy, z, color, u1, v2);
-				spriteBatcherAddVertex(sb, tx3 + dx, ty3 + dy, z, color, u2, v1);
-				spriteBatcherAddVertex(sb, tx4 + dx, ty4 + dy, z, color, u2, v2);
-			} else {
-				spriteBatcherAddVertex(sb, x1, y1, z, color, u1, v1);
-				spriteBatcherAddVertex(sb, x1, y2, z, color, u1, v2);
-				spriteBatcherAddVertex(sb, x2, y1, z, color, u2, v1);
-				spriteBatcherAddVertex(sb, x2, y2, z, color, u2, v2);
-			}
+
+	// Deletes [texture], which OpenGL also unbinds from every unit.
+	void glCacheDeleteTexture(GLuint texture) {
+		if (texture == 0) return;
+
+		for (int i = 0; i < RENDER_TEXTURE_SLOTS; i++) {
+			if (glCache.textures[i] == texture) glCache.textures[i] = 0;
 		}
+
+		glDeleteTextures(1, &texture);
 	}
 
-	bool compilerShaderUniformLocations(Shader* shader, int count, const char** names, int index) {
-		for (int i = 0; i < count; i++) {
-			const char* name = names[i];
+	// GL state a command is drawn with.
+	typedef struct {
+		float camera[9];
+		uint32_t cameraVersion;
+		GLenum blendEquationRGB;
+		GLenum blendEquationAlpha;
+		GLenum blendSrcRGB;
+		GLenum blendSrcAlpha;
+		GLenum blendDstRGB;
+		GLenum blendDstAlpha;
+		float blendColor[4];
+		bool scissor;
+		GLint scissorRect[4];
+	} RenderState;
 
-			int space = strLastIndex(name, ' ');
-			if (space >= 0) {
-				name = name + space + 1;
-			}
+	typedef struct {
+		// Layer in the high 32 bits, submission order in the low 32 bits.
+		uint64_t key;
+		GLuint texture;
+		uint32_t shader;
+		// Index into [renderQueue.states].
+		uint32_t state;
+		// Range of the queue's data for [shader], instances for sprites and vertices for primitives.
+		uint32_t first;
+		uint32_t count;
+	} RenderCommand;
 
-			GLint location = glGetUniformLocation(shader->program, name);
-			if (location == -1) {
-				quitError = printBuffer;
-				snprintf(printBuffer, PRINT_BUFFER_SIZE, "invalid uniform name %s", name);
-				return false;
-			}
-			shader->uniforms[index++] = location;
+	typedef struct {
+		RenderCommand* commands;
+		uint32_t commandCount;
+		uint32_t commandCapacity;
+		RenderState* states;
+		uint32_t stateCount;
+		uint32_t stateCapacity;
+		// Data of all queued commands, for each shader.
+		SpriteBatcher sprites;
+		PrimitiveBatcher primitives;
+		// Instance or vertex count when the current immediate draw began.
+		uint32_t mark;
+		// False if a command was submitted on a lower layer than the one before it.
+		bool sorted;
+		GLuint spriteVertexArray;
+		GLuint primitiveVertexArray;
+		// The unit quad each sprite instance is drawn with.
+		GLuint spriteQuadBuffer;
+		// The [streamBufferGeneration] the vertex arrays point at.
+		uint32_t streamGeneration;
+		// True if sprite draws can start at an instance (GL 4.2), otherwise the instance attributes
+		// are pointed at the first instance of each draw.
+		bool baseInstance;
+		// Index of the first sprite instance and primitive vertex uploaded by the current flush.
+		uint32_t spriteBase;
+		uint32_t primitiveBase;
+		// Static batches to replay, indexed by RENDER_SHADER_STATIC commands.
+		// Copies, so clearing a batch after queueing it doesn't change what the queue draws.
+		struct StaticBatch* batches;
+		uint32_t batchCount;
+		uint32_t batchCapacity;
+		// The static batch being recorded, which holds back flushes until it ends.
+		struct StaticBatch* recording;
+		// The command, sprite instance and primitive vertex counts when the recording began.
+		// Only what was queued after them is recorded, the rest is drawn as usual.
+		uint32_t recordCommand;
+		uint32_t recordSprite;
+		uint32_t recordPrimitive;
+		// [sorted] when the recording began.
+		bool recordSorted;
+		// Incremented each time the queue is cleared, so static batches know if a replay of them is queued.
+		uint32_t generation;
+	} RenderQueue;
+
+	static RenderQueue renderQueue;
+
+	// Textures released by finalizers, which queued draws may still use.
+	// They are deleted after the end of frame flush, as flushing from a finalizer would break layer order.
+	static GLuint* renderDeletedTextures = NULL;
+	static uint32_t renderDeletedTextureCount = 0;
+	static uint32_t renderDeletedTextureCapacity = 0;
+
+	// Static batches cleared or collected mid frame, whose buffers queued replays may still use.
+	// They are deleted along with the textures.
+	static struct StaticBatch* renderDeletedBatches = NULL;
+	static uint32_t renderDeletedBatchCount = 0;
+	static uint32_t renderDeletedBatchCapacity = 0;
+
+	// Textures drawn by static batches, which keep them alive after their Sprites are collected.
+	typedef struct {
+		GLuint texture;
+		// Number of static batch draws sampling the texture.
+		uint32_t refs;
+		// True once the owner released the texture, so it is deleted with its last reference.
+		bool released;
+	} RenderTextureRef;
+
+	static RenderTextureRef* renderTextureRefs = NULL;
+	static uint32_t renderTextureRefCount = 0;
+	static uint32_t renderTextureRefCapacity = 0;
+
+	// State for the next command, changed by the camera, blend and clip APIs.
+	static RenderState renderState;
+	static bool renderStateDirty = true;
+	static int32_t renderLayer = 0;
+
+	// State last applied to OpenGL.
+	static RenderState renderStateApplied;
+	static bool renderStateAppliedValid = false;
+
+	// The Canvas being drawn to, or NULL for the main framebuffer.
+	static struct Canvas* canvasCurrent = NULL;
+
+	// Whether anything was drawn to the main framebuffer this frame, and whether the frame started with
+	// an unclipped Game.clear(). Frames that don't depend on the last one can be drawn straight into the
+	// window, see [mainFramebufferDirect].
+	static bool render_frameDrawn = false;
+	static bool render_frameCleared = false;
+
+	// Culling, toggled with Game.culling.
+	//
+	// Sprites, quads, text and particles wholly outside the camera's view are dropped as they are drawn,
+	// so they cost no upload or vertex work. Tilemaps cull whole chunks themselves, culling or not. Static batch recordings are never culled, as they are replayed with other cameras.
+	static bool render_culling = false;
+	// The camera's visible world rect, and the camera version it is for.
+	static float renderCullRect[4];
+	static bool renderCullRectValid = false;
+	static uint32_t renderCullVersion = UINT32_MAX;
+
+	bool renderCullQuad(float x1, float y1, float x2, float y2, float x3, float y3, float x4, float y4) {
+		if (!render_culling || renderQueue.recording) return false;
+
+		if (renderCullVersion != renderCameraVersion) {
+			renderCullRectValid = getCameraRect(renderCullRect);
+			renderCullVersion = renderCameraVersion;
 		}
 
-		return true;
+		if (!renderCullRectValid) return false;
+
+		float* r = renderCullRect;
+		bool culled =
+			(x1 < r[0] && x2 < r[0] && x3 < r[0] && x4 < r[0]) ||
+			(y1 < r[1] && y2 < r[1] && y3 < r[1] && y4 < r[1]) ||
+			(x1 > r[2] && x2 > r[2] && x3 > r[2] && x4 > r[2]) ||
+			(y1 > r[3] && y2 > r[3] && y3 > r[3] && y4 > r[3]);
+
+		if (culled) renderStats.culled++;
+		return culled;
 	}
 
-	Shader compileShader(ShaderData* data) {
-		StringBuilder sb;
-		int success;
+	void renderStateResetBlending() {
+		renderState.blendEquationRGB = GL_FUNC_ADD;
+		renderState.blendEquationAlpha = GL_FUNC_ADD;
+		renderState.blendSrcRGB = GL_SRC_ALPHA;
+		renderState.blendSrcAlpha = GL_ONE;
+		renderState.blendDstRGB = GL_ONE_MINUS_SRC_ALPHA;
+		renderState.blendDstAlpha = GL_ONE_MINUS_SRC_ALPHA;
+		renderStateDirty = true;
+	}
 
-		Shader result;
-		result.program = 0;
+	void renderStateResetScissor() {
+		renderState.scissor = false;
+		renderStateDirty = true;
+	}
 
-		sbInit(&sb);
+	// Sets the OpenGL blend and scissor state, only calling GL for what changed.
+	void renderStateApply(const RenderState* state) {
+		RenderState* gl = &renderStateApplied;
+		bool all = !renderStateAppliedValid;
 
-		// Compile vertex shader.
-		sbAddStr(&sb, "#version 330 core\n");
+		if (all || gl->blendEquationRGB != state->blendEquationRGB || gl->blendEquationAlpha != state->blendEquationAlpha) {
+			glBlendEquationSeparate(state->blendEquationRGB, state->blendEquationAlpha);
+			renderStats.stateChanges++;
+		}
 
-		for (int i = 0; i < data->attributeCount; i++) {
-			const char* attr = data->attributes[i];
+		if (
+			all ||
+			gl->blendSrcRGB != state->blendSrcRGB || gl->blendDstRGB != state->blendDstRGB ||
+			gl->blendSrcAlpha != state->blendSrcAlpha || gl->blendDstAlpha != state->blendDstAlpha
+		) {
+			glBlendFuncSeparate(state->blendSrcRGB, state->blendDstRGB, state->blendSrcAlpha, state->blendDstAlpha);
+			renderStats.stateChanges++;
+		}
 
-			sbAddStr(&sb, "layout(location = ");
-			sbAddByte(&sb, '0' + i);
-			sbAddStr(&sb, ") in ");
-			sbAddStr(&sb, attr);
-			sbAddStr(&sb, ";\n");
+		if (all || memcmp(gl->blendColor, state->blendColor, sizeof(state->blendColor)) != 0) {
+			glBlendColor(state->blendColor[0], state->blendColor[1], state->blendColor[2], state->blendColor[3]);
+			renderStats.stateChanges++;
 		}
-		
-		for (int i = 0; i < data->vertexUnifomCount; i++) {
-			const char* unif = data->vertexUniforms[i];
 
-			sbAddStr(&sb, "uniform ");
-			sbAddStr(&sb, unif);
-			sbAddStr(&sb, ";\n");
+		if (all || gl->scissor != state->scissor) {
+			if (state->scissor) {
+				glEnable(GL_SCISSOR_TEST);
+			} else {
+				glDisable(GL_SCISSOR_TEST);
+			}
+			renderStats.stateChanges++;
 		}
-		
-		for (int i = 0; i < data->varyingCount; i++) {
-			const char* vary = data->varyings[i];
 
-			sbAddStr(&sb, "out ");
-			sbAddStr(&sb, vary);
-			sbAddStr(&sb, ";\n");
+		if (state->scissor && (all || !gl->scissor || memcmp(gl->scissorRect, state->scissorRect, sizeof(state->scissorRect)) != 0)) {
+			glScissor(state->scissorRect[0], state->scissorRect[1], state->scissorRect[2], state->scissorRect[3]);
+			renderStats.stateChanges++;
 		}
 
-		sbAddStr(&sb, "void main() {\n");
-		sbAddStr(&sb, data->vertexShader);
-		sbAddByte(&sb, '}');
+		*gl = *state;
+		renderStateAppliedValid = true;
+	}
 
-		GLuint vs = glCreateShader(GL_VERTEX_SHADER);
-		glShaderSource(vs, 1, &sb.data, &sb.size);
-		glCompileShader(vs);
+	// Enables the attributes of a sprite vertex array, which still need pointing at instances.
+	void renderSetupSpriteVertexArray(GLuint vertexArray) {
+		glCacheBindVertexArray(vertexArray);
+		glBindBuffer(GL_ARRAY_BUFFER, renderQueue.spriteQuadBuffer);
+		glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 8, 0);
+		glEnableVertexAttribArray(0);
 
-		glGetShaderiv(vs, GL_COMPILE_STATUS, &success);
-		if (!success) {
-			char buffer[512];
-			glGetShaderInfoLog(vs, 512, NULL, buffer);
-			printf("vertex shader error: %s", buffer);
-			quitError = "compile vertex shader";
-		} else {
-			// Compiler fragment shader.
-			sb.size = 0;
+		// The instance attributes advance once per sprite.
+		for (GLuint i = 1; i <= 4; i++) {
+			glVertexAttribDivisor(i, 1);
+			glEnableVertexAttribArray(i);
+		}
+	}
 
-			sbAddStr(&sb, "#version 330 core\nout vec4 FragColor;\n");
-			
-			for (int i = 0; i < data->fragmentUnifomCount; i++) {
-				const char* unif = data->fragmentUniforms[i];
+	// Enables the attributes of a primitive vertex array, which still need pointing at vertices.
+	void renderSetupPrimitiveVertexArray(GLuint vertexArray) {
+		glCacheBindVertexArray(vertexArray);
+		glEnableVertexAttribArray(0);
+		glEnableVertexAttribArray(1);
+		bindQuadIndexBuffer(RENDER_QUEUE_MAX_QUADS * 6);
+	}
 
-				sbAddStr(&sb, "uniform ");
-				sbAddStr(&sb, unif);
-				sbAddStr(&sb, ";\n");
-			}
-			
-			for (int i = 0; i < data->varyingCount; i++) {
-				const char* vary = data->varyings[i];
+	bool renderQueueInit() {
+		void* spriteData = malloc(SPRITE_BUFFER_INITIAL_CAPACITY * SPRITE_INSTANCE_SIZE);
+		if (!spriteData) {
+			return false;
+		}
 
-				sbAddStr(&sb, "in ");
-				sbAddStr(&sb, vary);
-				sbAddStr(&sb, ";\n");
-			}
+		renderQueue.sprites.capacity = SPRITE_BUFFER_INITIAL_CAPACITY;
+		renderQueue.sprites.instanceCount = 0;
+		renderQueue.sprites.instanceData = spriteData;
 
-			sbAddStr(&sb, "void main() {\n");
-			sbAddStr(&sb, data->fragmentShader);
-			sbAddByte(&sb, '}');
+		if (!primitiveBatcherInit(&renderQueue.primitives)) {
+			return false;
+		}
+		renderQueue.primitives.vertexCount = 0;
 
-			GLuint fs = glCreateShader(GL_FRAGMENT_SHADER);
-			glShaderSource(fs, 1, &sb.data, &sb.size);
-			glCompileShader(fs);
+		renderQueue.commands = NULL;
+		renderQueue.commandCount = 0;
+		renderQueue.commandCapacity = 0;
+		renderQueue.states = NULL;
+		renderQueue.stateCount = 0;
+		renderQueue.stateCapacity = 0;
+		renderQueue.sorted = true;
+		renderQueue.batches = NULL;
+		renderQueue.batchCount = 0;
+		renderQueue.batchCapacity = 0;
+		renderQueue.recording = NULL;
+		renderQueue.recordCommand = 0;
+		renderQueue.recordSprite = 0;
+		renderQueue.recordPrimitive = 0;
+		renderQueue.generation = 1;
 
-			glGetShaderiv(fs, GL_COMPILE_STATUS, &success);
-			if (!success) {
-				char buffer[512];
-				glGetShaderInfoLog(fs, 512, NULL, buffer);
-				printf("fragment shader error: %s", buffer);
-				quitError = "compile fragment shader";
-			} else {
-				// Link program.
-				GLuint prog = glCreateProgram();
-				glAttachShader(prog, vs);
-				glAttachShader(prog, fs);
-				glLinkProgram(prog);
+		glCacheInvalidate();
 
-				glGetProgramiv(prog, GL_LINK_STATUS, &success);
-				if(!success) {
-					char buffer[512];
-					glGetProgramInfoLog(fs, 512, NULL, buffer);
-					printf("program error: %s", buffer);
-					quitError = "link program";
-				} else {
-					result.program = prog;
+		// Vertex arrays are set up once, and only re-pointed when the stream buffer is replaced.
+		glGenVertexArrays(1, &renderQueue.spriteVertexArray);
+		glGenVertexArrays(1, &renderQueue.primitiveVertexArray);
+		renderQueue.streamGeneration = 0;
+		renderQueue.baseInstance = GLAD_GL_VERSION_4_2;
 
-					// Get uniform locations.
-					glUseProgram(prog);
-					
-					bool vuOK = compilerShaderUniformLocations(&result, data->vertexUnifomCount, data->vertexUniforms, 0);
-					bool fuOK = compilerShaderUniformLocations(&result, data->fragmentUnifomCount, data->fragmentUniforms, data->vertexUnifomCount);
+		// Corners in the same order as the quad indices, drawn as a strip.
+		static const float quad[8] = { 0, 0, 0, 1, 1, 0, 1, 1 };
 
-					glUseProgram(0);
+		glGenBuffers(1, &renderQueue.spriteQuadBuffer);
+		glBindBuffer(GL_ARRAY_BUFFER, renderQueue.spriteQuadBuffer);
+		glBufferData(GL_ARRAY_BUFFER, sizeof(quad), quad, GL_STATIC_DRAW);
 
-					if (!vuOK || !fuOK) {
-						glDeleteProgram(result.program);
-						result.program = 0;
-					}
-				}
-			}
-			
-			glDeleteShader(fs);
+		renderSetupSpriteVertexArray(renderQueue.spriteVertexArray);
+		renderSetupPrimitiveVertexArray(renderQueue.primitiveVertexArray);
+
+		// Sampler i reads texture unit i.
+		GLint units[RENDER_TEXTURE_SLOTS];
+		for (int i = 0; i < RENDER_TEXTURE_SLOTS; i++) {
+			units[i] = i;
 		}
-		
-		glDeleteShader(vs);
 
-		// Free string builder.
-		sbFree(&sb);
+		glCacheUseProgram(shaderSpriteBatcher.program);
+		glUniform1iv(shaderSpriteBatcher.uniforms[1], RENDER_TEXTURE_SLOTS, units);
 
-		// Done!
-		return result;
+		renderStateResetBlending();
+		renderStateResetScissor();
+		for (int i = 0; i < 4; i++) {
+			renderState.blendColor[i] = 0;
+		}
+
+		return true;
 	}
 
+	// Returns the index of the state for the next command, recording [renderState] if it changed.
+	// Returns UINT32_MAX if out of memory.
+	uint32_t renderQueueState() {
+		if (renderStateDirty || renderQueue.stateCount == 0) {
+			if (renderQueue.stateCount == renderQueue.stateCapacity) {
+				uint32_t capacity = renderQueue.stateCapacity == 0 ? 16 : renderQueue.stateCapacity * 2;
+				RenderState* states = (RenderState*)realloc(renderQueue.states, capacity * sizeof(RenderState));
+				if (!states) return UINT32_MAX;
 
-	// = SHADERS =
+				renderQueue.states = states;
+				renderQueue.stateCapacity = capacity;
+			}
 
-	static ShaderData shaderDataSpriteBatcher = {
-		// Attributes
-		3, {
-			"vec3 vertex",
-			"vec4 color",
-			"vec2 uv",
-		},
-		// Vertex Uniforms
-		1, {
-			"mat3 m",
-		},
-		// Fragment Uniforms
-		1, {
-			"sampler2D tex",
-		},
-		// Varyings
-		2, {
-			"vec4 v_color",
-			"vec2 v_uv",
-		},
-		// Vertex Shader
-		"v_color = color;\n"
-		"v_uv = uv;\n"
-		"vec3 a = m * vec3(vertex.xy, 1.0);\n"
-		"gl_Position = vec4(a.xy, vertex.z, 1.0);\n"
-		,
-		// Fragment Shader
-		"FragColor = texture(tex, v_uv) * v_color;\n"
-	};
-	
-	static ShaderData shaderDataPrimitiveBatcher = {
-		// Attributes
-		2, {
-			"vec3 vertex",
-			"vec4 color",
-		},
-		// Vertex Uniforms
-		1, {
-			"mat3 m",
-		},
-		// Fragment Uniforms
-		0, { 0 },
-		// Varyings
-		1, {
-			"vec4 v_color",
-		},
-		// Vertex Shader
-		"v_color = color;\n"
-		"vec3 a = m * vec3(vertex.xy, 1.0);\n"
-		"gl_Position = vec4(a.xy, vertex.z, 1.0);\n"
-		,
-		// Fragment Shader
-		"FragColor = v_color;\n"
-	};
-	
-	static ShaderData shaderDataFramebuffer = {
-		// Attributes
-		1, {
-			"vec2 vertex",
-		},
-		// Vertex Uniforms
-		0, { 0 },
-		// Fragment Uniforms
-		1, {
-			"sampler2D tex",
-		},
-		// Varyings
-		1, {
-			"vec2 v_uv",
-		},
-		// Vertex Shader
-		"v_uv = 0.5 + vertex * 0.5;\n"
-		"gl_Position = vec4(vertex, 0.0, 1.0);\n"
-		,
-		// Fragment Shader
-		"FragColor = texture(tex, v_uv);\n"
-	};
+			RenderState* state = &renderQueue.states[renderQueue.stateCount++];
+			*state = renderState;
+			memcpy(state->camera, getCameraMatrix(), sizeof(state->camera));
+			state->cameraVersion = renderCameraVersion;
 
-	static const char* SOCK_FILTER_LINEAR = "linear";
-	static const char* SOCK_FILTER_NEAREST = "nearest";
+			renderStateDirty = false;
+		}
 
-	static const char* SOCK_WRAP_CLAMP = "clamp";
-	static const char* SOCK_WRAP_REPEAT = "repeat";
-	static const char* SOCK_WRAP_MIRROR = "mirror";
-	
-	static const char* SOCK_BLEND_EQUATION_ADD = "add";
-	static const char* SOCK_BLEND_EQUATION_SUBTRACT = "subtract";
-	static const char* SOCK_BLEND_EQUATION_REVERSE_SUBTRACT = "reverse_subtract";
-	static const char* SOCK_BLEND_EQUATION_MIN = "min";
-	static const char* SOCK_BLEND_EQUATION_MAX = "max";
+		return renderQueue.stateCount - 1;
+	}
 
-	static const char* SOCK_BLEND_CONSTANT_ZERO = "zero";
-	static const char* SOCK_BLEND_CONSTANT_ONE = "one";
-	static const char* SOCK_BLEND_CONSTANT_SRC_COLOR = "src_color";
-	static const char* SOCK_BLEND_CONSTANT_SRC_ALPHA = "src_alpha";
-	static const char* SOCK_BLEND_CONSTANT_DST_COLOR = "dst_color";
-	static const char* SOCK_BLEND_CONSTANT_DST_ALPHA = "dst_alpha";
-	static const char* SOCK_BLEND_CONSTANT_CONSTANT_COLOR = "constant_color";
-	static const char* SOCK_BLEND_CONSTANT_CONSTANT_ALPHA = "constant_alpha";
-	static const char* SOCK_BLEND_CONSTANT_ONE_MINUS_SRC_COLOR = "one_minus_src_color";
-	static const char* SOCK_BLEND_CONSTANT_ONE_MINUS_SRC_ALPHA = "one_minus_src_alpha";
-	static const char* SOCK_BLEND_CONSTANT_ONE_MINUS_DST_COLOR = "one_minus_dst_color";
-	static const char* SOCK_BLEND_CONSTANT_ONE_MINUS_DST_ALPHA = "one_minus_dst_alpha";
-	static const char* SOCK_BLEND_CONSTANT_ONE_MINUS_CONSTANT_COLOR = "one_minus_constant_color";
-	static const char* SOCK_BLEND_CONSTANT_ONE_MINUS_CONSTANT_ALPHA = "one_minus_constant_alpha";
+	// Records a command drawing [count] of the queue's [shader] instances or vertices, starting at [first].
+	void renderQueueAdd(uint32_t shader, GLuint texture, uint32_t first, uint32_t count) {
+		if (count == 0) return;
 
-	GLuint filterStringToGlEnum(const char* filter) {
-		if (strcmp(SOCK_FILTER_LINEAR, filter) == 0) return GL_LINEAR;
-		if (strcmp(SOCK_FILTER_NEAREST, filter) == 0) return GL_NEAREST;
-		return 0;
-	}
-	
-	GLuint wrapStringToGlEnum(const char* wrap) {
-		if (strcmp(SOCK_WRAP_CLAMP, wrap) == 0) return GL_CLAMP_TO_EDGE;
-		if (strcmp(SOCK_WRAP_REPEAT, wrap) == 0) return GL_REPEAT;
-		if (strcmp(SOCK_WRAP_MIRROR, wrap) == 0) return GL_MIRRORED_REPEAT;
-		return 0;
+		uint32_t state = renderQueueState();
+		if (state == UINT32_MAX) return;
+
+		uint64_t layer = (uint64_t)((int64_t)renderLayer - INT32_MIN);
+
+		// Commands recorded into a static batch don't merge or sort with those queued before it.
+		if (renderQueue.commandCount > renderQueue.recordCommand) {
+			RenderCommand* last = &renderQueue.commands[renderQueue.commandCount - 1];
+			uint64_t lastLayer = last->key >> 32;
+
+			// Extend the last command if nothing changed since.
+			if (
+				lastLayer == layer && last->shader == shader && last->texture == texture && last->state == state &&
+				last->first + last->count == first
+			) {
+				last->count += count;
+				return;
+			}
+
+			if (layer < lastLayer) renderQueue.sorted = false;
+		}
+
+		if (renderQueue.commandCount == renderQueue.commandCapacity) {
+			uint32_t capacity = renderQueue.commandCapacity == 0 ? 64 : renderQueue.commandCapacity * 2;
+			RenderCommand* commands = (RenderCommand*)realloc(renderQueue.commands, capacity * sizeof(RenderCommand));
+			if (!commands) return;
+
+			renderQueue.commands = commands;
+			renderQueue.commandCapacity = capacity;
+		}
+
+		RenderCommand* cmd = &renderQueue.commands[renderQueue.commandCount];
+		cmd->key = (layer << 32) | renderQueue.commandCount;
+		cmd->texture = texture;
+		cmd->shader = shader;
+		cmd->state = state;
+		cmd->first = first;
+		cmd->count = count;
+
+		renderQueue.commandCount++;
 	}
-	
-	GLenum blendEquationStringToGlEnum(const char* eq) {
-		if (strcmp(SOCK_BLEND_EQUATION_ADD, eq) == 0) return GL_FUNC_ADD;
-		if (strcmp(SOCK_BLEND_EQUATION_SUBTRACT, eq) == 0) return GL_FUNC_SUBTRACT;
-		if (strcmp(SOCK_BLEND_EQUATION_REVERSE_SUBTRACT, eq) == 0) return GL_FUNC_REVERSE_SUBTRACT;
-		if (strcmp(SOCK_BLEND_EQUATION_MIN, eq) == 0) return GL_MIN;
-		if (strcmp(SOCK_BLEND_EQUATION_MAX, eq) == 0) return GL_MAX;
-		return 0;
+
+	// Immediate draws write straight into the queue's instances and vertices.
+	// Draw into the returned batcher, then call [renderQueueEndSprites()] with the texture.
+	SpriteBatcher* renderQueueBeginSprites() {
+		renderQueue.mark = renderQueue.sprites.instanceCount;
+		return &renderQueue.sprites;
 	}
 
-	GLenum blendConstantStringToGlEnum(const char* cnst) {
-		if (strcmp(SOCK_BLEND_CONSTANT_ZERO, cnst) == 0) return GL_ZERO;
-		if (strcmp(SOCK_BLEND_CONSTANT_ONE, cnst) == 0) return GL_ONE;
-		if (strcmp(SOCK_BLEND_CONSTANT_SRC_COLOR, cnst) == 0) return GL_SRC_COLOR;
-		if (strcmp(SOCK_BLEND_CONSTANT_SRC_ALPHA, cnst) == 0) return GL_SRC_ALPHA;
-		if (strcmp(SOCK_BLEND_CONSTANT_DST_COLOR, cnst) == 0) return GL_DST_COLOR;
-		if (strcmp(SOCK_BLEND_CONSTANT_DST_ALPHA, cnst) == 0) return GL_DST_ALPHA;
-		if (strcmp(SOCK_BLEND_CONSTANT_CONSTANT_COLOR, cnst) == 0) return GL_CONSTANT_COLOR;
-		if (strcmp(SOCK_BLEND_CONSTANT_CONSTANT_ALPHA, cnst) == 0) return GL_CONSTANT_ALPHA;
-		if (strcmp(SOCK_BLEND_CONSTANT_ONE_MINUS_SRC_COLOR, cnst) == 0) return GL_ONE_MINUS_SRC_COLOR;
-		if (strcmp(SOCK_BLEND_CONSTANT_ONE_MINUS_SRC_ALPHA, cnst) == 0) return GL_ONE_MINUS_SRC_ALPHA;
-		if (strcmp(SOCK_BLEND_CONSTANT_ONE_MINUS_DST_COLOR, cnst) == 0) return GL_ONE_MINUS_DST_COLOR;
-		if (strcmp(SOCK_BLEND_CONSTANT_ONE_MINUS_DST_ALPHA, cnst) == 0) return GL_ONE_MINUS_DST_ALPHA;
-		if (strcmp(SOCK_BLEND_CONSTANT_ONE_MINUS_CONSTANT_COLOR, cnst) == 0) return GL_ONE_MINUS_CONSTANT_COLOR;
-		if (strcmp(SOCK_BLEND_CONSTANT_ONE_MINUS_CONSTANT_ALPHA, cnst) == 0) return GL_ONE_MINUS_CONSTANT_ALPHA;
-		return 2;
+	void renderQueueEndSprites(GLuint textureID) {
+		renderQueueAdd(RENDER_SHADER_SPRITE, textureID, renderQueue.mark, renderQueue.sprites.instanceCount - renderQueue.mark);
 	}
 
-	GLuint wren_filterStringToGlEnum(WrenVM* vm, int slot) {
-		if (wrenGetSlotType(vm, slot) != WREN_TYPE_STRING) {
-			wrenAbort(vm, "filter type must be a string");
-			return 0;
-		}
-		
-		GLuint filter = filterStringToGlEnum(wrenGetSlotString(vm, slot));
-		if (filter == 0) {
-			wrenAbort(vm, "invalid filter type");
-		}
-		
-		return filter;
+	PrimitiveBatcher* renderQueueBeginPrimitives() {
+		renderQueue.mark = renderQueue.primitives.vertexCount;
+		return &renderQueue.primitives;
 	}
-	
-	GLuint wren_wrapStringToGlEnum(WrenVM* vm, int slot) {
-		if (wrenGetSlotType(vm, slot) != WREN_TYPE_STRING) {
-			wrenAbort(vm, "wrap type must be a string");
-			return 0;
-		}
-		
-		GLuint filter = wrapStringToGlEnum(wrenGetSlotString(vm, slot));
-		if (filter == 0) {
-			wrenAbort(vm, "invalid wrap type");
-		}
 
-		return filter;
+	void renderQueueEndPrimitives() {
+		renderQueueAdd(RENDER_SHADER_PRIMITIVE, 0, renderQueue.mark, renderQueue.primitives.vertexCount - renderQueue.mark);
 	}
-	
-	GLenum wren_blendEquationStringToGlEnum(WrenVM* vm, int slot) {
-		if (wrenGetSlotType(vm, slot) != WREN_TYPE_STRING) {
-			wrenAbort(vm, "blend equation must be a string");
-			return 0;
+
+	// End a sprite batch, queueing its instances.
+	void spriteBatcherEnd(SpriteBatcher* sb, GLuint textureID) {
+		if (sb && sb->instanceCount != 0) {
+			SpriteBatcher* queue = renderQueueBeginSprites();
+
+			if (spriteBatcherCheckResize(queue, sb->instanceCount)) {
+				memcpy((uint8_t*)queue->instanceData + queue->instanceCount * SPRITE_INSTANCE_SIZE, sb->instanceData, sb->instanceCount * SPRITE_INSTANCE_SIZE);
+				queue->instanceCount += sb->instanceCount;
+			}
+
+			renderQueueEndSprites(textureID);
 		}
-		
-		GLenum eq = blendEquationStringToGlEnum(wrenGetSlotString(vm, slot));
-		if (eq == 0) {
-			wrenAbort(vm, "invalid blend equation");
+	}
+
+	// End a primitive batch, queueing its vertices.
+	void primitiveBatcherEnd(PrimitiveBatcher* pb) {
+		if (pb) {
+			if (pb->vertexCount != 0) {
+				PrimitiveBatcher* queue = renderQueueBeginPrimitives();
+
+				if (primitiveBatcherCheckResize(queue, pb->vertexCount)) {
+					memcpy((float*)queue->vertexData + queue->vertexCount * 4, pb->vertexData, pb->vertexCount * 16);
+					queue->vertexCount += pb->vertexCount;
+				}
+
+				renderQueueEndPrimitives();
+			}
+
+			// Mark as out of batch.
+			pb->vertexCount = UINT32_MAX;
 		}
+	}
 
-		return eq;
+	int renderCommandCompare(const void* a, const void* b) {
+		uint64_t ka = ((const RenderCommand*)a)->key;
+		uint64_t kb = ((const RenderCommand*)b)->key;
+		return ka < kb ? -1 : (ka > kb ? 1 : 0);
 	}
-	
-	GLenum wren_blendConstantStringToGlEnum(WrenVM* vm, int slot) {
-		if (wrenGetSlotType(vm, slot) != WREN_TYPE_STRING) {
-			wrenAbort(vm, "blend constant must be a string");
-			return 0;
-		}
-		
-		GLenum cnst = blendConstantStringToGlEnum(wrenGetSlotString(vm, slot));
-		if (cnst == 2) {
-			wrenAbort(vm, "invalid blend constant");
+
+	// Copies the data of [shader] into the order of [commands], so commands that merge are contiguous.
+	void* renderQueueGather(RenderCommand* commands, uint32_t commandCount, uint32_t shader, const void* data, uint32_t count, uint32_t stride) {
+		uint8_t* sorted = (uint8_t*)frameAlloc((size_t)count * stride);
+		if (!sorted) return NULL;
+
+		uint32_t element = 0;
+		for (uint32_t i = 0; i < commandCount; i++) {
+			RenderCommand* cmd = &commands[i];
+			if (cmd->shader != shader) continue;
+
+			memcpy(sorted + element * stride, (const uint8_t*)data + cmd->first * stride, cmd->count * stride);
+			cmd->first = element;
+			element += cmd->count;
 		}
 
-		return cnst;
+		return sorted;
 	}
 
-	const char* glFilterEnumToString(GLuint filter) {
-		if (filter == GL_LINEAR) return SOCK_FILTER_LINEAR;
-		if (filter == GL_NEAREST) return SOCK_FILTER_NEAREST;
-		return NULL;
+	// Points the bound vertex array's sprite instance attributes at instance [first] of [buffer].
+	void renderPointSpriteInstances(GLuint buffer, uint32_t first) {
+		uintptr_t offset = (uintptr_t)first * SPRITE_INSTANCE_SIZE;
+
+		glBindBuffer(GL_ARRAY_BUFFER, buffer);
+		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, SPRITE_INSTANCE_SIZE, (void*)offset);
+		glVertexAttribPointer(2, 4, GL_UNSIGNED_BYTE, GL_TRUE, SPRITE_INSTANCE_SIZE, (void*)(offset + 12));
+		glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, SPRITE_INSTANCE_SIZE, (void*)(offset + 16));
+		glVertexAttribPointer(4, 4, GL_FLOAT, GL_FALSE, SPRITE_INSTANCE_SIZE, (void*)(offset + 32));
 	}
-	
-	const char* glWrapEnumToString(GLuint wrap) {
-		if (wrap == GL_CLAMP_TO_EDGE) return SOCK_WRAP_CLAMP;
-		if (wrap == GL_REPEAT) return SOCK_WRAP_REPEAT;
-		if (wrap == GL_MIRRORED_REPEAT) return SOCK_WRAP_MIRROR;
-		return NULL;
+
+	// Points the bound vertex array's primitive attributes at the start of [buffer].
+	void renderPointPrimitiveVertices(GLuint buffer) {
+		glBindBuffer(GL_ARRAY_BUFFER, buffer);
+		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 16, (void*)0);
+		glVertexAttribPointer(1, 4, GL_UNSIGNED_BYTE, GL_TRUE, 16, (void*)12);
 	}
 
-	static GLuint systemFontTexture = 0;
+	// Points the vertex arrays at the start of the stream buffer, if it was replaced since.
+	// Draws then address their data with a base vertex or instance.
+	void renderQueuePointVertexArrays() {
+		if (renderQueue.streamGeneration == streamBufferGeneration) return;
+		renderQueue.streamGeneration = streamBufferGeneration;
 
-	int systemFontDraw(const char* str, int cornerX, int cornerY, uint32_t color) {
-		// Load GIF sprite.
-		if (systemFontTexture == 0) {
-			// Load from constant.
-			int width, height, channelCount;
-			stbi_uc* data = stbi_load_from_memory(COZETTE, COZETTE_LENGTH, &width, &height, &channelCount, 4);
+		glCacheBindVertexArray(renderQueue.spriteVertexArray);
+		renderPointSpriteInstances(streamBuffer, 0);
 
-			if (!data) {
-				wrenAbort(vm, stbi_failure_reason());
-				return cornerY;
-			}
+		glCacheBindVertexArray(renderQueue.primitiveVertexArray);
+		renderPointPrimitiveVertices(streamBuffer);
+	}
 
-			// Load into WebGL texture.
-			glGenTextures(1, &systemFontTexture);
-			glBindTexture(GL_TEXTURE_2D, systemFontTexture);
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
+	// Uploads the sprite instances and primitive vertices of the current flush.
+	void renderQueueUpload(const void* spriteData, uint32_t spriteCount, const void* primitiveData, uint32_t primitiveCount) {
+		// Put as one region, as a second put could orphan the storage holding the first.
+		// Sprite instances are a multiple of 16 bytes, so the primitive vertices after them stay aligned.
+		const void* data[2] = { spriteData, primitiveData };
+		uint32_t bytes[2] = { spriteCount * SPRITE_INSTANCE_SIZE, primitiveCount * 16 };
+		uint32_t offset = streamBufferPut(data, bytes, 2, SPRITE_INSTANCE_SIZE);
 
-			stbi_image_free(data);
-		}
+		renderQueue.spriteBase = offset / SPRITE_INSTANCE_SIZE;
+		renderQueue.primitiveBase = (offset + bytes[0]) / 16;
 
-		// Draw sprites.
-		SpriteBatcher* sb = spriteBatcherTemp();
+		renderQueuePointVertexArrays();
+	}
 
-		spriteBatcherBegin(sb);
+	// A run of merged commands, drawn with a single call.
+	typedef struct {
+		uint32_t shader;
+		uint32_t state;
+		uint32_t first;
+		uint32_t count;
+		// Textures bound to units 0..textureCount for a sprite draw.
+		uint32_t textureCount;
+		GLuint textures[RENDER_TEXTURE_SLOTS];
+	} RenderDraw;
+
+	// Draws recorded once into static buffers, and replayed with the state they are drawn with.
+	typedef struct StaticBatch {
+		GLuint spriteBuffer;
+		GLuint primitiveBuffer;
+		GLuint spriteVertexArray;
+		GLuint primitiveVertexArray;
+		// The recorded draws, addressing the batch's buffers from 0.
+		RenderDraw* draws;
+		uint32_t drawCount;
+		// The [renderQueue.generation] it was last queued in, 0 if never.
+		uint32_t queuedGeneration;
+	} StaticBatch;
+
+	// Returns the texture unit [texture] is sampled from in [draw], adding it if there is a free unit.
+	// Returns UINT32_MAX if all units are used.
+	uint32_t renderDrawTextureSlot(RenderDraw* draw, GLuint texture) {
+		for (uint32_t i = 0; i < draw->textureCount; i++) {
+			if (draw->textures[i] == texture) return i;
+		}
+
+		if (draw->textureCount == (uint32_t)renderQueue_textureSlots) return UINT32_MAX;
+
+		draw->textures[draw->textureCount] = texture;
+		return draw->textureCount++;
+	}
+
+	// Merges consecutive [commands] into draws, writing the texture slot of each sprite instance.
+	// Returns the number of draws written to [draws].
+	uint32_t renderQueuePlan(const RenderCommand* commands, uint32_t commandCount, RenderDraw* draws, float* spriteData, void* primitiveData) {
+		uint32_t drawCount = 0;
+
+		for (uint32_t i = 0; i < commandCount; i++) {
+			const RenderCommand* cmd = &commands[i];
+			bool isSprite = cmd->shader == RENDER_SHADER_SPRITE;
+
+			// Static batches already have their draws.
+			if (cmd->shader == RENDER_SHADER_STATIC) {
+				RenderDraw* draw = &draws[drawCount++];
+				draw->shader = cmd->shader;
+				draw->state = cmd->state;
+				draw->first = cmd->first;
+				draw->count = cmd->count;
+				draw->textureCount = 0;
+				continue;
+			}
+
+			if ((isSprite ? (void*)spriteData : primitiveData) == NULL) continue;
+
+			RenderDraw* draw = drawCount == 0 ? NULL : &draws[drawCount - 1];
+			uint32_t slot = 0;
+
+			bool merge = draw && draw->shader == cmd->shader && draw->state == cmd->state && draw->first + draw->count == cmd->first;
+			if (merge && isSprite) {
+				slot = renderDrawTextureSlot(draw, cmd->texture);
+				merge = slot != UINT32_MAX;
+			}
+
+			if (!merge) {
+				draw = &draws[drawCount++];
+				draw->shader = cmd->shader;
+				draw->state = cmd->state;
+				draw->first = cmd->first;
+				draw->count = 0;
+				draw->textureCount = 0;
+
+				slot = isSprite ? renderDrawTextureSlot(draw, cmd->texture) : 0;
+			}
+
+			draw->count += cmd->count;
+
+			if (isSprite) {
+				float* z = spriteData + cmd->first * 12 + 2;
+				float* end = z + cmd->count * 12;
+
+				for ( ; z < end; z += 12) {
+					*z = (float)slot;
+				}
+			}
+		}
+
+		return drawCount;
+	}
+
+	// Sorts [commands], unless already [sorted], and merges them into draws, returning how many were written to [draws].
+	// [spriteData] and [primitiveData] hold the [spriteCount] instances and [primitiveCount] vertices the commands
+	// address, and are set to them in draw order, or NULL if there are none.
+	uint32_t renderQueuePrepare(
+		RenderCommand* commands, uint32_t commandCount, bool sorted, RenderDraw** draws,
+		void** spriteData, uint32_t spriteCount, void** primitiveData, uint32_t primitiveCount
+	) {
+		if (!spriteCount) *spriteData = NULL;
+		if (!primitiveCount) *primitiveData = NULL;
+
+		if (!sorted) {
+			qsort(commands, commandCount, sizeof(RenderCommand), renderCommandCompare);
+
+			if (spriteCount) *spriteData = renderQueueGather(commands, commandCount, RENDER_SHADER_SPRITE, *spriteData, spriteCount, SPRITE_INSTANCE_SIZE);
+			if (primitiveCount) *primitiveData = renderQueueGather(commands, commandCount, RENDER_SHADER_PRIMITIVE, *primitiveData, primitiveCount, 16);
+		}
+
+		// Commands without data are left out of the plan.
+		*draws = (RenderDraw*)frameAlloc(commandCount * sizeof(RenderDraw));
+		return *draws ? renderQueuePlan(commands, commandCount, *draws, *spriteData, *primitiveData) : 0;
+	}
+
+	// Drops all queued commands.
+	void renderQueueClear() {
+		renderQueue.commandCount = 0;
+		renderQueue.stateCount = 0;
+		renderQueue.batchCount = 0;
+		renderQueue.sprites.instanceCount = 0;
+		renderQueue.primitives.vertexCount = 0;
+		renderQueue.sorted = true;
+		renderStateDirty = true;
+		renderQueue.generation++;
+	}
+
+	// Draws [draw] from [vertexArray], whose data starts at instance or vertex [base] of [buffer].
+	void renderDrawSubmit(const RenderDraw* draw, const RenderState* state, GLuint vertexArray, GLuint buffer, uint32_t base) {
+		uint32_t shader = draw->shader;
+		Shader* program = shader == RENDER_SHADER_SPRITE ? &shaderSpriteBatcher : &shaderPrimitiveBatcher;
+
+		glCacheUseProgram(program->program);
+		glCacheBindVertexArray(vertexArray);
+		renderStateApply(state);
+
+		// Uniforms belong to the program, so each keeps the camera it was last given.
+		if (glCache.cameraVersion[shader] != state->cameraVersion) {
+			glCache.cameraVersion[shader] = state->cameraVersion;
+			glUniformMatrix3fv(program->uniforms[0], 1, GL_FALSE, state->camera);
+		}
+
+		for (uint32_t slot = 0; slot < draw->textureCount; slot++) {
+			if (glCacheBindTexture(slot, draw->textures[slot])) {
+				renderStats.textureBinds++;
+			}
+		}
+
+		// Draw!
+		if (shader == RENDER_SHADER_SPRITE) {
+			uint32_t first = base + draw->first;
+
+			if (renderQueue.baseInstance) {
+				glDrawArraysInstancedBaseInstance(GL_TRIANGLE_STRIP, 0, 4, draw->count, first);
+			} else {
+				renderPointSpriteInstances(buffer, first);
+				glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, draw->count);
+			}
+
+			renderStatsDraw(draw->count * 4);
+			return;
+		}
+
+		uint32_t firstVertex = base + draw->first;
+		uint32_t vertexCount = draw->count;
+
+		while (vertexCount != 0) {
+			uint32_t n = vertexCount < RENDER_QUEUE_MAX_QUADS * 4 ? vertexCount : RENDER_QUEUE_MAX_QUADS * 4;
+
+			// 6 indices for every 4 vertices. 6:4 -> 3:2
+			glDrawElementsBaseVertex(GL_TRIANGLES, (n * 3) / 2, GL_UNSIGNED_SHORT, 0, firstVertex);
+			renderStatsDraw(n);
+
+			firstVertex += n;
+			vertexCount -= n;
+		}
+	}
+
+	// Replays the draws of [batch] with [state].
+	void staticBatchReplay(StaticBatch* batch, const RenderState* state) {
+		for (uint32_t i = 0; i < batch->drawCount; i++) {
+			RenderDraw* draw = &batch->draws[i];
+
+			if (draw->shader == RENDER_SHADER_SPRITE) {
+				renderDrawSubmit(draw, state, batch->spriteVertexArray, batch->spriteBuffer, 0);
+			} else {
+				renderDrawSubmit(draw, state, batch->primitiveVertexArray, batch->primitiveBuffer, 0);
+			}
+		}
+	}
+
+	// Draws and clears all queued commands.
+	// While a static batch is recording, commands stay queued until it ends.
+	void renderQueueFlush() {
+		if (renderQueue.commandCount == 0 || renderQueue.recording) return;
+
+		profilerBegin("renderQueueFlush");
+
+		RenderDraw* draws;
+		void* spriteData = renderQueue.sprites.instanceData;
+		void* primitiveData = renderQueue.primitives.vertexData;
+		uint32_t drawCount = renderQueuePrepare(
+			renderQueue.commands, renderQueue.commandCount, renderQueue.sorted, &draws,
+			&spriteData, renderQueue.sprites.instanceCount, &primitiveData, renderQueue.primitives.vertexCount
+		);
+
+		uint32_t spriteCount = spriteData ? renderQueue.sprites.instanceCount : 0;
+		uint32_t primitiveCount = primitiveData ? renderQueue.primitives.vertexCount : 0;
+		renderQueueUpload(spriteData, spriteCount, primitiveData, primitiveCount);
+
+		for (uint32_t i = 0; i < drawCount; i++) {
+			RenderDraw* draw = &draws[i];
+			RenderState* state = &renderQueue.states[draw->state];
+
+			if (draw->shader == RENDER_SHADER_STATIC) {
+				for (uint32_t b = draw->first; b < draw->first + draw->count; b++) {
+					staticBatchReplay(&renderQueue.batches[b], state);
+				}
+			} else if (draw->shader == RENDER_SHADER_SPRITE) {
+				renderDrawSubmit(draw, state, renderQueue.spriteVertexArray, streamBuffer, renderQueue.spriteBase);
+			} else {
+				renderDrawSubmit(draw, state, renderQueue.primitiveVertexArray, streamBuffer, renderQueue.primitiveBase);
+			}
+		}
+
+		// Only now that every draw reading them is issued.
+		streamBufferFence();
+
+		renderQueueClear();
+
+		if (!canvasCurrent) render_frameDrawn = true;
+
+		profilerEnd();
+	}
+
+	// Deletes [texture] once the draws queued this frame are flushed, and no static batch draws it.
+	void renderDeleteTexture(GLuint texture) {
+		if (texture == 0) return;
+
+		if (renderDeletedTextureCount == renderDeletedTextureCapacity) {
+			uint32_t capacity = renderDeletedTextureCapacity ? renderDeletedTextureCapacity * 2 : 64;
+			GLuint* textures = realloc(renderDeletedTextures, capacity * sizeof(GLuint));
+
+			// Out of memory, so leak the texture rather than risk drawing a deleted one.
+			if (!textures) return;
+
+			renderDeletedTextures = textures;
+			renderDeletedTextureCapacity = capacity;
+		}
+
+		renderDeletedTextures[renderDeletedTextureCount++] = texture;
+	}
+
+	// Returns the static batch references of [texture], or NULL if no batch draws it.
+	RenderTextureRef* renderFindTextureRef(GLuint texture) {
+		for (uint32_t i = 0; i < renderTextureRefCount; i++) {
+			if (renderTextureRefs[i].texture == texture) return &renderTextureRefs[i];
+		}
+
+		return NULL;
+	}
+
+	// Adds a static batch reference to [texture].
+	void renderRetainTexture(GLuint texture) {
+		RenderTextureRef* ref = renderFindTextureRef(texture);
+
+		if (!ref) {
+			if (renderTextureRefCount == renderTextureRefCapacity) {
+				uint32_t capacity = renderTextureRefCapacity ? renderTextureRefCapacity * 2 : 16;
+				RenderTextureRef* refs = realloc(renderTextureRefs, capacity * sizeof(RenderTextureRef));
+				if (!refs) return;
+
+				renderTextureRefs = refs;
+				renderTextureRefCapacity = capacity;
+			}
+
+			ref = &renderTextureRefs[renderTextureRefCount++];
+			ref->texture = texture;
+			ref->refs = 0;
+			ref->released = false;
+		}
+
+		ref->refs++;
+	}
+
+	// Removes a static batch reference to [texture], deleting it if it was the last one and its owner is gone.
+	void renderReleaseTexture(GLuint texture) {
+		RenderTextureRef* ref = renderFindTextureRef(texture);
+		if (!ref || --ref->refs != 0) return;
+
+		if (ref->released) renderDeleteTexture(texture);
+		*ref = renderTextureRefs[--renderTextureRefCount];
+	}
+
+	// Deletes the buffers and vertex arrays of [batch] once the draws queued this frame are flushed.
+	// Takes ownership of its draws.
+	void renderDeleteStaticBatch(const StaticBatch* batch) {
+		if (renderDeletedBatchCount == renderDeletedBatchCapacity) {
+			uint32_t capacity = renderDeletedBatchCapacity ? renderDeletedBatchCapacity * 2 : 64;
+			StaticBatch* batches = realloc(renderDeletedBatches, capacity * sizeof(StaticBatch));
+
+			// Out of memory, so leak the batch rather than risk replaying deleted buffers.
+			if (!batches) return;
+
+			renderDeletedBatches = batches;
+			renderDeletedBatchCapacity = capacity;
+		}
+
+		renderDeletedBatches[renderDeletedBatchCount++] = *batch;
+	}
+
+	// Deletes the static batches and textures released since the last call, except textures static batches
+	// still draw. Must be called after the end of frame flush, with no static batch recording.
+	void renderFreeDeleted() {
+		if (renderDeletedBatchCount != 0) {
+			// Deleting a bound vertex array unbinds it.
+			glCache.vertexArray = UINT32_MAX;
+		}
+
+		for (uint32_t i = 0; i < renderDeletedBatchCount; i++) {
+			StaticBatch* batch = &renderDeletedBatches[i];
+
+			// glDelete* silently ignores 0's.
+			glDeleteVertexArrays(1, &batch->spriteVertexArray);
+			glDeleteVertexArrays(1, &batch->primitiveVertexArray);
+			glDeleteBuffers(1, &batch->spriteBuffer);
+			glDeleteBuffers(1, &batch->primitiveBuffer);
+			free(batch->draws);
+		}
+
+		renderDeletedBatchCount = 0;
+
+		for (uint32_t i = 0; i < renderDeletedTextureCount; i++) {
+			RenderTextureRef* ref = renderFindTextureRef(renderDeletedTextures[i]);
+
+			if (ref) {
+				ref->released = true;
+			} else {
+				glCacheDeleteTexture(renderDeletedTextures[i]);
+			}
+		}
+
+		renderDeletedTextureCount = 0;
+	}
+
+	// Adds ([delta] 1) or removes ([delta] -1) a reference to every texture [draws] sample.
+	void renderRetainDrawTextures(const RenderDraw* draws, uint32_t drawCount, int delta) {
+		for (uint32_t i = 0; i < drawCount; i++) {
+			for (uint32_t t = 0; t < draws[i].textureCount; t++) {
+				if (delta > 0) {
+					renderRetainTexture(draws[i].textures[t]);
+				} else {
+					renderReleaseTexture(draws[i].textures[t]);
+				}
+			}
+		}
+	}
+
+	// Static batches.
+	//
+	// Draws made while a batch records are queued as usual, then uploaded once into GL_STATIC_DRAW buffers
+	// instead of being drawn. Drawing the batch queues a single command that replays those draws with the
+	// current camera, blend and clip, so static level art costs no uploads and usually one draw call.
+
+	// Empties [batch]. Its buffers and draws are freed at the end of the frame, as queued commands may still replay it.
+	// Flushing here instead would draw the queue out of layer order.
+	void staticBatchClear(StaticBatch* batch) {
+		renderRetainDrawTextures(batch->draws, batch->drawCount, -1);
+
+		if (batch->draws || batch->spriteBuffer || batch->primitiveBuffer) {
+			renderDeleteStaticBatch(batch);
+		}
+
+		memset(batch, 0, sizeof(StaticBatch));
+	}
+
+	// Starts recording into [batch], replacing what it had.
+	void staticBatchBegin(StaticBatch* batch) {
+		staticBatchClear(batch);
+
+		// Only the draws queued from here on are recorded, those before stay queued.
+		renderQueue.recording = batch;
+		renderQueue.recordCommand = renderQueue.commandCount;
+		renderQueue.recordSprite = renderQueue.sprites.instanceCount;
+		renderQueue.recordPrimitive = renderQueue.primitives.vertexCount;
+		renderQueue.recordSorted = renderQueue.sorted;
+		renderQueue.sorted = true;
+	}
+
+	// Stops recording, dropping the draws queued since the recording batch began.
+	void staticBatchDropRecording() {
+		renderQueue.commandCount = renderQueue.recordCommand;
+		renderQueue.sprites.instanceCount = renderQueue.recordSprite;
+		renderQueue.primitives.vertexCount = renderQueue.recordPrimitive;
+		renderQueue.sorted = renderQueue.recordSorted;
+		renderStateDirty = true;
+
+		renderQueue.recording = NULL;
+		renderQueue.recordCommand = 0;
+		renderQueue.recordSprite = 0;
+		renderQueue.recordPrimitive = 0;
+	}
+
+	// Uploads [bytes] of [data] into the static [buffer] of a [shader] batch.
+	// The buffer and its [vertexArray] are created the first time.
+	void staticBatchUpload(uint32_t shader, GLuint* vertexArray, GLuint* buffer, const void* data, uint32_t bytes) {
+		bool create = *buffer == 0;
+		if (create) {
+			glGenVertexArrays(1, vertexArray);
+			glGenBuffers(1, buffer);
+		}
+
+		// Re-specifying a buffer gives it new storage, so draws still reading the old data don't stall.
+		glBindBuffer(GL_ARRAY_BUFFER, *buffer);
+		glBufferData(GL_ARRAY_BUFFER, bytes, data, GL_STATIC_DRAW);
+		renderStats.bufferBytesUploaded += bytes;
+
+		if (!create) return;
+
+		if (shader == RENDER_SHADER_SPRITE) {
+			renderSetupSpriteVertexArray(*vertexArray);
+			renderPointSpriteInstances(*buffer, 0);
+		} else {
+			renderSetupPrimitiveVertexArray(*vertexArray);
+			renderPointPrimitiveVertices(*buffer);
+		}
+	}
+
+	// Ends the recording static batch, if any, storing all draws queued since it began.
+	void staticBatchEnd() {
+		StaticBatch* batch = renderQueue.recording;
+		if (!batch) return;
+
+		RenderCommand* commands = renderQueue.commands + renderQueue.recordCommand;
+		uint32_t commandCount = renderQueue.commandCount - renderQueue.recordCommand;
+		uint32_t spriteCount = renderQueue.sprites.instanceCount - renderQueue.recordSprite;
+		uint32_t primitiveCount = renderQueue.primitives.vertexCount - renderQueue.recordPrimitive;
+
+		if (commandCount == 0) {
+			staticBatchDropRecording();
+			return;
+		}
+
+		// The recorded data is addressed from 0 in the batch's buffers.
+		// The batch is drawn with the state it is replayed with, so recorded state changes don't split draws.
+		for (uint32_t i = 0; i < commandCount; i++) {
+			commands[i].first -= commands[i].shader == RENDER_SHADER_SPRITE ? renderQueue.recordSprite : renderQueue.recordPrimitive;
+			commands[i].state = 0;
+		}
+
+		RenderDraw* draws;
+		void* spriteData = (uint8_t*)renderQueue.sprites.instanceData + (size_t)renderQueue.recordSprite * SPRITE_INSTANCE_SIZE;
+		void* primitiveData = (uint8_t*)renderQueue.primitives.vertexData + (size_t)renderQueue.recordPrimitive * 16;
+		uint32_t drawCount = renderQueuePrepare(
+			commands, commandCount, renderQueue.sorted, &draws,
+			&spriteData, spriteCount, &primitiveData, primitiveCount
+		);
+
+		batch->draws = drawCount ? (RenderDraw*)malloc(drawCount * sizeof(RenderDraw)) : NULL;
+		if (batch->draws) {
+			memcpy(batch->draws, draws, drawCount * sizeof(RenderDraw));
+			batch->drawCount = drawCount;
+
+			// Sprites drawn while recording may be collected before the batch.
+			renderRetainDrawTextures(batch->draws, drawCount, 1);
+
+			if (spriteData) {
+				staticBatchUpload(RENDER_SHADER_SPRITE, &batch->spriteVertexArray, &batch->spriteBuffer, spriteData, spriteCount * SPRITE_INSTANCE_SIZE);
+			}
+
+			if (primitiveData) {
+				staticBatchUpload(RENDER_SHADER_PRIMITIVE, &batch->primitiveVertexArray, &batch->primitiveBuffer, primitiveData, primitiveCount * 16);
+			}
+		}
+
+		staticBatchDropRecording();
+	}
+
+	// Replaces what [batch] draws with [count] sprite instances sampling [texture], bypassing the render queue.
+	// The instances must sample texture slot 0. The batch's buffers are reused, unless a replay of it is queued.
+	void staticBatchSetSprites(StaticBatch* batch, const void* data, uint32_t count, GLuint texture) {
+		// A queued replay must still draw the old contents, so leave it the old buffers and draws.
+		if (batch->queuedGeneration == renderQueue.generation) staticBatchClear(batch);
+
+		if (!batch->draws) {
+			batch->draws = (RenderDraw*)malloc(sizeof(RenderDraw));
+			if (!batch->draws) return;
+		}
+
+		renderRetainDrawTextures(batch->draws, batch->drawCount, -1);
+		batch->drawCount = 0;
+		if (count == 0) return;
+
+		staticBatchUpload(RENDER_SHADER_SPRITE, &batch->spriteVertexArray, &batch->spriteBuffer, data, count * SPRITE_INSTANCE_SIZE);
+
+		RenderDraw* draw = &batch->draws[0];
+		draw->shader = RENDER_SHADER_SPRITE;
+		draw->state = 0;
+		draw->first = 0;
+		draw->count = count;
+		draw->textureCount = 1;
+		draw->textures[0] = texture;
+
+		batch->drawCount = 1;
+		renderRetainTexture(texture);
+	}
+
+	// Queues a replay of [batch].
+	void staticBatchDraw(StaticBatch* batch) {
+		if (batch->drawCount == 0) return;
+
+		if (renderQueue.batchCount == renderQueue.batchCapacity) {
+			uint32_t capacity = renderQueue.batchCapacity == 0 ? 16 : renderQueue.batchCapacity * 2;
+			StaticBatch* batches = (StaticBatch*)realloc(renderQueue.batches, capacity * sizeof(StaticBatch));
+			if (!batches) return;
+
+			renderQueue.batches = batches;
+			renderQueue.batchCapacity = capacity;
+		}
+
+		batch->queuedGeneration = renderQueue.generation;
+		renderQueue.batches[renderQueue.batchCount] = *batch;
+		renderQueueAdd(RENDER_SHADER_STATIC, 0, renderQueue.batchCount, 1);
+		renderQueue.batchCount++;
+	}
+
+	bool compilerShaderUniformLocations(Shader* shader, int count, const char** names, int index) {
+		for (int i = 0; i < count; i++) {
+			const char* name = names[i];
+
+			int space = strLastIndex(name, ' ');
+			if (space >= 0) {
+				name = name + space + 1;
+			}
+
+			// Arrays are located by their name without the size.
+			char arrayName[64];
+			int bracket = strLastIndex(name, '[');
+			if (bracket > 0 && bracket < 64) {
+				memcpy(arrayName, name, bracket);
+				arrayName[bracket] = '\0';
+				name = arrayName;
+			}
+
+			GLint location = glGetUniformLocation(shader->program, name);
+			if (location == -1) {
+				quitError = printBuffer;
+				snprintf(printBuffer, PRINT_BUFFER_SIZE, "invalid uniform name %s", name);
+				return false;
+			}
+			shader->uniforms[index++] = location;
+		}
+
+		return true;
+	}
+
+	Shader compileShader(ShaderData* data) {
+		StringBuilder sb;
+		int success;
+
+		Shader result;
+		result.program = 0;
+
+		sbInit(&sb);
+
+		// Compile vertex shader.
+		sbAddStr(&sb, "#version 330 core\n");
+
+		for (int i = 0; i < data->attributeCount; i++) {
+			const char* attr = data->attributes[i];
+
+			sbAddStr(&sb, "layout(location = ");
+			sbAddByte(&sb, '0' + i);
+			sbAddStr(&sb, ") in ");
+			sbAddStr(&sb, attr);
+			sbAddStr(&sb, ";\n");
+		}
+		
+		for (int i = 0; i < data->vertexUnifomCount; i++) {
+			const char* unif = data->vertexUniforms[i];
+
+			sbAddStr(&sb, "uniform ");
+			sbAddStr(&sb, unif);
+			sbAddStr(&sb, ";\n");
+		}
+		
+		for (int i = 0; i < data->varyingCount; i++) {
+			const char* vary = data->varyings[i];
+
+			sbAddStr(&sb, "out ");
+			sbAddStr(&sb, vary);
+			sbAddStr(&sb, ";\n");
+		}
+
+		sbAddStr(&sb, "void main() {\n");
+		sbAddStr(&sb, data->vertexShader);
+		sbAddByte(&sb, '}');
+
+		GLuint vs = glCreateShader(GL_VERTEX_SHADER);
+		glShaderSource(vs, 1, (const GLchar* const*)&sb.data, (const GLint*)&sb.size);
+		glCompileShader(vs);
+
+		glGetShaderiv(vs, GL_COMPILE_STATUS, &success);
+		if (!success) {
+			char buffer[512];
+			glGetShaderInfoLog(vs, 512, NULL, buffer);
+			printf("vertex shader error: %s", buffer);
+			quitError = "compile vertex shader";
+		} else {
+			// Compiler fragment shader.
+			sb.size = 0;
+
+			sbAddStr(&sb, "#version 330 core\nout vec4 FragColor;\n");
+			
+			for (int i = 0; i < data->fragmentUnifomCount; i++) {
+				const char* unif = data->fragmentUniforms[i];
+
+				sbAddStr(&sb, "uniform ");
+				sbAddStr(&sb, unif);
+				sbAddStr(&sb, ";\n");
+			}
+			
+			for (int i = 0; i < data->varyingCount; i++) {
+				const char* vary = data->varyings[i];
+
+				sbAddStr(&sb, "in ");
+				sbAddStr(&sb, vary);
+				sbAddStr(&sb, ";\n");
+			}
+
+			sbAddStr(&sb, "void main() {\n");
+			sbAddStr(&sb, data->fragmentShader);
+			sbAddByte(&sb, '}');
+
+			GLuint fs = glCreateShader(GL_FRAGMENT_SHADER);
+			glShaderSource(fs, 1, (const GLchar* const*)&sb.data, (const GLint*)&sb.size);
+			glCompileShader(fs);
+
+			glGetShaderiv(fs, GL_COMPILE_STATUS, &success);
+			if (!success) {
+				char buffer[512];
+				glGetShaderInfoLog(fs, 512, NULL, buffer);
+				printf("fragment shader error: %s", buffer);
+				quitError = "compile fragment shader";
+			} else {
+				// Link program.
+				GLuint prog = glCreateProgram();
+				glAttachShader(prog, vs);
+				glAttachShader(prog, fs);
+				glLinkProgram(prog);
+
+				glGetProgramiv(prog, GL_LINK_STATUS, &success);
+				if(!success) {
+					char buffer[512];
+					glGetProgramInfoLog(fs, 512, NULL, buffer);
+					printf("program error: %s", buffer);
+					quitError = "link program";
+				} else {
+					result.program = prog;
+
+					// Get uniform locations.
+					glUseProgram(prog);
+					
+					bool vuOK = compilerShaderUniformLocations(&result, data->vertexUnifomCount, data->vertexUniforms, 0);
+					bool fuOK = compilerShaderUniformLocations(&result, data->fragmentUnifomCount, data->fragmentUniforms, data->vertexUnifomCount);
+
+					glUseProgram(0);
+
+					if (!vuOK || !fuOK) {
+						glDeleteProgram(result.program);
+						result.program = 0;
+					}
+				}
+			}
+			
+			glDeleteShader(fs);
+		}
+		
+		glDeleteShader(vs);
+
+		// Free string builder.
+		sbFree(&sb);
+
+		// Done!
+		return result;
+	}
+
+
+	// = SHADERS =
+
+	static ShaderData shaderDataSpriteBatcher = {
+		// Attributes
+		// [corner] is per vertex, the rest per instance.
+		5, {
+			"vec2 corner",
+			"vec3 origin",
+			"vec4 color",
+			"vec4 sides",
+			"vec4 uv",
+		},
+		// Vertex Uniforms
+		1, {
+			"mat3 m",
+		},
+		// Fragment Uniforms
+		1, {
+			"sampler2D tex[16]",
+		},
+		// Varyings
+		3, {
+			"vec4 v_color",
+			"vec2 v_uv",
+			"float v_slot",
+		},
+		// Vertex Shader
+		// The render queue stores the texture slot in origin.z.
+		"v_color = color;\n"
+		"v_uv = uv.xy + corner * uv.zw;\n"
+		"v_slot = origin.z;\n"
+		"vec2 p = origin.xy + corner.x * sides.xy + corner.y * sides.zw;\n"
+		"vec3 a = m * vec3(p, 1.0);\n"
+		"gl_Position = vec4(a.xy, 0.0, 1.0);\n"
+		,
+		// Fragment Shader
+		// Samplers can only be indexed by constants, and derivatives are taken outside the branch.
+		"vec2 dx = dFdx(v_uv);\n"
+		"vec2 dy = dFdy(v_uv);\n"
+		"vec4 c;\n"
+		"switch (int(v_slot + 0.5)) {\n"
+		"case 0: c = textureGrad(tex[0], v_uv, dx, dy); break;\n"
+		"case 1: c = textureGrad(tex[1], v_uv, dx, dy); break;\n"
+		"case 2: c = textureGrad(tex[2], v_uv, dx, dy); break;\n"
+		"case 3: c = textureGrad(tex[3], v_uv, dx, dy); break;\n"
+		"case 4: c = textureGrad(tex[4], v_uv, dx, dy); break;\n"
+		"case 5: c = textureGrad(tex[5], v_uv, dx, dy); break;\n"
+		"case 6: c = textureGrad(tex[6], v_uv, dx, dy); break;\n"
+		"case 7: c = textureGrad(tex[7], v_uv, dx, dy); break;\n"
+		"case 8: c = textureGrad(tex[8], v_uv, dx, dy); break;\n"
+		"case 9: c = textureGrad(tex[9], v_uv, dx, dy); break;\n"
+		"case 10: c = textureGrad(tex[10], v_uv, dx, dy); break;\n"
+		"case 11: c = textureGrad(tex[11], v_uv, dx, dy); break;\n"
+		"case 12: c = textureGrad(tex[12], v_uv, dx, dy); break;\n"
+		"case 13: c = textureGrad(tex[13], v_uv, dx, dy); break;\n"
+		"case 14: c = textureGrad(tex[14], v_uv, dx, dy); break;\n"
+		"default: c = textureGrad(tex[15], v_uv, dx, dy); break;\n"
+		"}\n"
+		"FragColor = c * v_color;\n"
+	};
+	
+	static ShaderData shaderDataPrimitiveBatcher = {
+		// Attributes
+		2, {
+			"vec3 vertex",
+			"vec4 color",
+		},
+		// Vertex Uniforms
+		1, {
+			"mat3 m",
+		},
+		// Fragment Uniforms
+		0, { 0 },
+		// Varyings
+		1, {
+			"vec4 v_color",
+		},
+		// Vertex Shader
+		"v_color = color;\n"
+		"vec3 a = m * vec3(vertex.xy, 1.0);\n"
+		"gl_Position = vec4(a.xy, vertex.z, 1.0);\n"
+		,
+		// Fragment Shader
+		"FragColor = v_color;\n"
+	};
+	
+	static ShaderData shaderDataFramebuffer = {
+		// Attributes
+		1, {
+			"vec2 vertex",
+		},
+		// Vertex Uniforms
+		0, { 0 },
+		// Fragment Uniforms
+		1, {
+			"sampler2D tex",
+		},
+		// Varyings
+		1, {
+			"vec2 v_uv",
+		},
+		// Vertex Shader
+		"v_uv = 0.5 + vertex * 0.5;\n"
+		"gl_Position = vec4(vertex, 0.0, 1.0);\n"
+		,
+		// Fragment Shader
+		"FragColor = texture(tex, v_uv);\n"
+	};
+
+	static const char* SOCK_FILTER_LINEAR = "linear";
+	static const char* SOCK_FILTER_NEAREST = "nearest";
+
+	static const char* SOCK_WRAP_CLAMP = "clamp";
+	static const char* SOCK_WRAP_REPEAT = "repeat";
+	static const char* SOCK_WRAP_MIRROR = "mirror";
+	
+	static const char* SOCK_BLEND_EQUATION_ADD = "add";
+	static const char* SOCK_BLEND_EQUATION_SUBTRACT = "subtract";
+	static const char* SOCK_BLEND_EQUATION_REVERSE_SUBTRACT = "reverse_subtract";
+	static const char* SOCK_BLEND_EQUATION_MIN = "min";
+	static const char* SOCK_BLEND_EQUATION_MAX = "max";
+
+	static const char* SOCK_BLEND_CONSTANT_ZERO = "zero";
+	static const char* SOCK_BLEND_CONSTANT_ONE = "one";
+	static const char* SOCK_BLEND_CONSTANT_SRC_COLOR = "src_color";
+	static const char* SOCK_BLEND_CONSTANT_SRC_ALPHA = "src_alpha";
+	static const char* SOCK_BLEND_CONSTANT_DST_COLOR = "dst_color";
+	static const char* SOCK_BLEND_CONSTANT_DST_ALPHA = "dst_alpha";
+	static const char* SOCK_BLEND_CONSTANT_CONSTANT_COLOR = "constant_color";
+	static const char* SOCK_BLEND_CONSTANT_CONSTANT_ALPHA = "constant_alpha";
+	static const char* SOCK_BLEND_CONSTANT_ONE_MINUS_SRC_COLOR = "one_minus_src_color";
+	static const char* SOCK_BLEND_CONSTANT_ONE_MINUS_SRC_ALPHA = "one_minus_src_alpha";
+	static const char* SOCK_BLEND_CONSTANT_ONE_MINUS_DST_COLOR = "one_minus_dst_color";
+	static const char* SOCK_BLEND_CONSTANT_ONE_MINUS_DST_ALPHA = "one_minus_dst_alpha";
+	static const char* SOCK_BLEND_CONSTANT_ONE_MINUS_CONSTANT_COLOR = "one_minus_constant_color";
+	static const char* SOCK_BLEND_CONSTANT_ONE_MINUS_CONSTANT_ALPHA = "one_minus_constant_alpha";
+
+	GLuint filterStringToGlEnum(const char* filter) {
+		if (strcmp(SOCK_FILTER_LINEAR, filter) == 0) return GL_LINEAR;
+		if (strcmp(SOCK_FILTER_NEAREST, filter) == 0) return GL_NEAREST;
+		return 0;
+	}
+	
+	GLuint wrapStringToGlEnum(const char* wrap) {
+		if (strcmp(SOCK_WRAP_CLAMP, wrap) == 0) return GL_CLAMP_TO_EDGE;
+		if (strcmp(SOCK_WRAP_REPEAT, wrap) == 0) return GL_REPEAT;
+		if (strcmp(SOCK_WRAP_MIRROR, wrap) == 0) return GL_MIRRORED_REPEAT;
+		return 0;
+	}
+	
+	GLenum blendEquationStringToGlEnum(const char* eq) {
+		if (strcmp(SOCK_BLEND_EQUATION_ADD, eq) == 0) return GL_FUNC_ADD;
+		if (strcmp(SOCK_BLEND_EQUATION_SUBTRACT, eq) == 0) return GL_FUNC_SUBTRACT;
+		if (strcmp(SOCK_BLEND_EQUATION_REVERSE_SUBTRACT, eq) == 0) return GL_FUNC_REVERSE_SUBTRACT;
+		if (strcmp(SOCK_BLEND_EQUATION_MIN, eq) == 0) return GL_MIN;
+		if (strcmp(SOCK_BLEND_EQUATION_MAX, eq) == 0) return GL_MAX;
+		return 0;
+	}
+
+	GLenum blendConstantStringToGlEnum(const char* cnst) {
+		if (strcmp(SOCK_BLEND_CONSTANT_ZERO, cnst) == 0) return GL_ZERO;
+		if (strcmp(SOCK_BLEND_CONSTANT_ONE, cnst) == 0) return GL_ONE;
+		if (strcmp(SOCK_BLEND_CONSTANT_SRC_COLOR, cnst) == 0) return GL_SRC_COLOR;
+		if (strcmp(SOCK_BLEND_CONSTANT_SRC_ALPHA, cnst) == 0) return GL_SRC_ALPHA;
+		if (strcmp(SOCK_BLEND_CONSTANT_DST_COLOR, cnst) == 0) return GL_DST_COLOR;
+		if (strcmp(SOCK_BLEND_CONSTANT_DST_ALPHA, cnst) == 0) return GL_DST_ALPHA;
+		if (strcmp(SOCK_BLEND_CONSTANT_CONSTANT_COLOR, cnst) == 0) return GL_CONSTANT_COLOR;
+		if (strcmp(SOCK_BLEND_CONSTANT_CONSTANT_ALPHA, cnst) == 0) return GL_CONSTANT_ALPHA;
+		if (strcmp(SOCK_BLEND_CONSTANT_ONE_MINUS_SRC_COLOR, cnst) == 0) return GL_ONE_MINUS_SRC_COLOR;
+		if (strcmp(SOCK_BLEND_CONSTANT_ONE_MINUS_SRC_ALPHA, cnst) == 0) return GL_ONE_MINUS_SRC_ALPHA;
+		if (strcmp(SOCK_BLEND_CONSTANT_ONE_MINUS_DST_COLOR, cnst) == 0) return GL_ONE_MINUS_DST_COLOR;
+		if (strcmp(SOCK_BLEND_CONSTANT_ONE_MINUS_DST_ALPHA, cnst) == 0) return GL_ONE_MINUS_DST_ALPHA;
+		if (strcmp(SOCK_BLEND_CONSTANT_ONE_MINUS_CONSTANT_COLOR, cnst) == 0) return GL_ONE_MINUS_CONSTANT_COLOR;
+		if (strcmp(SOCK_BLEND_CONSTANT_ONE_MINUS_CONSTANT_ALPHA, cnst) == 0) return GL_ONE_MINUS_CONSTANT_ALPHA;
+		return 2;
+	}
+
+	GLuint wren_filterStringToGlEnum(WrenVM* vm, int slot) {
+		if (wrenGetSlotType(vm, slot) != WREN_TYPE_STRING) {
+			wrenAbort(vm, "filter type must be a string");
+			return 0;
+		}
+		
+		GLuint filter = filterStringToGlEnum(wrenGetSlotString(vm, slot));
+		if (filter == 0) {
+			wrenAbort(vm, "invalid filter type");
+		}
+		
+		return filter;
+	}
+	
+	GLuint wren_wrapStringToGlEnum(WrenVM* vm, int slot) {
+		if (wrenGetSlotType(vm, slot) != WREN_TYPE_STRING) {
+			wrenAbort(vm, "wrap type must be a string");
+			return 0;
+		}
+		
+		GLuint filter = wrapStringToGlEnum(wrenGetSlotString(vm, slot));
+		if (filter == 0) {
+			wrenAbort(vm, "invalid wrap type");
+		}
+
+		return filter;
+	}
+	
+	GLenum wren_blendEquationStringToGlEnum(WrenVM* vm, int slot) {
+		if (wrenGetSlotType(vm, slot) != WREN_TYPE_STRING) {
+			wrenAbort(vm, "blend equation must be a string");
+			return 0;
+		}
+		
+		GLenum eq = blendEquationStringToGlEnum(wrenGetSlotString(vm, slot));
+		if (eq == 0) {
+			wrenAbort(vm, "invalid blend equation");
+		}
+
+		return eq;
+	}
+	
+	GLenum wren_blendConstantStringToGlEnum(WrenVM* vm, int slot) {
+		if (wrenGetSlotType(vm, slot) != WREN_TYPE_STRING) {
+			wrenAbort(vm, "blend constant must be a string");
+			return 0;
+		}
+		
+		GLenum cnst = blendConstantStringToGlEnum(wrenGetSlotString(vm, slot));
+		if (cnst == 2) {
+			wrenAbort(vm, "invalid blend constant");
+		}
+
+		return cnst;
+	}
+
+	const char* glFilterEnumToString(GLuint filter) {
+		if (filter == GL_LINEAR) return SOCK_FILTER_LINEAR;
+		if (filter == GL_NEAREST) return SOCK_FILTER_NEAREST;
+		return NULL;
+	}
+	
+	const char* glWrapEnumToString(GLuint wrap) {
+		if (wrap == GL_CLAMP_TO_EDGE) return SOCK_WRAP_CLAMP;
+		if (wrap == GL_REPEAT) return SOCK_WRAP_REPEAT;
+		if (wrap == GL_MIRRORED_REPEAT) return SOCK_WRAP_MIRROR;
+		return NULL;
+	}
+
+	static GLuint systemFontTexture = 0;
+
+	// Gets the system font's texture, loading it if needed.
+	// Returns 0 on error, aborting the current fiber.
+	GLuint systemFontGetTexture() {
+		// Load GIF sprite.
+		if (systemFontTexture == 0) {
+			// Load from constant.
+			int width, height, channelCount;
+			stbi_uc* data = stbi_load_from_memory(COZETTE, COZETTE_LENGTH, &width, &height, &channelCount, 4);
+
+			if (!data) {
+				wrenAbort(vm, stbi_failure_reason());
+				return 0;
+			}
+
+			// Load into WebGL texture.
+			glGenTextures(1, &systemFontTexture);
+			glCacheEditTexture(systemFontTexture);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
+			renderStats_textureMemory += (int64_t)width * height * 4;
+
+			stbi_image_free(data);
+		}
+
+		return systemFontTexture;
+	}
+
+	int systemFontDraw(const char* str, int cornerX, int cornerY, uint32_t color) {
+		if (systemFontGetTexture() == 0) return cornerY;
+
+		// Draw sprites.
+		SpriteBatcher* sb = renderQueueBeginSprites();
 
 		int dx = cornerX;
 		int dy = cornerY;
@@ -2995,880 +4961,3568 @@ const char* wren_resolveModule(WrenVM* vm, const char* importer, const char* nam
 		char c;
 		int i = 0;
 
-		while ((c = str[i]) != '\0') {
-			if (c == '\t') {
-				// Tab
-				dx += 24;
-			} else if (c == '\n') {
-				// Newline
-				dx = cornerX;
-				dy += 14;
-			} else if (c == '\r') {
-				// Carriage return
-			} else if (c == ' ') {
-				// Space
-				dx += 6;
+		while ((c = str[i]) != '\0') {
+			if (c == '\t') {
+				// Tab
+				dx += 24;
+			} else if (c == '\n') {
+				// Newline
+				dx = cornerX;
+				dy += 14;
+			} else if (c == '\r') {
+				// Carriage return
+			} else if (c == ' ') {
+				// Space
+				dx += 6;
+			} else {
+				// Convert out of range characters to heart glyph
+				if (!(c >= ' ' && c <= '~')) c = 127;
+
+				// Draw the character!
+				int idx = c - 32;
+				int spx = (idx % 16) * 6;
+				int spy = (idx / 16) * 12;
+
+				spriteBatcherDrawRect(sb,
+					(float)(dx),     (float)(dy),
+					(float)(dx + 6), (float)(dy + 12),
+					spx / (float)COZETTE_WIDTH, spy / (float)COZETTE_HEIGHT,
+					(spx + 6) / (float)COZETTE_WIDTH, (spy + 12) / (float)COZETTE_HEIGHT,
+					color,
+					NULL
+				);
+		
+				dx += 6;
+			}
+
+			if (dx >= screenWidth) {
+				dx = cornerX;
+				dy += 14;
+			}
+
+			i++;
+		}
+
+		renderQueueEndSprites(systemFontTexture);
+
+		return dy;
+	}
+
+
+	// === FONTS ===
+
+	// Fonts are glyph atlas pages plus each glyph's rect on them. They're loaded once and cached by
+	// path until exit, like atlas pages, so Text can keep using a Font without holding its Wren object.
+	// Fonts are loaded from text BMFont descriptors (.fnt) and their page images, or use the system font.
+
+	typedef struct {
+		uint32_t codepoint;
+		// The glyph's rect on its page, in pixels.
+		int16_t x, y, width, height;
+		// Where the rect is drawn from the pen, and how far the pen moves after it.
+		int16_t xoffset, yoffset, xadvance;
+		uint16_t page;
+	} FontGlyph;
+
+	typedef struct {
+		// First codepoint << 32 | second codepoint.
+		uint64_t pair;
+		int amount;
+	} FontKerning;
+
+	typedef struct Font {
+		// NULL for the system font.
+		char* path;
+		int lineHeight;
+		// Size of each page, in pixels.
+		int pageWidth;
+		int pageHeight;
+		GLuint* pages;
+		int pageCount;
+		// Sorted by codepoint.
+		FontGlyph* glyphs;
+		int glyphCount;
+		// Indices into [glyphs] of the ASCII codepoints, -1 where missing.
+		int16_t ascii[128];
+		// Sorted by pair.
+		FontKerning* kernings;
+		int kerningCount;
+		// Drawn for codepoints the font doesn't have, may be NULL.
+		FontGlyph* fallback;
+		struct Font* next;
+	} Font;
+
+	static Font* fonts = NULL;
+	static Font* systemFont = NULL;
+
+	int fontGlyphCompare(const void* a, const void* b) {
+		uint32_t ca = ((const FontGlyph*)a)->codepoint;
+		uint32_t cb = ((const FontGlyph*)b)->codepoint;
+		return (ca > cb) - (ca < cb);
+	}
+
+	int fontKerningCompare(const void* a, const void* b) {
+		uint64_t pa = ((const FontKerning*)a)->pair;
+		uint64_t pb = ((const FontKerning*)b)->pair;
+		return (pa > pb) - (pa < pb);
+	}
+
+	// Sorts [font]'s glyphs and kerning pairs for lookup.
+	void fontIndex(Font* font) {
+		qsort(font->glyphs, font->glyphCount, sizeof(FontGlyph), fontGlyphCompare);
+		qsort(font->kernings, font->kerningCount, sizeof(FontKerning), fontKerningCompare);
+
+		for (int i = 0; i < 128; i++) {
+			font->ascii[i] = -1;
+		}
+
+		// Sorted, so the ASCII glyphs come first.
+		for (int i = 0; i < font->glyphCount && font->glyphs[i].codepoint < 128; i++) {
+			font->ascii[font->glyphs[i].codepoint] = (int16_t)i;
+		}
+	}
+
+	FontGlyph* fontGetGlyph(Font* font, uint32_t codepoint) {
+		if (codepoint < 128) {
+			int i = font->ascii[codepoint];
+			return i >= 0 ? &font->glyphs[i] : font->fallback;
+		}
+
+		FontGlyph key;
+		key.codepoint = codepoint;
+
+		FontGlyph* glyph = bsearch(&key, font->glyphs, font->glyphCount, sizeof(FontGlyph), fontGlyphCompare);
+		return glyph ? glyph : font->fallback;
+	}
+
+	int fontGetKerning(Font* font, uint32_t first, uint32_t second) {
+		if (font->kerningCount == 0 || first == 0) return 0;
+
+		FontKerning key;
+		key.pair = (uint64_t)first << 32 | second;
+
+		FontKerning* kerning = bsearch(&key, font->kernings, font->kerningCount, sizeof(FontKerning), fontKerningCompare);
+		return kerning ? kerning->amount : 0;
+	}
+
+	// How far the pen moves for [codepoint] following [prev], 0 at the start of a line.
+	float fontAdvance(Font* font, uint32_t prev, uint32_t codepoint) {
+		if (codepoint == '\t') {
+			FontGlyph* space = fontGetGlyph(font, ' ');
+			return space ? space->xadvance * 4.0f : 0;
+		}
+
+		if (codepoint == '\r') return 0;
+
+		FontGlyph* glyph = fontGetGlyph(font, codepoint);
+		return glyph ? glyph->xadvance + fontGetKerning(font, prev, codepoint) : 0;
+	}
+
+	void fontFree(Font* font) {
+		if (font->pages) {
+			for (int i = 0; i < font->pageCount; i++) {
+				if (font->pages[i] != 0) {
+					renderStats_textureMemory -= (int64_t)font->pageWidth * font->pageHeight * 4;
+					glCacheDeleteTexture(font->pages[i]);
+				}
+			}
+
+			free(font->pages);
+		}
+
+		free(font->path);
+		free(font->glyphs);
+		free(font->kernings);
+		free(font);
+	}
+
+	// Gets the built-in 6x12 font used by Game.print.
+	// Returns NULL on error, aborting the current fiber.
+	Font* fontGetSystem() {
+		if (systemFont) return systemFont;
+
+		GLuint texture = systemFontGetTexture();
+		if (texture == 0) return NULL;
+
+		// 16 columns of glyphs from ' ' to 127.
+		int glyphCount = (COZETTE_WIDTH / 6) * (COZETTE_HEIGHT / 12);
+
+		Font* font = calloc(1, sizeof(Font));
+		FontGlyph* glyphs = malloc(glyphCount * sizeof(FontGlyph));
+		GLuint* pages = malloc(sizeof(GLuint));
+
+		if (!font || !glyphs || !pages) {
+			free(font);
+			free(glyphs);
+			free(pages);
+			wrenAbort(vm, "out of memory");
+			return NULL;
+		}
+
+		for (int i = 0; i < glyphCount; i++) {
+			FontGlyph* glyph = &glyphs[i];
+			glyph->codepoint = 32 + i;
+			glyph->x = (int16_t)((i % 16) * 6);
+			glyph->y = (int16_t)((i / 16) * 12);
+			glyph->width = 6;
+			glyph->height = 12;
+			glyph->xoffset = 0;
+			glyph->yoffset = 0;
+			glyph->xadvance = 6;
+			glyph->page = 0;
+		}
+
+		// Nothing to draw for space.
+		glyphs[0].width = 0;
+		glyphs[0].height = 0;
+
+		pages[0] = texture;
+
+		font->lineHeight = 14;
+		font->pageWidth = COZETTE_WIDTH;
+		font->pageHeight = COZETTE_HEIGHT;
+		font->pages = pages;
+		font->pageCount = 1;
+		font->glyphs = glyphs;
+		font->glyphCount = glyphCount;
+		fontIndex(font);
+
+		// Like Game.print, characters out of range are drawn as the heart glyph.
+		font->fallback = fontGetGlyph(font, 127);
+
+		systemFont = font;
+		return font;
+	}
+
+	// Gets the value of [key] in the BMFont descriptor [line], e.g. "char id=65 x=0 y=0 ...".
+	// Returns NULL if it's missing.
+	const char* bmfontValue(const char* line, const char* key) {
+		size_t keyLen = strlen(key);
+
+		for (const char* c = strchr(line, ' '); c; c = strchr(c + 1, ' ')) {
+			if (strncmp(c + 1, key, keyLen) == 0 && c[1 + keyLen] == '=') return c + 2 + keyLen;
+		}
+
+		return NULL;
+	}
+
+	int bmfontInt(const char* line, const char* key, int value) {
+		const char* v = bmfontValue(line, key);
+		return v ? atoi(v) : value;
+	}
+
+	// Gets the quoted value of [key] in [line], allocated with [frameAlloc()].
+	// Returns NULL if it's missing.
+	char* bmfontString(const char* line, const char* key) {
+		const char* v = bmfontValue(line, key);
+		if (!v || *v != '"') return NULL;
+
+		v++;
+		const char* end = strchr(v, '"');
+		if (!end) return NULL;
+
+		char* str = frameAlloc(end - v + 1);
+		if (!str) return NULL;
+
+		memcpy(str, v, end - v);
+		str[end - v] = '\0';
+		return str;
+	}
+
+	// Loads the page image [file] of the font at [path], relative to the font's directory.
+	// Returns 0 on error, aborting the current fiber.
+	GLuint fontLoadPage(WrenVM* vm, const char* path, int* width, int* height, const char* file) {
+		// Relative paths are resolved against an absolute one.
+		const char* curr = path;
+		if (path[0] != '/') {
+			char* abs = frameAlloc(strlen(path) + 2);
+			if (!abs) {
+				wrenAbort(vm, "out of memory");
+				return 0;
+			}
+			abs[0] = '/';
+			strcpy(abs + 1, path);
+			curr = abs;
+		}
+
+		char* pagePath = resolveRelativeFilePath(curr, file);
+		if (!pagePath) {
+			snprintf(printBuffer, PRINT_BUFFER_SIZE, "invalid page path %s", file);
+			wrenAbort(vm, printBuffer);
+			return 0;
+		}
+
+		int64_t imgSize;
+		char* img = readAsset(pagePath, &imgSize);
+		free(pagePath);
+
+		if (!img) {
+			wrenAbort(vm, quitError);
+			quitError = NULL;
+			return 0;
+		}
+
+		int channelCount;
+		stbi_uc* data = stbi_load_from_memory((stbi_uc*)img, (int)imgSize, width, height, &channelCount, 4);
+
+		free(img);
+
+		if (!data) {
+			wrenAbort(vm, stbi_failure_reason());
+			return 0;
+		}
+
+		GLuint id;
+		glGenTextures(1, &id);
+		glCacheEditTexture(id);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, defaultSpriteFilter);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, defaultSpriteFilter);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, *width, *height, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
+		renderStats_textureMemory += (int64_t)*width * *height * 4;
+
+		stbi_image_free(data);
+
+		return id;
+	}
+
+	// Parses the BMFont descriptor [text] of the font at [path] into [font], loading its pages.
+	// Returns false on error, aborting the current fiber.
+	bool fontParseBMFont(WrenVM* vm, Font* font, const char* path, char* text) {
+		if (strncmp(text, "info ", 5) != 0 && strncmp(text, "common ", 7) != 0) {
+			snprintf(printBuffer, PRINT_BUFFER_SIZE, "%s is not a text BMFont descriptor", path);
+			wrenAbort(vm, printBuffer);
+			return false;
+		}
+
+		int glyphCapacity = 0;
+		int kerningCapacity = 0;
+
+		char* line = text;
+		while (line) {
+			// Split off the line.
+			char* next = strchr(line, '\n');
+			if (next) *next++ = '\0';
+
+			size_t len = strlen(line);
+			if (len > 0 && line[len - 1] == '\r') line[len - 1] = '\0';
+
+			if (strncmp(line, "common ", 7) == 0) {
+				font->lineHeight = bmfontInt(line, "lineHeight", 0);
+				font->pageWidth = bmfontInt(line, "scaleW", 0);
+				font->pageHeight = bmfontInt(line, "scaleH", 0);
+
+				int pageCount = bmfontInt(line, "pages", 1);
+				if (font->pages || pageCount < 1 || pageCount > UINT16_MAX || font->pageWidth < 1 || font->pageHeight < 1) {
+					snprintf(printBuffer, PRINT_BUFFER_SIZE, "%s has an invalid common line", path);
+					wrenAbort(vm, printBuffer);
+					return false;
+				}
+
+				font->pages = calloc(pageCount, sizeof(GLuint));
+				if (!font->pages) {
+					wrenAbort(vm, "out of memory");
+					return false;
+				}
+				font->pageCount = pageCount;
+			} else if (strncmp(line, "page ", 5) == 0) {
+				int id = bmfontInt(line, "id", -1);
+				char* file = bmfontString(line, "file");
+
+				if (!font->pages || id < 0 || id >= font->pageCount || !file) {
+					snprintf(printBuffer, PRINT_BUFFER_SIZE, "%s has an invalid page line", path);
+					wrenAbort(vm, printBuffer);
+					return false;
+				}
+
+				if (font->pages[id] != 0) {
+					renderStats_textureMemory -= (int64_t)font->pageWidth * font->pageHeight * 4;
+					glCacheDeleteTexture(font->pages[id]);
+					font->pages[id] = 0;
+				}
+
+				int width, height;
+				font->pages[id] = fontLoadPage(vm, path, &width, &height, file);
+				if (font->pages[id] == 0) return false;
+
+				if (width != font->pageWidth || height != font->pageHeight) {
+					snprintf(printBuffer, PRINT_BUFFER_SIZE, "%s page %s isn't %dx%d", path, file, font->pageWidth, font->pageHeight);
+					wrenAbort(vm, printBuffer);
+					return false;
+				}
+			} else if (strncmp(line, "char ", 5) == 0) {
+				if (font->glyphCount == glyphCapacity) {
+					glyphCapacity = glyphCapacity ? glyphCapacity * 2 : 128;
+					FontGlyph* glyphs = realloc(font->glyphs, glyphCapacity * sizeof(FontGlyph));
+					if (!glyphs) {
+						wrenAbort(vm, "out of memory");
+						return false;
+					}
+					font->glyphs = glyphs;
+				}
+
+				int id = bmfontInt(line, "id", -1);
+				int page = bmfontInt(line, "page", 0);
+
+				// Skip glyphs without a codepoint, or on a page that doesn't exist.
+				if (id >= 0 && page >= 0 && page < font->pageCount) {
+					FontGlyph* glyph = &font->glyphs[font->glyphCount++];
+					glyph->codepoint = (uint32_t)id;
+					glyph->x = (int16_t)bmfontInt(line, "x", 0);
+					glyph->y = (int16_t)bmfontInt(line, "y", 0);
+					glyph->width = (int16_t)bmfontInt(line, "width", 0);
+					glyph->height = (int16_t)bmfontInt(line, "height", 0);
+					glyph->xoffset = (int16_t)bmfontInt(line, "xoffset", 0);
+					glyph->yoffset = (int16_t)bmfontInt(line, "yoffset", 0);
+					glyph->xadvance = (int16_t)bmfontInt(line, "xadvance", 0);
+					glyph->page = (uint16_t)page;
+				}
+			} else if (strncmp(line, "kerning ", 8) == 0) {
+				if (font->kerningCount == kerningCapacity) {
+					kerningCapacity = kerningCapacity ? kerningCapacity * 2 : 128;
+					FontKerning* kernings = realloc(font->kernings, kerningCapacity * sizeof(FontKerning));
+					if (!kernings) {
+						wrenAbort(vm, "out of memory");
+						return false;
+					}
+					font->kernings = kernings;
+				}
+
+				int first = bmfontInt(line, "first", -1);
+				int second = bmfontInt(line, "second", -1);
+
+				if (first >= 0 && second >= 0) {
+					FontKerning* kerning = &font->kernings[font->kerningCount++];
+					kerning->pair = (uint64_t)first << 32 | (uint32_t)second;
+					kerning->amount = bmfontInt(line, "amount", 0);
+				}
+			}
+
+			line = next;
+		}
+
+		for (int i = 0; i < font->pageCount; i++) {
+			if (font->pages[i] == 0) {
+				snprintf(printBuffer, PRINT_BUFFER_SIZE, "%s is missing page %d", path, i);
+				wrenAbort(vm, printBuffer);
+				return false;
+			}
+		}
+
+		if (!font->pages) {
+			snprintf(printBuffer, PRINT_BUFFER_SIZE, "%s has no common line", path);
+			wrenAbort(vm, printBuffer);
+			return false;
+		}
+
+		return true;
+	}
+
+	// Gets the BMFont at [path], loading it if needed.
+	// Returns NULL on error, aborting the current fiber.
+	Font* fontLoad(WrenVM* vm, const char* path) {
+		for (Font* font = fonts; font; font = font->next) {
+			if (strcmp(font->path, path) == 0) return font;
+		}
+
+		char* text = readAsset(path, NULL);
+		if (!text) {
+			wrenAbort(vm, quitError);
+			quitError = NULL;
+			return NULL;
+		}
+
+		Font* font = calloc(1, sizeof(Font));
+		if (!font) {
+			free(text);
+			wrenAbort(vm, "out of memory");
+			return NULL;
+		}
+
+		bool ok = fontParseBMFont(vm, font, path, text);
+		free(text);
+
+		if (ok) {
+			font->path = _strdup(path);
+			if (!font->path) {
+				wrenAbort(vm, "out of memory");
+				ok = false;
+			}
+		}
+
+		if (!ok) {
+			fontFree(font);
+			return NULL;
+		}
+
+		fontIndex(font);
+
+		// Draw missing characters as '?', if there is one.
+		font->fallback = fontGetGlyph(font, '?');
+
+		font->next = fonts;
+		fonts = font;
+		return font;
+	}
+
+	// Text is laid out once into sprite instances relative to its top left corner, and only laid out
+	// again when its string, width or alignment change. Drawing copies the instances into the render
+	// queue, so labels sharing a Font page still merge into a single draw call.
+
+	#define TEXT_ALIGN_LEFT 0
+	#define TEXT_ALIGN_CENTER 1
+	#define TEXT_ALIGN_RIGHT 2
+
+	typedef struct {
+		Font* font;
+		// Null terminated UTF-8.
+		char* string;
+		// Width to wrap lines at, 0 to only break at newlines.
+		float maxWidth;
+		int align;
+		uint32_t color;
+		bool dirty;
+		// The glyph instances, grouped by page.
+		SpriteBatcher* glyphs;
+		// Number of instances on each of the font's pages.
+		uint32_t* pageCounts;
+		float width;
+		float height;
+		// Bounds of the glyph quads: left, top, right, bottom.
+		float bounds[4];
+	} Text;
+
+	typedef struct {
+		uint32_t start;
+		uint32_t end;
+		float width;
+	} TextLine;
+
+	// Decodes the UTF-8 [str] into [codepoints], which must have room for strlen(str) of them.
+	// Returns the number of codepoints. Invalid sequences decode as U+FFFD.
+	uint32_t utf8Decode(const char* str, uint32_t* codepoints) {
+		const uint8_t* s = (const uint8_t*)str;
+		uint32_t count = 0;
+
+		while (*s) {
+			uint32_t c = *s++;
+			int extra = c < 0x80 ? 0 : (c & 0xe0) == 0xc0 ? 1 : (c & 0xf0) == 0xe0 ? 2 : (c & 0xf8) == 0xf0 ? 3 : -1;
+
+			if (extra < 0) {
+				codepoints[count++] = 0xfffd;
+				continue;
+			}
+
+			if (extra > 0) c &= 0x3f >> extra;
+
+			int k = 0;
+			for ( ; k < extra && (*s & 0xc0) == 0x80; k++, s++) {
+				c = (c << 6) | (*s & 0x3f);
+			}
+
+			codepoints[count++] = k == extra ? c : 0xfffd;
+		}
+
+		return count;
+	}
+
+	// Lays out [text]'s string into its glyph instances.
+	// Returns false on allocation failure.
+	bool textLayout(Text* text) {
+		Font* font = text->font;
+
+		text->dirty = false;
+		text->glyphs->instanceCount = 0;
+		memset(text->pageCounts, 0, font->pageCount * sizeof(uint32_t));
+		text->width = 0;
+		text->height = 0;
+		memset(text->bounds, 0, sizeof(text->bounds));
+
+		uint32_t length = (uint32_t)strlen(text->string);
+		uint32_t* codepoints = frameAlloc((length + 1) * sizeof(uint32_t));
+		TextLine* lines = frameAlloc((length + 1) * sizeof(TextLine));
+		if (!codepoints || !lines) return false;
+
+		uint32_t count = utf8Decode(text->string, codepoints);
+
+		// Break into lines at newlines, and wrap at the last space that fits in [maxWidth], or mid word
+		// if there isn't one.
+		uint32_t lineCount = 0;
+		uint32_t start = 0;
+
+		while (start <= count) {
+			uint32_t end = count;
+			uint32_t next = count + 1;
+			uint32_t breakAt = start;
+			float breakWidth = 0;
+			float pen = 0;
+			uint32_t prev = 0;
+
+			for (uint32_t i = start; i < count; i++) {
+				uint32_t c = codepoints[i];
+
+				if (c == '\n') {
+					end = i;
+					next = i + 1;
+					break;
+				}
+
+				if (c == ' ') {
+					breakAt = i;
+					breakWidth = pen;
+				}
+
+				float advance = fontAdvance(font, prev, c);
+
+				if (text->maxWidth > 0 && c != ' ' && i > start && pen + advance > text->maxWidth) {
+					if (breakAt > start) {
+						end = breakAt;
+						next = breakAt + 1;
+						pen = breakWidth;
+					} else {
+						end = i;
+						next = i;
+					}
+					break;
+				}
+
+				pen += advance;
+				prev = c;
+			}
+
+			lines[lineCount].start = start;
+			lines[lineCount].end = end;
+			lines[lineCount].width = pen;
+			lineCount++;
+
+			if (pen > text->width) text->width = pen;
+
+			start = next;
+		}
+
+		text->height = (float)(lineCount * font->lineHeight);
+
+		// Place the glyphs, then group them by page.
+		SpriteBatcher placed;
+		placed.capacity = count > 0 ? count : 1;
+		placed.instanceCount = 0;
+		placed.instanceData = frameAlloc(placed.capacity * SPRITE_INSTANCE_SIZE);
+		uint16_t* pages = frameAlloc(placed.capacity * sizeof(uint16_t));
+		if (!placed.instanceData || !pages) return false;
+
+		float boxWidth = text->maxWidth > 0 ? text->maxWidth : text->width;
+		float* bounds = text->bounds;
+		bounds[0] = bounds[1] = INFINITY;
+		bounds[2] = bounds[3] = -INFINITY;
+
+		for (uint32_t l = 0; l < lineCount; l++) {
+			TextLine* line = &lines[l];
+			float y = (float)(l * font->lineHeight);
+			float pen = 0;
+			uint32_t prev = 0;
+
+			if (text->align == TEXT_ALIGN_CENTER) {
+				pen = floorf((boxWidth - line->width) / 2);
+			} else if (text->align == TEXT_ALIGN_RIGHT) {
+				pen = boxWidth - line->width;
+			}
+
+			for (uint32_t i = line->start; i < line->end; i++) {
+				uint32_t c = codepoints[i];
+
+				if (c == '\t' || c == '\r') {
+					pen += fontAdvance(font, prev, c);
+					prev = c;
+					continue;
+				}
+
+				FontGlyph* glyph = fontGetGlyph(font, c);
+				if (!glyph) continue;
+
+				pen += fontGetKerning(font, prev, c);
+
+				if (glyph->width > 0 && glyph->height > 0) {
+					float x1 = pen + glyph->xoffset;
+					float y1 = y + glyph->yoffset;
+					float x2 = x1 + glyph->width;
+					float y2 = y1 + glyph->height;
+
+					pages[placed.instanceCount] = glyph->page;
+					spriteBatcherAddInstance(&placed, x1, y1, glyph->width, 0, 0, glyph->height, text->color,
+						glyph->x / (float)font->pageWidth, glyph->y / (float)font->pageHeight,
+						(glyph->x + glyph->width) / (float)font->pageWidth, (glyph->y + glyph->height) / (float)font->pageHeight
+					);
+
+					if (x1 < bounds[0]) bounds[0] = x1;
+					if (y1 < bounds[1]) bounds[1] = y1;
+					if (x2 > bounds[2]) bounds[2] = x2;
+					if (y2 > bounds[3]) bounds[3] = y2;
+				}
+
+				pen += glyph->xadvance;
+				prev = c;
+			}
+		}
+
+		if (placed.instanceCount == 0) {
+			memset(bounds, 0, sizeof(text->bounds));
+			return true;
+		}
+
+		SpriteBatcher* sb = text->glyphs;
+		if (!spriteBatcherCheckResize(sb, placed.instanceCount)) return false;
+
+		for (int p = 0; p < font->pageCount; p++) {
+			for (uint32_t k = 0; k < placed.instanceCount; k++) {
+				if (pages[k] != p) continue;
+
+				memcpy((uint8_t*)sb->instanceData + sb->instanceCount * SPRITE_INSTANCE_SIZE, (uint8_t*)placed.instanceData + k * SPRITE_INSTANCE_SIZE, SPRITE_INSTANCE_SIZE);
+				sb->instanceCount++;
+				text->pageCounts[p]++;
+			}
+		}
+
+		return true;
+	}
+
+	void textSetColor(Text* text, uint32_t color) {
+		text->color = color;
+
+		uint32_t* data = (uint32_t*)text->glyphs->instanceData;
+		for (uint32_t i = 0; i < text->glyphs->instanceCount; i++) {
+			data[i * 12 + 3] = color;
+		}
+	}
+
+	// Queues [text]'s glyphs with its top left corner at [x], [y].
+	void textDraw(Text* text, float x, float y) {
+		SpriteBatcher* glyphs = text->glyphs;
+		if (glyphs->instanceCount == 0) return;
+
+		float* b = text->bounds;
+		if (renderCullQuad(x + b[0], y + b[1], x + b[2], y + b[1], x + b[0], y + b[3], x + b[2], y + b[3])) return;
+
+		uint32_t first = 0;
+
+		for (int p = 0; p < text->font->pageCount; p++) {
+			uint32_t count = text->pageCounts[p];
+			if (count == 0) continue;
+
+			SpriteBatcher* sb = renderQueueBeginSprites();
+
+			if (spriteBatcherCheckResize(sb, count)) {
+				float* data = (float*)sb->instanceData + sb->instanceCount * 12;
+				memcpy(data, (float*)glyphs->instanceData + first * 12, count * SPRITE_INSTANCE_SIZE);
+
+				for (uint32_t i = 0; i < count; i++) {
+					data[i * 12] += x;
+					data[i * 12 + 1] += y;
+				}
+
+				sb->instanceCount += count;
+			}
+
+			renderQueueEndSprites(text->font->pages[p]);
+
+			first += count;
+		}
+	}
+
+
+	// === CANVAS ===
+
+	// Canvases are offscreen framebuffers. Between canvasBegin() and canvasEnd() every draw goes to the
+	// Canvas instead of the main framebuffer, and the camera is sized to it. Canvases are drawn upside
+	// down, so the first row of their texture is the top, and the texture draws like any Sprite's.
+
+	typedef struct Canvas {
+		GLuint framebuffer;
+		// Owned by the Canvas's Sprite.
+		GLuint texture;
+		int width;
+		int height;
+		// The camera and clip of what was being drawn to before, restored by [canvasEnd()].
+		float camera[9];
+		bool scissor;
+		GLint scissorRect[4];
+	} Canvas;
+
+	// Binds the Canvas being drawn to, or the main framebuffer.
+	void canvasBindTarget() {
+		if (canvasCurrent) {
+			glBindFramebuffer(GL_FRAMEBUFFER, canvasCurrent->framebuffer);
+			glViewport(0, 0, canvasCurrent->width, canvasCurrent->height);
+		} else {
+			glBindFramebuffer(GL_FRAMEBUFFER, mainFramebufferDirect ? 0 : mainFramebuffer);
+			glViewport(0, 0, game_resolutionWidth, game_resolutionHeight);
+		}
+	}
+
+	void canvasBegin(Canvas* canvas) {
+		// Draws queued so far go to the main framebuffer.
+		renderQueueFlush();
+
+		memcpy(canvas->camera, getCameraMatrix(), sizeof(canvas->camera));
+		canvas->scissor = renderState.scissor;
+		memcpy(canvas->scissorRect, renderState.scissorRect, sizeof(canvas->scissorRect));
+
+		canvasCurrent = canvas;
+		canvasBindTarget();
+
+		setCameraOrigin(0, 0, NULL);
+		renderStateResetScissor();
+	}
+
+	void canvasEnd() {
+		Canvas* canvas = canvasCurrent;
+		if (!canvas) return;
+
+		renderQueueFlush();
+
+		canvasCurrent = NULL;
+		canvasBindTarget();
+
+		memcpy(getCameraMatrix(), canvas->camera, sizeof(canvas->camera));
+		renderCameraVersion++;
+		renderState.scissor = canvas->scissor;
+		memcpy(renderState.scissorRect, canvas->scissorRect, sizeof(canvas->scissorRect));
+		renderStateDirty = true;
+	}
+
+
+	// === SPRITE ATLAS ===
+
+	// Sprites loaded with an "atlas" option share large texture pages, so draws from different images
+	// can go out in a single draw call. Images are placed with the skyline packer shared with sock-bake
+	// (see [src/c/sock_skyline.h]); space isn't reclaimed when a Sprite is freed, pages live until exit.
+	#define ATLAS_PAGE_SIZE 2048
+	// Border of extruded edge pixels around each image, so filtering doesn't sample its neighbours.
+	#define ATLAS_PADDING 1
+
+	typedef struct AtlasPage {
+		GLuint texture;
+		GLint filter;
+		int size;
+		// Where the packed images are.
+		Skyline skyline;
+		struct AtlasPage* next;
+	} AtlasPage;
+
+	typedef struct Atlas {
+		char* name;
+		AtlasPage* pages;
+		struct Atlas* next;
+	} Atlas;
+
+	static Atlas* atlases = NULL;
+	static int atlas_pageSize = 0;
+
+	// Pages are [ATLAS_PAGE_SIZE] unless the GPU's texture size limit is smaller.
+	int atlasPageSize() {
+		if (atlas_pageSize == 0) {
+			GLint maxSize;
+			glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxSize);
+			atlas_pageSize = maxSize < ATLAS_PAGE_SIZE ? maxSize : ATLAS_PAGE_SIZE;
+		}
+
+		return atlas_pageSize;
+	}
+
+	// Creates a [size] x [size] page, with its texture initialized to [pixels] if not NULL.
+	AtlasPage* atlasPageNew(int size, const void* pixels) {
+		AtlasPage* page = malloc(sizeof(AtlasPage));
+		if (!page) return NULL;
+
+		if (!skylineInit(&page->skyline, size)) {
+			free(page);
+			return NULL;
+		}
+
+		page->size = size;
+		page->filter = defaultSpriteFilter;
+		page->next = NULL;
+
+		glGenTextures(1, &page->texture);
+		glCacheEditTexture(page->texture);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, defaultSpriteFilter);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, defaultSpriteFilter);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, page->size, page->size, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+		renderStats_textureMemory += (int64_t)page->size * page->size * 4;
+
+		return page;
+	}
+
+	// Gets the atlas called [name], creating it if needed.
+	Atlas* atlasGet(const char* name) {
+		for (Atlas* atlas = atlases; atlas; atlas = atlas->next) {
+			if (strcmp(atlas->name, name) == 0) return atlas;
+		}
+
+		Atlas* atlas = malloc(sizeof(Atlas));
+		if (!atlas) return NULL;
+
+		atlas->name = _strdup(name);
+		atlas->pages = NULL;
+		atlas->next = atlases;
+		atlases = atlas;
+
+		return atlas;
+	}
+
+	// Packs the RGBA image [data] into one of [atlas]'s pages, setting [x], [y] to its position.
+	// Returns NULL if the image is larger than a page, or on allocation failure.
+	AtlasPage* atlasAdd(Atlas* atlas, const uint32_t* data, int width, int height, int* x, int* y) {
+		int paddedWidth = width + 2 * ATLAS_PADDING;
+		int paddedHeight = height + 2 * ATLAS_PADDING;
+
+		if (paddedWidth > atlasPageSize() || paddedHeight > atlasPageSize()) return NULL;
+
+		// Copy with the edges extruded into the padding.
+		// Done before packing, so no page space is reserved if it fails.
+		uint32_t* padded = malloc((size_t)paddedWidth * paddedHeight * 4);
+		if (!padded) return NULL;
+
+		for (int py = 0; py < paddedHeight; py++) {
+			int sy = py - ATLAS_PADDING;
+			if (sy < 0) sy = 0;
+			if (sy >= height) sy = height - 1;
+
+			const uint32_t* src = data + (size_t)sy * width;
+			uint32_t* dst = padded + (size_t)py * paddedWidth;
+
+			for (int px = 0; px < ATLAS_PADDING; px++) {
+				dst[px] = src[0];
+				dst[ATLAS_PADDING + width + px] = src[width - 1];
+			}
+			memcpy(dst + ATLAS_PADDING, src, (size_t)width * 4);
+		}
+
+		AtlasPage* page = atlas->pages;
+		AtlasPage* last = NULL;
+
+		while (page && !skylineInsert(&page->skyline, paddedWidth, paddedHeight, x, y)) {
+			last = page;
+			page = page->next;
+		}
+
+		if (!page) {
+			page = atlasPageNew(atlasPageSize(), NULL);
+			if (!page) {
+				free(padded);
+				return NULL;
+			}
+
+			skylineInsert(&page->skyline, paddedWidth, paddedHeight, x, y);
+
+			if (last) {
+				last->next = page;
+			} else {
+				atlas->pages = page;
+			}
+		}
+
+		glCacheEditTexture(page->texture);
+		glTexSubImage2D(GL_TEXTURE_2D, 0, *x, *y, paddedWidth, paddedHeight, GL_RGBA, GL_UNSIGNED_BYTE, padded);
+		free(padded);
+
+		*x += ATLAS_PADDING;
+		*y += ATLAS_PADDING;
+
+		return page;
+	}
+
+	// Sets the scale filter of every Sprite on [page].
+	void atlasPageSetFilter(AtlasPage* page, GLint filter) {
+		page->filter = filter;
+		glCacheEditTexture(page->texture);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filter);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter);
+	}
+
+	// Baked pages written by sock-bake (see [src/c/sock_bake.c]) are mapped and uploaded as they are,
+	// so images in its index load without being decoded.
+	#define BAKE_VERSION 2
+	#define BAKE_HEADER_SIZE 16
+
+	typedef struct {
+		char* path;
+		int page;
+		int x;
+		int y;
+		int width;
+		int height;
+		// Size and last write time of the image when it was baked.
+		int64_t fileSize;
+		int64_t fileTime;
+	} BakeEntry;
+
+	static bool bake_loaded = false;
+	// Sorted by path.
+	static BakeEntry* bake_entries = NULL;
+	static int bake_entryCount = 0;
+	// Uploaded on first use.
+	static AtlasPage** bake_pages = NULL;
+	static int bake_pageCount = 0;
+	// Width and height of every page, entries are checked against it.
+	static int bake_pageSize = 0;
+
+	// Reads [.bake/index.txt] from the assets, if there is one.
+	void bakeIndexLoad() {
+		bake_loaded = true;
+
+		char* index = readAsset(".bake/index.txt", NULL);
+		if (!index) {
+			quitError = NULL;
+			return;
+		}
+
+		int version, pageSize, pageCount;
+		if (
+			sscanf(index, "sock-bake %d %d %d", &version, &pageSize, &pageCount) != 3 ||
+			version != BAKE_VERSION || pageSize <= 0 || pageCount <= 0
+		) {
+			#if DEBUG
+
+				printf("ignoring unsupported .bake/index.txt\n");
+
+			#endif
+
+			free(index);
+			return;
+		}
+
+		int capacity = 0;
+		for (char* c = index; *c; c++) {
+			if (*c == '\n') capacity++;
+		}
+
+		bake_entries = malloc(capacity * sizeof(BakeEntry));
+		bake_pages = calloc(pageCount, sizeof(AtlasPage*));
+		if (!bake_entries || !bake_pages) {
+			free(bake_entries);
+			free(bake_pages);
+			bake_entries = NULL;
+			bake_pages = NULL;
+			free(index);
+			return;
+		}
+
+		bake_pageCount = pageCount;
+		bake_pageSize = pageSize;
+
+		// Entries follow the header line.
+		char* line = strchr(index, '\n');
+		while (line && bake_entryCount < capacity) {
+			line++;
+
+			char* end = strchr(line, '\n');
+			if (end) {
+				*end = '\0';
+				if (end > line && end[-1] == '\r') end[-1] = '\0';
+			}
+
+			BakeEntry* entry = &bake_entries[bake_entryCount];
+			int pathOffset = 0;
+
+			long long fileSize, fileTime;
+
+			// Rects outside their page would read past its pixels.
+			if (
+				sscanf(line, "%d\t%d\t%d\t%d\t%d\t%lld\t%lld\t%n", &entry->page, &entry->x, &entry->y, &entry->width, &entry->height, &fileSize, &fileTime, &pathOffset) == 7 &&
+				pathOffset > 0 && line[pathOffset] != '\0' &&
+				entry->page >= 0 && entry->page < pageCount &&
+				entry->x >= 0 && entry->y >= 0 && entry->width > 0 && entry->height > 0 &&
+				entry->width <= pageSize - entry->x && entry->height <= pageSize - entry->y
+			) {
+				entry->fileSize = fileSize;
+				entry->fileTime = fileTime;
+				entry->path = _strdup(line + pathOffset);
+				if (entry->path) bake_entryCount++;
+			}
+
+			line = end;
+		}
+
+		free(index);
+	}
+
+	int bakeEntryCompare(const void* path, const void* entry) {
+		return strcmp((const char*)path, ((const BakeEntry*)entry)->path);
+	}
+
+	// Returns the baked image at asset [path], or NULL if it wasn't baked, or the image changed since.
+	// Images that are missing are only baked, and always used.
+	BakeEntry* bakeFind(const char* path) {
+		if (!bake_loaded) bakeIndexLoad();
+		if (bake_entryCount == 0) return NULL;
+
+		while (path[0] == '/') path++;
+
+		BakeEntry* entry = (BakeEntry*)bsearch(path, bake_entries, bake_entryCount, sizeof(BakeEntry), bakeEntryCompare);
+		if (!entry) return NULL;
+
+		char* absPath = resolveAssetPath(path);
+		int64_t size, mtime;
+
+		if (!absPath) {
+			quitError = NULL;
+		} else if (fileStat(absPath, &size, &mtime) && (size != entry->fileSize || mtime != entry->fileTime)) {
+			#if DEBUG
+
+				printf("ignoring stale baked image '%s'\n", path);
+
+			#endif
+
+			return NULL;
+		}
+
+		return entry;
+	}
+
+	// Gets baked page [index], mapping its file straight into a new texture on first use.
+	// Returns NULL if the page file is missing or invalid.
+	AtlasPage* bakePageGet(int index) {
+		if (bake_pages[index]) return bake_pages[index];
+
+		char name[32];
+		snprintf(name, 32, ".bake/page%d.rgba", index);
+
+		char* path = resolveAssetPath(name);
+		if (!path) {
+			quitError = NULL;
+			return NULL;
+		}
+
+		int64_t size;
+		uint8_t* data = (uint8_t*)fileMap(path, &size);
+		if (!data) return NULL;
+
+		GLint maxSize;
+		glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxSize);
+
+		// Header: "SKBP", version, width, height.
+		// Little endian like every platform Sock runs on.
+		uint32_t header[4];
+		AtlasPage* page = NULL;
+
+		if (size >= BAKE_HEADER_SIZE) {
+			memcpy(header, data, BAKE_HEADER_SIZE);
+
+			if (
+				memcmp(data, "SKBP", 4) == 0 && header[1] == BAKE_VERSION &&
+				header[2] == header[3] && header[2] == (uint32_t)bake_pageSize && header[2] <= (uint32_t)maxSize &&
+				size == BAKE_HEADER_SIZE + (int64_t)header[2] * header[3] * 4
+			) {
+				page = atlasPageNew((int)header[2], data + BAKE_HEADER_SIZE);
+			}
+		}
+
+		fileUnmap(data, size);
+
+		if (page) {
+			// Nothing else is packed into a baked page.
+			page->skyline.nodes[0].y = page->size;
+			bake_pages[index] = page;
+		}
+
+		return page;
+	}
+
+
+	// === FRAME PACING ===
+
+	// How long before a frame deadline to stop sleeping and start spinning, in seconds.
+	// SDL_Delay() may oversleep by a millisecond or more depending on the OS scheduler.
+	#define PACING_SPIN_TIME 0.0015
+
+	// Longest frame delta passed to the game, so a stall (a dragged window, a breakpoint) doesn't make
+	// everything jump ahead.
+	#define PACING_MAX_DELTA 0.066
+
+	// Current time in seconds, from the high resolution performance counter.
+	double pacingNow() {
+		return (double)SDL_GetPerformanceCounter() / pacing_perfFrequency;
+	}
+
+	// Blocks until [deadline] (from [pacingNow()]).
+	// Sleeps for most of the wait, then spins for the last [PACING_SPIN_TIME] seconds.
+	void pacingWaitUntil(double deadline) {
+		double now = pacingNow();
+
+		double sleep = deadline - now - PACING_SPIN_TIME;
+		if (sleep >= 0.001) {
+			SDL_Delay((Uint32)(sleep * 1000.0));
+
+			double then = pacingNow();
+			pacing_sleepTime += then - now;
+			now = then;
+		}
+
+		double spinStart = now;
+		while (now < deadline) {
+			now = pacingNow();
+		}
+		pacing_spinTime += now - spinStart;
+	}
+
+	// Reads the refresh rate of the display the window is on.
+	void pacingUpdateDisplayPeriod() {
+		SDL_DisplayMode mode;
+		int display = SDL_GetWindowDisplayIndex(window);
+
+		if (display >= 0 && SDL_GetCurrentDisplayMode(display, &mode) == 0 && mode.refresh_rate > 0) {
+			pacing_displayPeriod = 1.0 / mode.refresh_rate;
+		} else {
+			pacing_displayPeriod = 1.0 / 60.0;
+		}
+	}
+
+	// Sets the swap interval, falling back to regular vsync if adaptive vsync is not supported.
+	void pacingSetSwapInterval(int interval) {
+		if (SDL_GL_SetSwapInterval(interval) != 0 && interval < 0) {
+			SDL_GL_SetSwapInterval(1);
+		}
+
+		game_swapInterval = SDL_GL_GetSwapInterval();
+	}
+
+	// Returns true if [SDL_GL_SwapWindow()] will wait for the display, so frames don't need a timer.
+	// A hidden or minimized window is never presented, so it has to be paced by timer.
+	bool pacingIsVsynced() {
+		if (game_swapInterval == 0) return false;
+		if (SDL_GetWindowFlags(window) & (SDL_WINDOW_HIDDEN | SDL_WINDOW_MINIMIZED)) return false;
+
+		return game_fps <= 0 || game_fps >= 1.0 / pacing_displayPeriod - 0.5;
+	}
+
+	// The target time between frames in seconds, or 0 if uncapped.
+	double pacingFramePeriod() {
+		if (game_fps > 0) {
+			if (game_swapInterval != 0 && game_fps >= 1.0 / pacing_displayPeriod - 0.5) return pacing_displayPeriod;
+			return 1.0 / game_fps;
+		}
+
+		return game_swapInterval != 0 ? pacing_displayPeriod : 0;
+	}
+
+
+	// === WREN HEAP ===
+
+	// Every Wren allocation is prefixed with its size, so the live heap size can be tracked.
+	// 16 bytes keeps the allocation aligned for any type.
+	#define HEAP_HEADER_SIZE 16
+
+	// Heap settings from the command line, 0 for Wren's defaults.
+	static size_t heap_initialSize = 0;
+	static size_t heap_minSize = 0;
+	static int heap_growthPercent = 0;
+
+	// Live bytes allocated by Wren.
+	static size_t heap_bytes = 0;
+	// Live bytes just after the last collection, used to guess when Wren will next collect.
+	static size_t heap_bytesAfterGC = 0;
+	// Bytes allocated this frame, and whether garbage was collected, and the same for the last completed frame.
+	// Only whether any collection ran is known, not how many, as the sentinel is placed once per frame.
+	static uint64_t heap_frameAllocated = 0;
+	static bool heap_frameCollected = false;
+	static uint64_t heap_lastAllocated = 0;
+	static bool heap_lastCollected = false;
+
+	// When true, garbage is collected between frames if there is time before the next frame deadline.
+	static bool heap_idleGC = false;
+	// Estimated time for a collection in seconds.
+	static double heap_gcTime = 0.001;
+
+	// A Wren object that is never referenced, so its finalizer runs on the next collection.
+	// It can't be replaced from the finalizer, so collections after the first in a frame go unnoticed.
+	static WrenHandle* handle_HeapSentinel = NULL;
+	static bool heap_sentinelAlive = false;
+
+	// Frees a block allocated by [wren_reallocate()], of [size] bytes excluding the header.
+	void heapFreeBlock(char* block, size_t size) {
+		int sizeClass = pool_enabled ? poolClassOf(size) : -1;
+
+		if (sizeClass >= 0) {
+			poolFree(sizeClass, block);
+		} else {
+			free(block);
+		}
+	}
+
+	void* wren_reallocate(void* memory, size_t newSize, void* userData) {
+		char* block = NULL;
+		size_t oldSize = 0;
+
+		if (memory) {
+			block = (char*)memory - HEAP_HEADER_SIZE;
+			oldSize = *(size_t*)block;
+		}
+
+		if (newSize == 0) {
+			if (block) {
+				heap_bytes -= oldSize;
+				heapFreeBlock(block, oldSize);
+			}
+			return NULL;
+		}
+
+		int oldClass = pool_enabled && block ? poolClassOf(oldSize) : -1;
+		int newClass = pool_enabled ? poolClassOf(newSize) : -1;
+
+		char* result;
+		if (oldClass >= 0 && oldClass == newClass) {
+			// Still fits in the same block.
+			result = block;
+		} else if (newClass >= 0 || oldClass >= 0) {
+			// Moving in to, out of, or between pools.
+			if (newClass >= 0) {
+				result = (char*)poolAlloc(newClass, POOL_CLASS_SIZES[newClass] + HEAP_HEADER_SIZE);
+			} else {
+				result = (char*)malloc(newSize + HEAP_HEADER_SIZE);
+				pool_systemAllocCount++;
+			}
+			if (!result) return NULL;
+
+			if (block) {
+				memcpy(result + HEAP_HEADER_SIZE, memory, oldSize < newSize ? oldSize : newSize);
+				heapFreeBlock(block, oldSize);
+			}
+		} else {
+			result = (char*)realloc(block, newSize + HEAP_HEADER_SIZE);
+			if (!result) return NULL;
+
+			pool_systemAllocCount++;
+		}
+
+		*(size_t*)result = newSize;
+		heap_bytes = heap_bytes - oldSize + newSize;
+		if (newSize > oldSize) heap_frameAllocated += newSize - oldSize;
+
+		return result + HEAP_HEADER_SIZE;
+	}
+
+	void wren_heapSentinelAllocate(WrenVM* vm) {
+		wrenSetSlotNewForeign(vm, 0, 0, 1);
+	}
+
+	void wren_heapSentinelFinalize(void* data) {
+		heap_frameCollected = true;
+		heap_sentinelAlive = false;
+	}
+
+	// Creates an unreferenced sentinel object, if the last one has been collected.
+	void heapPlaceSentinel() {
+		if (heap_sentinelAlive || !handle_HeapSentinel) return;
+
+		wrenEnsureSlots(vm, 2);
+		wrenSetSlotHandle(vm, 1, handle_HeapSentinel);
+		wrenSetSlotNewForeign(vm, 0, 1, 1);
+		wrenSetSlotNull(vm, 0);
+		heap_sentinelAlive = true;
+	}
+
+	// Returns true if Wren is likely to collect garbage soon, in the middle of an update.
+	// Mirrors Wren's own trigger, which collects when the heap grows [heapGrowthPercent] past the size after the last collection.
+	bool heapCollectionDue(const WrenConfiguration* config) {
+		size_t next = heap_bytesAfterGC + heap_bytesAfterGC * config->heapGrowthPercent / 100;
+		if (next < config->minHeapSize) next = config->minHeapSize;
+
+		// Collect once halfway there.
+		return heap_bytes >= heap_bytesAfterGC + (next - heap_bytesAfterGC) / 2;
+	}
+
+	// Collects garbage if it's due and [slack] seconds is enough time to do so.
+	void heapCollectIdle(const WrenConfiguration* config, double slack) {
+		if (slack < heap_gcTime * 1.5 + PACING_SPIN_TIME || !heapCollectionDue(config)) return;
+
+		profilerBegin("gc");
+		double start = pacingNow();
+
+		wrenCollectGarbage(vm);
+
+		double time = pacingNow() - start;
+		profilerEnd();
+
+		// Follow increases quickly, decreases slowly.
+		heap_gcTime = time > heap_gcTime ? time : heap_gcTime * 0.9 + time * 0.1;
+		heap_bytesAfterGC = heap_bytes;
+	}
+
+	void heapEndFrame() {
+		if (heap_frameCollected) {
+			heap_bytesAfterGC = heap_bytes;
+		}
+
+		heap_lastAllocated = heap_frameAllocated;
+		heap_lastCollected = heap_frameCollected;
+		heap_frameAllocated = 0;
+		heap_frameCollected = false;
+
+		heapPlaceSentinel();
+	}
+
+
+	// === SOCK WREN API ===
+
+	void wren_methodTODO(WrenVM* vm) {
+		wrenAbort(vm, "TODO Method");
+	}
+
+	// TIME
+
+	void wren_Time_epoch(WrenVM* vm) {
+		wrenSetSlotDouble(vm, 0, (double)_time64(NULL));
+	}
+
+	// INPUT
+
+	// Returns the input code in slot [slot], or -1 if it's not a valid code.
+	int wrenGetSlotInputCode(WrenVM* vm, int slot) {
+		if (wrenGetSlotType(vm, slot) != WREN_TYPE_NUM) return -1;
+
+		int code = (int)wrenGetSlotDouble(vm, slot);
+		return code >= 0 && code < INPUT_CODE_COUNT ? code : -1;
+	}
+
+	void wren_Input_code_(WrenVM* vm) {
+		if (wrenEnsureArgString(vm, 1, "input ID")) return;
+
+		wrenSetSlotDouble(vm, 0, inputIDToCode(wrenGetSlotString(vm, 1)));
+	}
+
+	void wren_Input_value_(WrenVM* vm) {
+		int code = wrenGetSlotInputCode(vm, 1);
+		wrenSetSlotDouble(vm, 0, code < 0 ? 0 : inputStates[code].value);
+	}
+
+	void wren_Input_held_(WrenVM* vm) {
+		int code = wrenGetSlotInputCode(vm, 1);
+		wrenSetSlotBool(vm, 0, code >= 0 && inputIsHeld(code));
+	}
+
+	void wren_Input_pressed_(WrenVM* vm) {
+		int code = wrenGetSlotInputCode(vm, 1);
+		wrenSetSlotBool(vm, 0, code >= 0 && inputIsPressed(code));
+	}
+
+	void wren_Input_released_(WrenVM* vm) {
+		int code = wrenGetSlotInputCode(vm, 1);
+		wrenSetSlotBool(vm, 0, code >= 0 && inputIsReleased(code));
+	}
+
+	void wren_Input_whichPressed(WrenVM* vm) {
+		for (int code = 0; code < INPUT_CODE_COUNT; code++) {
+			if (inputIsPressed(code)) {
+				wrenSetSlotString(vm, 0, inputCodeToID(code));
+				return;
+			}
+		}
+
+		wrenSetSlotNull(vm, 0);
+	}
+
+	void wren_Input_holdCutoff(WrenVM* vm) {
+		wrenSetSlotDouble(vm, 0, inputHoldCutoff);
+	}
+
+	void wren_Input_holdCutoff_(WrenVM* vm) {
+		if (wrenGetSlotType(vm, 1) != WREN_TYPE_NUM) {
+			wrenAbort(vm, "holdCutoff must be a Num");
+			return;
+		}
+
+		inputHoldCutoff = (float)wrenGetSlotDouble(vm, 1);
+	}
+
+	void wren_Input_advance_(WrenVM* vm) {
+		inputFrame++;
+	}
+
+	void wren_Input_localize(WrenVM* vm) {
+		int idType = wrenGetSlotType(vm, 1);
+		if (idType == WREN_TYPE_NULL) {
+			wrenSetSlotNull(vm, 0);
+			return;
+		}
+		if (idType != WREN_TYPE_STRING) {
+			wrenAbort(vm, "input ID must be a String");
+			return;
+		}
+
+		const char* id = wrenGetSlotString(vm, 1);
+
+		// Use SDL_GetKeyFromScancode() to do keyboard layout mapping.
+		//   ID -> Scancode
+		//   Scancode -> KeyCode (via keyboard layout)
+		//   KeyCode -> Scancode (direct mapping)
+		//   Scancode -> ID
+		SDL_Scancode scancode = inputIDToSDLScancode(id);
+		if (scancode != SDL_SCANCODE_UNKNOWN) {
+			SDL_KeyCode localizedKeycode = SDL_GetKeyFromScancode(scancode);
+			SDL_Scancode localizedScancode = sdlDirectKeyCodeToScancode(localizedKeycode);
+			if (localizedScancode != SDL_SCANCODE_UNKNOWN) {
+				const char* localizedID = sdlScancodeToInputID(localizedScancode);
+				if (localizedID) {
+					id = localizedID;
+				}
+			}
+		}
+
+		wrenSetSlotString(vm, 0, id);
+	}
+
+	#define TEXT_INPUT_VALUE_SIZE 512
+	static bool textInputActive = false;
+	static char* textInputValue = NULL;
+	static int textInputValueLen = 0;
+	static int textInputSelectionStart = 0;
+	static int textInputSelectionEnd = 0;
+	static char* textInputDescription = NULL;
+
+	void textInputStop() {
+		textInputActive = false;
+		SDL_StopTextInput();
+	}
+
+	void textInputInsert(const char* value) {
+		int len = value == NULL ? 0 : (int)strlen(value);
+		int left = min(textInputSelectionStart, textInputSelectionEnd);
+		int right = max(textInputSelectionStart, textInputSelectionEnd);
+		int width = right - left;
+
+		// Collapse selection.
+		if (width != 0) {
+			for (int i = right; i < textInputValueLen; i++) {
+				textInputValue[i - width] = textInputValue[i];
+			}
+			textInputValueLen -= width;
+		}
+
+		// Insert characters.
+		if (len != 0) {
+			if (textInputValueLen + len >= TEXT_INPUT_VALUE_SIZE) {
+				len = 0;
+			} else {
+				for (int i = textInputValueLen - 1; i >= left; i--) {
+					textInputValue[i + len] = textInputValue[i];
+				}
+
+				for (int i = 0; i < len; i++) {
+					textInputValue[left + i] = value[i];
+				}
+
+				textInputValueLen += len;
+			}
+		}
+
+		textInputSelectionStart = textInputSelectionEnd = left + len;
+	}
+
+	void wren_Input_textBegin(WrenVM* vm) {
+		if (textInputActive) {
+			return;
+		}
+
+		int argType = wrenGetSlotType(vm, 1);
+		if (argType == WREN_TYPE_NULL || argType == WREN_TYPE_STRING) {
+			// Type is unused.
+		} else {
+			wrenAbort(vm, "type must be String");
+			return;
+		}
+
+		// Init value buffer.
+		if (!textInputValue) {
+			textInputValue = malloc(TEXT_INPUT_VALUE_SIZE);
+			if (!textInputValue) {
+				return;
+			}
+		}
+		textInputValueLen = 0;
+		textInputSelectionStart = 0;
+		textInputSelectionEnd = 0;
+
+		// Start capturing text inputs.
+		SDL_StartTextInput();
+
+		SDL_Rect rect;
+		rect.x = game_windowWidth / 2;
+		rect.y = game_windowHeight / 2 - 8;
+		rect.w = game_windowWidth / 2 - 4;
+		rect.h = 16;
+		SDL_SetTextInputRect(&rect);
+
+		textInputActive = true;
+	}
+
+	void wren_Input_textDescription(WrenVM* vm) {
+		wrenSetSlotString(vm, 0, textInputDescription == NULL ? "Text" : textInputDescription);
+	}
+	void wren_Input_textDescriptionSet(WrenVM* vm) {
+		if (wrenGetSlotType(vm, 1) != WREN_TYPE_STRING) {
+			wrenAbort(vm, "description must be String");
+			return;
+		}
+
+		if (textInputDescription) {
+			free(textInputDescription);
+		}
+
+		textInputDescription = _strdup(wrenGetSlotString(vm, 1));
+	}
+
+	void wren_Input_textIsActive(WrenVM* vm) {
+		wrenSetSlotBool(vm, 0, textInputActive);
+	}
+	
+	void wren_Input_textSelection(WrenVM* vm) {
+		wrenSetSlotRange(vm, 0, textInputSelectionStart, textInputSelectionEnd, 1, true);
+	}
+
+	void wren_Input_textString(WrenVM* vm) {
+		wrenSetSlotBytes(vm, 0, textInputValue ? textInputValue : "", textInputValueLen);
+	}
+
+
+	// AUDIO
+
+	void wren_audio_load(WrenVM* vm) {
+		if (wrenGetSlotType(vm, 1) != WREN_TYPE_STRING) {
+			wrenAbort(vm, "path must be a string");
+			return;
+		}
+
+		const char* path = wrenGetSlotString(vm, 1);
+
+		int64_t len;
+		char* data = readAsset(path, &len);
+		if (!data) {
+			wrenAbort(vm, quitError);
+			quitError = NULL;
+			return;
+		}
+
+		printf("file size = %d\n", (int)len);
+
+		if (!wren_audio_loadHandler(vm, data, (unsigned int)len)) {
+			free(data);
+		}
+	}
+
+	// ARRAY
+
+	void wren_Buffer_load(WrenVM* vm) {
+		if (wrenGetSlotType(vm, 1) != WREN_TYPE_STRING) {
+			wrenAbort(vm, "path must be a string");
+			return;
+		}
+
+		const char* path = wrenGetSlotString(vm, 1);
+
+		// Load from file.
+		int64_t arrayLength;
+		char* data = readAsset(path, &arrayLength);
+		if (!data) {
+			wrenAbort(vm, quitError);
+			quitError = NULL;
+			return;
+		}
+
+		if (arrayLength >= (int64_t)UINT32_MAX) {
+			free(data);
+			wrenAbort(vm, "Buffer cannot hold more than ~4GB");
+			return;
+		}
+
+		// Save to new buffer.
+		Buffer* buffer = (Buffer*)wrenSetSlotNewForeign(vm, 0, 0, sizeof(Buffer));
+		buffer->length = (uint32_t)arrayLength;
+		buffer->data = data;
+	}
+
+	// ASSET
+
+	void wren_Asset_exists(WrenVM* vm) {
+		if (wrenGetSlotType(vm, 1) != WREN_TYPE_STRING) {
+			wrenAbort(vm, "path must be a string");
+			return;
+		}
+
+		const char* path = wrenGetSlotString(vm, 1);
+		char* fileName = resolveAssetPath(path);
+
+		if (fileName) {
+			wrenSetSlotBool(vm, 0, fileExists(fileName));
+		} else {
+			wrenAbort(vm, quitError);
+		}
+	}
+
+	void wren_Asset_loadString(WrenVM* vm) {
+		if (wrenGetSlotType(vm, 1) != WREN_TYPE_STRING) {
+			wrenAbort(vm, "path must be a string");
+			return;
+		}
+
+		const char* path = wrenGetSlotString(vm, 1);
+
+		// Load from asset.
+		int64_t strLength;
+		char* str = readAsset(path, &strLength);
+		if (!str) {
+			wrenAbort(vm, quitError);
+			quitError = NULL;
+			return;
+		}
+
+		wrenSetSlotBytes(vm, 0, str, strLength);
+	}
+	
+	void wren_Asset_loadBundle(WrenVM* vm) {
+		// TODO
+	}
+
+	// CAMERA
+
+	// Gets the size of what's being drawn to, a Canvas or the main framebuffer, and its scale from pixels
+	// to clip space. Canvases are upside down, so their y scale is flipped.
+	void getCameraScale(int* width, int* height, float* sx, float* sy) {
+		if (canvasCurrent) {
+			*width = canvasCurrent->width;
+			*height = canvasCurrent->height;
+			*sx = 2.0f / *width;
+			*sy = 2.0f / *height;
+		} else {
+			*width = game_resolutionWidth;
+			*height = game_resolutionHeight;
+			*sx =  2.0f / *width;
+			*sy = -2.0f / *height;
+		}
+	}
+
+	void setCameraOrigin(float x, float y, float* tf) {
+		renderStateDirty = true;
+		renderCameraVersion++;
+
+		int width, height;
+		float sx, sy;
+		getCameraScale(&width, &height, &sx, &sy);
+
+		// The origin is the top edge.
+		float oy = sy < 0 ? 1.0f : -1.0f;
+
+		if (tf) {
+			cameraMatrix[0] = sx * tf[0];
+			cameraMatrix[1] = sy * tf[1];
+			cameraMatrix[2] = 0;
+			
+			cameraMatrix[3] = sx * tf[2];
+			cameraMatrix[4] = sy * tf[3];
+			cameraMatrix[5] = 0;
+		
+			cameraMatrix[6] = x * sx - 1.0f + sx * tf[4];
+			cameraMatrix[7] = y * sy + oy + sy * tf[5];
+			cameraMatrix[8] = 1.0f;
+		} else {
+			cameraMatrix[0] = sx;
+			cameraMatrix[1] = 0;
+			cameraMatrix[2] = 0;
+			
+			cameraMatrix[3] = 0;
+			cameraMatrix[4] = sy;
+			cameraMatrix[5] = 0;
+		
+			cameraMatrix[6] = x * sx - 1.0f;
+			cameraMatrix[7] = y * sy + oy;
+			cameraMatrix[8] = 1.0f;
+		}
+	}
+
+	void cameraLookAt(float x, float y, float* tf) {
+		renderStateDirty = true;
+		renderCameraVersion++;
+
+		int width, height;
+		float sx, sy;
+		getCameraScale(&width, &height, &sx, &sy);
+
+		// If dimensions are not even, need shift origin by half a pixel.
+		float dx = width  % 2 == 0 ? 0.0f : 0.5f;
+		float dy = height % 2 == 0 ? 0.0f : 0.5f;
+
+		if (tf) {
+			cameraMatrix[0] = sx * tf[0];
+			cameraMatrix[1] = sy * tf[1];
+			cameraMatrix[2] = 0;
+			
+			cameraMatrix[3] = sx * tf[2];
+			cameraMatrix[4] = sy * tf[3];
+			cameraMatrix[5] = 0;
+
+			cameraMatrix[6] = sx * (tf[4] - tf[0] * x - tf[2] * y + dx);
+			cameraMatrix[7] = sy * (tf[5] - tf[1] * x - tf[3] * y + dy);
+			cameraMatrix[8] = 1.0f;
+		} else {
+			cameraMatrix[0] = sx;
+			cameraMatrix[1] = 0;
+			cameraMatrix[2] = 0;
+			
+			cameraMatrix[3] = 0;
+			cameraMatrix[4] = sy;
+			cameraMatrix[5] = 0;
+
+			cameraMatrix[6] = (dx - x) * sx;
+			cameraMatrix[7] = (dy - y) * sy;
+			cameraMatrix[8] = 1.0f;
+		}
+	}
+
+	void wren_Camera_setter(WrenVM* vm, int type) {
+		if (wrenGetSlotType(vm, 1) != WREN_TYPE_NUM || wrenGetSlotType(vm, 2) != WREN_TYPE_NUM) {
+			wrenAbort(vm, "x/y must be Num");
+			return;
+		}
+
+		float x = (float)wrenGetSlotDouble(vm, 1);
+		float y = (float)wrenGetSlotDouble(vm, 2);
+		
+		float* tf = NULL;
+		if (wrenGetSlotType(vm, 3) != WREN_TYPE_NULL) {
+			transform_putClassHandle(vm);
+			if (!wrenGetSlotIsInstanceOf(vm, 3, 0)) {
+				wrenAbort(vm, "transform must be Transform");
+				return;
+			}
+
+			tf = (float*)wrenGetSlotForeign(vm, 3);
+		}
+
+		if (!tf) {
+			x = floorf(x);
+			y = floorf(y);
+		}
+		
+		if (type == 0) {
+			setCameraOrigin(x, y, tf);
+		} else {
+			cameraLookAt(x, y, tf);
+		}
+	}
+
+	void wren_Camera_setOrigin(WrenVM* vm) {
+		wren_Camera_setter(vm, 0);
+	}
+	
+	void wren_Camera_lookAt(WrenVM* vm) {
+		wren_Camera_setter(vm, 1);
+	}
+
+	void wren_Camera_reset(WrenVM* vm) {
+		setCameraOrigin(0, 0, NULL);
+	}
+
+	float* getCameraMatrix() {
+		if (isnan(cameraMatrix[0])) {
+			setCameraOrigin(0, 0, NULL);
+		}
+
+		return cameraMatrix;
+	}
+
+	// Gets the bounds of the world visible through the camera: x1, y1, x2, y2.
+	// Returns false if the camera doesn't map to a rect (e.g. it is scaled to 0).
+	bool getCameraRect(float* rect) {
+		float* m = getCameraMatrix();
+
+		// Invert the 2x2 part of the matrix, to map the corners of clip space back to the world.
+		float det = m[0] * m[4] - m[3] * m[1];
+		if (det == 0 || !isfinite(det)) return false;
+
+		float a =  m[4] / det;
+		float b = -m[1] / det;
+		float c = -m[3] / det;
+		float d =  m[0] / det;
+
+		rect[0] = rect[1] = INFINITY;
+		rect[2] = rect[3] = -INFINITY;
+
+		for (int i = 0; i < 4; i++) {
+			float cx = (i & 1 ? 1.0f : -1.0f) - m[6];
+			float cy = (i & 2 ? 1.0f : -1.0f) - m[7];
+			float x = a * cx + c * cy;
+			float y = b * cx + d * cy;
+
+			if (x < rect[0]) rect[0] = x;
+			if (y < rect[1]) rect[1] = y;
+			if (x > rect[2]) rect[2] = x;
+			if (y > rect[3]) rect[3] = y;
+		}
+
+		return true;
+	}
+
+	// SPRITE
+
+	Sprite* spriteAllocate(WrenVM* vm) {
+		Sprite* spr = (Sprite*)wrenSetSlotNewForeign(vm, 0, 0, sizeof(Sprite));
+		
+		spr->texture.width = 0;
+		spr->texture.height = 0;
+		spr->texture.filter = defaultSpriteFilter;
+		spr->texture.wrap = defaultSpriteWrap;
+		spr->texture.id = 0;
+		spr->transform.matrix[0] = NAN;
+		spr->transform.matrix[1] = 0.0f;
+		spr->transform.matrix[2] = 0.0f;
+		spr->transform.matrix[3] = 0.0f;
+		spr->transform.matrix[4] = 0.0f;
+		spr->transform.matrix[5] = 0.0f;
+		spr->transform.originX = NAN;
+		spr->transform.originY = 0.0f;
+		spr->path = NULL;
+		spr->color = 0xffffffff;
+		spr->atlasPage = NULL;
+		spr->uv[0] = 0.0f;
+		spr->uv[1] = 0.0f;
+		spr->uv[2] = 1.0f;
+		spr->uv[3] = 1.0f;
+
+		return spr;
+	}
+
+	void wren_spriteAllocate(WrenVM* vm) {
+		spriteAllocate(vm);
+	}
+
+	void wren_spriteFinalize(void* data) {
+		Sprite* spr = (Sprite*)data;
+		
+		// Queued draws may still use the texture, so it is deleted with the frame.
+		// Atlas pages are shared, and never deleted.
+		if (spr->texture.id != 0 && !spr->atlasPage) {
+			renderStats_textureMemory -= (int64_t)spr->texture.width * spr->texture.height * 4;
+			renderDeleteTexture(spr->texture.id);
+		}
+
+		if (spr->path) {
+			free(spr->path);
+		}
+	}
+
+	void wren_sprite_width(WrenVM* vm) {
+		Sprite* spr = (Sprite*)wrenGetSlotForeign(vm, 0);
+		wrenSetSlotDouble(vm, 0, spr->texture.width);
+	}
+	
+	void wren_sprite_height(WrenVM* vm) {
+		Sprite* spr = (Sprite*)wrenGetSlotForeign(vm, 0);
+		wrenSetSlotDouble(vm, 0, spr->texture.height);
+	}
+
+	// Places [spr] at [x], [y] on atlas [page].
+	void spriteSetAtlasPage(Sprite* spr, AtlasPage* page, int x, int y) {
+		spr->texture.id = page->texture;
+		spr->texture.wrap = GL_CLAMP_TO_EDGE;
+		spr->atlasPage = page;
+		spr->uv[0] = (float)x / page->size;
+		spr->uv[1] = (float)y / page->size;
+		spr->uv[2] = (float)spr->texture.width / page->size;
+		spr->uv[3] = (float)spr->texture.height / page->size;
+	}
+
+	// Loads the image at [path] into a new Sprite in slot 0.
+	// If [baked] and the image was baked by sock-bake, it's placed on its baked page without decoding.
+	// Otherwise if [atlasName] isn't NULL the image is packed into that atlas, unless it's larger than a page.
+	void spriteLoad(WrenVM* vm, const char* path, const char* atlasName, bool baked) {
+		if (baked) {
+			BakeEntry* entry = bakeFind(path);
+			AtlasPage* page = entry ? bakePageGet(entry->page) : NULL;
+
+			if (page) {
+				Sprite* spr = spriteAllocate(vm);
+				spr->texture.width = entry->width;
+				spr->texture.height = entry->height;
+				spr->path = _strdup(path);
+				spriteSetAtlasPage(spr, page, entry->x, entry->y);
+				return;
+			}
+		}
+
+		// Load from file.
+		int64_t imgSize;
+		char* img = readAsset(path, &imgSize);
+		if (!img) {
+			wrenAbort(vm, quitError);
+			quitError = NULL;
+			return;
+		}
+
+		int width, height, channelCount;
+		stbi_uc* data = stbi_load_from_memory((stbi_uc*)img, (int)imgSize, &width, &height, &channelCount, 4);
+		
+		free(img);
+
+		if (!data) {
+			wrenAbort(vm, stbi_failure_reason());
+			return;
+		}
+
+		// Pack into an atlas page.
+		AtlasPage* page = NULL;
+		int x, y;
+
+		if (atlasName) {
+			Atlas* atlas = atlasGet(atlasName);
+			if (atlas) page = atlasAdd(atlas, (uint32_t*)data, width, height, &x, &y);
+		}
+
+		GLuint id = 0;
+
+		if (!page) {
+			// Load into WebGL texture.
+			glGenTextures(1, &id);
+			glCacheEditTexture(id);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, defaultSpriteWrap);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, defaultSpriteWrap);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, defaultSpriteFilter);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, defaultSpriteFilter);
+			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
+			renderStats_textureMemory += (int64_t)width * height * 4;
+		}
+
+		stbi_image_free(data);
+
+		// Save to new Sprite.
+		Sprite* spr = spriteAllocate(vm);
+		spr->texture.width = width;
+		spr->texture.height = height;
+		spr->texture.id = id;
+		spr->path = _strdup(path);
+
+		if (page) spriteSetAtlasPage(spr, page, x, y);
+	}
+
+	void wren_Sprite_load(WrenVM* vm) {
+		if (wrenGetSlotType(vm, 1) != WREN_TYPE_STRING) {
+			wrenAbort(vm, "path must be a string");
+			return;
+		}
+
+		spriteLoad(vm, wrenGetSlotString(vm, 1), NULL, false);
+	}
+
+	void wren_Sprite_load_2(WrenVM* vm) {
+		if (wrenGetSlotType(vm, 1) != WREN_TYPE_STRING) {
+			wrenAbort(vm, "path must be a string");
+			return;
+		}
+
+		if (wrenGetSlotType(vm, 2) != WREN_TYPE_MAP) {
+			wrenAbort(vm, "options must be a Map");
+			return;
+		}
+
+		wrenEnsureSlots(vm, 4);
+
+		const char* atlasName = NULL;
+		bool baked = false;
+
+		wrenSetSlotString(vm, 3, "baked");
+
+		if (wrenGetMapContainsKey(vm, 2, 3)) {
+			wrenGetMapValue(vm, 2, 3, 3);
+
+			if (wrenGetSlotType(vm, 3) != WREN_TYPE_BOOL) {
+				wrenAbort(vm, "baked must be a Bool");
+				return;
+			}
+
+			baked = wrenGetSlotBool(vm, 3);
+		}
+
+		wrenSetSlotString(vm, 3, "atlas");
+
+		if (wrenGetMapContainsKey(vm, 2, 3)) {
+			wrenGetMapValue(vm, 2, 3, 3);
+
+			if (wrenGetSlotType(vm, 3) == WREN_TYPE_STRING) {
+				atlasName = wrenGetSlotString(vm, 3);
+			} else if (wrenGetSlotType(vm, 3) != WREN_TYPE_NULL) {
+				wrenAbort(vm, "atlas must be a String");
+				return;
+			}
+		}
+
+		spriteLoad(vm, wrenGetSlotString(vm, 1), atlasName, baked);
+	}
+
+	void wren_sprite_scaleFilter(WrenVM* vm) {
+		Sprite* spr = (Sprite*)wrenGetSlotForeign(vm, 0);
+		if (spr->atlasPage) spr->texture.filter = spr->atlasPage->filter;
+		wrenSetSlotString(vm, 0, glFilterEnumToString(spr->texture.filter));
+	}
+	
+	void wren_sprite_scaleFilter_set(WrenVM* vm) {
+		GLuint filter = wren_filterStringToGlEnum(vm, 1);
+
+		if (filter != 0) {
+			Sprite* spr = (Sprite*)wrenGetSlotForeign(vm, 0);
+			if (spr->atlasPage) spr->texture.filter = spr->atlasPage->filter;
+
+			if (filter != spr->texture.filter) {
+				spr->texture.filter = filter;
+
+				if (spr->atlasPage) {
+					// Shared with the rest of the page.
+					renderQueueFlush();
+					atlasPageSetFilter(spr->atlasPage, filter);
+				} else if (spr->texture.id != 0) {
+					glCacheEditTexture(spr->texture.id);
+					glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter);
+					glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filter);
+				}
+			}
+		}
+	}
+	
+	void wren_sprite_wrapMode(WrenVM* vm) {
+		Sprite* spr = (Sprite*)wrenGetSlotForeign(vm, 0);
+		wrenSetSlotString(vm, 0, glWrapEnumToString(spr->texture.wrap));
+	}
+	
+	void wren_sprite_wrapMode_set(WrenVM* vm) {
+		GLuint wrap = wren_wrapStringToGlEnum(vm, 1);
+		
+		if (wrap != 0) {
+			Sprite* spr = (Sprite*)wrenGetSlotForeign(vm, 0);
+
+			if (spr->atlasPage) {
+				if (wrap != GL_CLAMP_TO_EDGE) wrenAbort(vm, "atlas Sprites can only clamp");
+				return;
+			}
+
+			spr->texture.wrap = wrap;
+
+			if (spr->texture.id != 0) {
+				glCacheEditTexture(spr->texture.id);
+				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, wrap);
+				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, wrap);
+			}
+		}
+	}
+	
+	void wren_sprite_beginBatch(WrenVM* vm) {
+		Sprite* spr = (Sprite*)wrenGetSlotForeign(vm, 0);
+		
+		if (spr->batcher) {
+			wrenAbort(vm, "batch already started");
+		} else {
+			spr->batcher = spriteBatcherGet();
+			spriteBatcherBegin(spr->batcher);
+		}
+	}
+	
+	void wren_sprite_endBatch(WrenVM* vm) {
+		Sprite* spr = (Sprite*)wrenGetSlotForeign(vm, 0);
+		
+		if (spr->batcher) {
+			spriteBatcherEnd(spr->batcher, spr->texture.id);
+			spriteBatcherPut(spr->batcher);
+			spr->batcher = NULL;
+		} else {
+			wrenAbort(vm, "batch not yet started");
+		}
+	}
+
+	void wren_sprite_color(WrenVM* vm) {
+		Sprite* spr = (Sprite*)wrenGetSlotForeign(vm, 0);
+
+		wrenSetSlotDouble(vm, 0, spr->color);
+	}
+	
+	void wren_sprite_color_set(WrenVM* vm) {
+		Sprite* spr = (Sprite*)wrenGetSlotForeign(vm, 0);
+
+		if (wrenGetSlotType(vm, 1) == WREN_TYPE_NUM) {
+			spr->color = (uint32_t)wrenGetSlotDouble(vm, 1);
+		} else {
+			wrenAbort(vm, "color must be Num");
+		}
+	}
+
+	void wren_sprite_transform(WrenVM* vm) {
+		Sprite* spr = (Sprite*)wrenGetSlotForeign(vm, 0);
+
+		if (isnan(spr->transform.matrix[0])) {
+			wrenSetSlotNull(vm, 0);
+		} else {
+			transform_putClassHandle(vm);
+
+			float* t = (float*)wrenSetSlotNewForeign(vm, 0, 0, TRANSFORM_SIZE);
+
+			for (int i = 0; i < 6; i++) {
+				t[i] = spr->transform.matrix[i];
+			}
+		}
+	}
+	
+	void wren_sprite_transform_set(WrenVM* vm) {
+		Sprite* spr = (Sprite*)wrenGetSlotForeign(vm, 0);
+
+		if (wrenGetSlotType(vm, 1) == WREN_TYPE_NULL) {
+			spr->transform.matrix[0] = NAN;
+		} else {
+			transform_putClassHandle(vm);
+
+			if (wrenGetSlotIsInstanceOf(vm, 1, 0)) {
+				float* t = (float*)wrenGetSlotForeign(vm, 1);
+
+				for (int i = 0; i < 6; i++) {
+					spr->transform.matrix[i] = t[i];
+				}
 			} else {
-				// Convert out of range characters to heart glyph
-				if (!(c >= ' ' && c <= '~')) c = 127;
+				wrenAbort(vm, "transform must be a Transform");
+				return;
+			}
+		}
 
-				// Draw the character!
-				int idx = c - 32;
-				int spx = (idx % 16) * 6;
-				int spy = (idx / 16) * 12;
+		spr->transform.originX = 0;
+		spr->transform.originY = 0;
+	}
+	
+	void wren_sprite_setTransform(WrenVM* vm) {
+		if (wrenGetSlotType(vm, 1) != WREN_TYPE_NUM || wrenGetSlotType(vm, 2) != WREN_TYPE_NUM) {
+			wrenAbort(vm, "x/y must be Nums");
+			return;
+		}
 
-				spriteBatcherDrawRect(sb,
-					(float)(dx),     (float)(dy),
-					(float)(dx + 6), (float)(dy + 12),
-					0,
-					spx / (float)COZETTE_WIDTH, spy / (float)COZETTE_HEIGHT,
-					(spx + 6) / (float)COZETTE_WIDTH, (spy + 12) / (float)COZETTE_HEIGHT,
-					color,
-					NULL
-				);
+		Sprite* spr = (Sprite*)wrenGetSlotForeign(vm, 0);
+		float x = (float)wrenGetSlotDouble(vm, 1);
+		float y = (float)wrenGetSlotDouble(vm, 2);
+
+		transform_putClassHandle(vm);
+		if (wrenGetSlotIsInstanceOf(vm, 3, 0)) {
+			spr->transform.originX = x;
+			spr->transform.originY = y;
+
+			float* t = (float*)wrenGetSlotForeign(vm, 3);
+
+			for (int i = 0; i < 6; i++) {
+				spr->transform.matrix[i] = t[i];
+			}
+		} else {
+			wrenAbort(vm, "transform must be a Transform");
+		}
+	}
+
+	void wren_sprite_draw_4(WrenVM* vm) {
+		for (int i = 1; i <= 4; i++) {
+			if (wrenGetSlotType(vm, i) != WREN_TYPE_NUM) {
+				wrenAbort(vm, "args must be numbers");
+				return;
+			}
+		}
+
+		Sprite* spr = (Sprite*)wrenGetSlotForeign(vm, 0);
+		float x1 = (float)wrenGetSlotDouble(vm, 1);
+		float y1 = (float)wrenGetSlotDouble(vm, 2);
+		float x2 = x1 + (float)wrenGetSlotDouble(vm, 3);
+		float y2 = y1 + (float)wrenGetSlotDouble(vm, 4);
+
+		SpriteBatcher* sb = spr->batcher;
+		if (!sb) sb = renderQueueBeginSprites();
+
+		spriteBatcherDrawRect(sb, x1, y1, x2, y2, spr->uv[0], spr->uv[1], spr->uv[0] + spr->uv[2], spr->uv[1] + spr->uv[3], spr->color, isnan(spr->transform.matrix[0]) ? NULL : &spr->transform);
+
+		if (!spr->batcher) renderQueueEndSprites(spr->texture.id);
+	}
+	
+	void wren_sprite_draw_8(WrenVM* vm) {
+		for (int i = 1; i <= 9; i++) {
+			if (wrenGetSlotType(vm, i) != WREN_TYPE_NUM) {
+				wrenAbort(vm, "args must be numbers");
+				return;
+			}
+		}
+
+		Sprite* spr = (Sprite*)wrenGetSlotForeign(vm, 0);
+		float x1 = (float)wrenGetSlotDouble(vm, 1);
+		float y1 = (float)wrenGetSlotDouble(vm, 2);
+		float x2 = x1 + (float)wrenGetSlotDouble(vm, 3);
+		float y2 = y1 + (float)wrenGetSlotDouble(vm, 4);
+		double uScale = spr->uv[2] / spr->texture.width;
+		double vScale = spr->uv[3] / spr->texture.height;
+		float u1 = spr->uv[0] + (float)(wrenGetSlotDouble(vm, 5) * uScale);
+		float v1 = spr->uv[1] + (float)(wrenGetSlotDouble(vm, 6) * vScale);
+		float u2 = u1 + (float)(wrenGetSlotDouble(vm, 7) * uScale);
+		float v2 = v1 + (float)(wrenGetSlotDouble(vm, 8) * vScale);
+
+		SpriteBatcher* sb = spr->batcher;
+		if (!sb) sb = renderQueueBeginSprites();
+
+		spriteBatcherDrawRect(sb, x1, y1, x2, y2, u1, v1, u2, v2, spr->color, isnan(spr->transform.matrix[0]) ? NULL : &spr->transform);
+
+		if (!spr->batcher) renderQueueEndSprites(spr->texture.id);
+	}
+
+	// Sprite.drawBuffer record: x, y, w, h, u, v, uw, vh, color, [a, b, c, d, e, f].
+	#define SPRITE_RECORD_SIZE 9
+	// Quad.drawBuffer record: x, y, w, h, color, [a, b, c, d, e, f].
+	#define QUAD_RECORD_SIZE 5
+	// Words added to a record by its optional 2x3 transform.
+	#define RECORD_TRANSFORM_SIZE 6
+
+	// Gets the packed records of a drawBuffer(buffer, count, transformed) call starting at [slot].
+	// Colors are stored as uint32 bits, everything else as float32.
+	// Returns NULL and aborts if the args are invalid or [buffer] is too small.
+	// Otherwise slot 0, the return value, is set to null.
+	float* wren_getRecordBuffer(WrenVM* vm, int slot, uint32_t recordSize, uint32_t* count, bool* transformed) {
+		buffer_putClassHandle(vm);
+		if (!wrenGetSlotIsInstanceOf(vm, slot, 0)) {
+			wrenAbort(vm, "buffer must be a Buffer");
+			return NULL;
+		}
+
+		if (wrenGetSlotType(vm, slot + 1) != WREN_TYPE_NUM) {
+			wrenAbort(vm, "count must be a Num");
+			return NULL;
+		}
+
+		if (wrenGetSlotType(vm, slot + 2) != WREN_TYPE_BOOL) {
+			wrenAbort(vm, "transformed must be a Bool");
+			return NULL;
+		}
+
+		Buffer* buffer = (Buffer*)wrenGetSlotForeign(vm, slot);
+		double n = wrenGetSlotDouble(vm, slot + 1);
+		*transformed = wrenGetSlotBool(vm, slot + 2);
+
+		if (*transformed) recordSize += RECORD_TRANSFORM_SIZE;
+
+		if (n < 0 || n != trunc(n)) {
+			wrenAbort(vm, "count must be a non-negative integer");
+			return NULL;
+		}
+
+		if (n * recordSize > buffer->length / 4) {
+			wrenAbort(vm, "buffer too small for count");
+			return NULL;
+		}
+
+		*count = (uint32_t)n;
+
+		// Slot 0 held the Buffer class for the check above.
+		wrenSetSlotNull(vm, 0);
+
+		return (float*)buffer->data;
+	}
+
+	void wren_sprite_drawBuffer(WrenVM* vm) {
+		Sprite* spr = (Sprite*)wrenGetSlotForeign(vm, 0);
+
+		uint32_t count;
+		bool transformed;
+		float* record = wren_getRecordBuffer(vm, 1, SPRITE_RECORD_SIZE, &count, &transformed);
+		if (!record || count == 0) return;
+
+		uint32_t recordSize = SPRITE_RECORD_SIZE + (transformed ? RECORD_TRANSFORM_SIZE : 0);
+		float uScale = spr->uv[2] / spr->texture.width;
+		float vScale = spr->uv[3] / spr->texture.height;
+
+		// Records with a transform use it in place of the Sprite's, with the origin at x, y.
+		Transform recordTransform;
+		recordTransform.originX = 0;
+		recordTransform.originY = 0;
+		Transform* transform = transformed ? &recordTransform : (isnan(spr->transform.matrix[0]) ? NULL : &spr->transform);
+
+		SpriteBatcher* sb = spr->batcher;
+		if (!sb) sb = renderQueueBeginSprites();
+
+		for (uint32_t i = 0; i < count; i++, record += recordSize) {
+			float x1 = record[0];
+			float y1 = record[1];
+			float u1 = spr->uv[0] + record[4] * uScale;
+			float v1 = spr->uv[1] + record[5] * vScale;
+
+			if (transformed) memcpy(recordTransform.matrix, record + SPRITE_RECORD_SIZE, sizeof(recordTransform.matrix));
+
+			spriteBatcherDrawRect(
+				sb,
+				x1, y1,
+				x1 + record[2], y1 + record[3],
+				u1, v1,
+				u1 + record[6] * uScale, v1 + record[7] * vScale,
+				((uint32_t*)record)[8],
+				transform
+			);
+		}
+
+		if (!spr->batcher) renderQueueEndSprites(spr->texture.id);
+	}
+
+	void wren_sprite_toString(WrenVM* vm) {
+		Sprite* spr = (Sprite*)wrenGetSlotForeign(vm, 0);
+
+		if (spr->path) {
+			wrenSetSlotString(vm, 0, spr->path);
+		} else {
+			char buffer[32];
+			snprintf(buffer, 32, "Sprite#%p", &spr);
+			wrenSetSlotString(vm, 0, buffer);
+		}
+	}
+
+	void wren_Sprite_defaultScaleFilter(WrenVM* vm) {
+		wrenSetSlotString(vm, 0, glFilterEnumToString(defaultSpriteFilter));
+	}
+	
+	void wren_Sprite_defaultScaleFilter_set(WrenVM* vm) {
+		GLuint filter = wren_filterStringToGlEnum(vm, 1);
+
+		if (filter != 0) {
+			defaultSpriteFilter = filter;
+		}
+	}
+	
+	void wren_Sprite_defaultWrapMode(WrenVM* vm) {
+		wrenSetSlotString(vm, 0, glWrapEnumToString(defaultSpriteWrap));
+	}
+	
+	void wren_Sprite_defaultWrapMode_set(WrenVM* vm) {
+		GLuint wrap = wren_wrapStringToGlEnum(vm, 1);
+		
+		if (wrap != 0) {
+			defaultSpriteWrap = wrap;
+		}
+	}
+
+	// QUAD
+
+	void wren_Quad_beginBatch(WrenVM* vm) {
+		if (quadBatcher.vertexCount == UINT32_MAX) {
+			primitiveBatcherBegin(&quadBatcher);
+		} else {
+			wrenAbort(vm, "batch already started");
+		}
+	}
+	
+	void wren_Quad_endBatch(WrenVM* vm) {
+		if (quadBatcher.vertexCount == UINT32_MAX) {
+			wrenAbort(vm, "batch not yet started");
+		} else {
+			primitiveBatcherEnd(&quadBatcher);
+		}
+	}
+
+	void wren_Quad_draw5(WrenVM* vm) {
+		for (int i = 1; i <= 5; i++) {
+			if (wrenGetSlotType(vm, i) != WREN_TYPE_NUM) {
+				wrenAbort(vm, "args must be Nums");
+				return;
+			}
+		}
+
+		float x = (float)wrenGetSlotDouble(vm, 1);
+		float y = (float)wrenGetSlotDouble(vm, 2);
+		float w = (float)wrenGetSlotDouble(vm, 3);
+		float h = (float)wrenGetSlotDouble(vm, 4);
+		uint32_t color = (uint32_t)wrenGetSlotDouble(vm, 5);
+
+		bool singleBatch = quadBatcher.vertexCount == UINT32_MAX;
+		PrimitiveBatcher* pb = singleBatch ? renderQueueBeginPrimitives() : &quadBatcher;
 		
-				dx += 6;
-			}
+		primitiveBatcherDrawRect(
+			pb,
+			x, y,
+			x + w, y + h,
+			0,
+			color,
+			NULL
+		);
 
-			if (dx >= screenWidth) {
-				dx = cornerX;
-				dy += 14;
+		if (singleBatch) renderQueueEndPrimitives();
+	}
+	
+	void wren_Quad_draw9(WrenVM* vm) {
+		for (int i = 1; i <= 9; i++) {
+			if (wrenGetSlotType(vm, i) != WREN_TYPE_NUM) {
+				wrenAbort(vm, "args must be Nums");
+				return;
 			}
-
-			i++;
 		}
 
-		spriteBatcherEnd(sb, systemFontTexture);
+		float x1 = (float)wrenGetSlotDouble(vm, 1);
+		float y1 = (float)wrenGetSlotDouble(vm, 2);
+		float x2 = (float)wrenGetSlotDouble(vm, 3);
+		float y2 = (float)wrenGetSlotDouble(vm, 4);
+		float x3 = (float)wrenGetSlotDouble(vm, 5);
+		float y3 = (float)wrenGetSlotDouble(vm, 6);
+		float x4 = (float)wrenGetSlotDouble(vm, 7);
+		float y4 = (float)wrenGetSlotDouble(vm, 8);
+		uint32_t color = (uint32_t)wrenGetSlotDouble(vm, 9);
+
+		bool singleBatch = quadBatcher.vertexCount == UINT32_MAX;
+		PrimitiveBatcher* pb = singleBatch ? renderQueueBeginPrimitives() : &quadBatcher;
 
-		return dy;
+		primitiveBatcherDrawQuad(
+			pb,
+			x1, y1,
+			x2, y2,
+			x4, y4,
+			x3, y3,
+			0,
+			color,
+			NULL
+		);
+
+		if (singleBatch) renderQueueEndPrimitives();
 	}
 
+	void wren_Quad_drawBuffer(WrenVM* vm) {
+		uint32_t count;
+		bool transformed;
+		float* record = wren_getRecordBuffer(vm, 1, QUAD_RECORD_SIZE, &count, &transformed);
+		if (!record || count == 0) return;
 
-	// === SOCK WREN API ===
+		uint32_t recordSize = QUAD_RECORD_SIZE + (transformed ? RECORD_TRANSFORM_SIZE : 0);
 
-	void wren_methodTODO(WrenVM* vm) {
-		wrenAbort(vm, "TODO Method");
-	}
+		Transform recordTransform;
+		recordTransform.originX = 0;
+		recordTransform.originY = 0;
 
-	// TIME
+		bool singleBatch = quadBatcher.vertexCount == UINT32_MAX;
+		PrimitiveBatcher* pb = singleBatch ? renderQueueBeginPrimitives() : &quadBatcher;
 
-	void updateTimeModule(double time, double deltaTime) {
-		wrenEnsureSlots(vm, 3);
-		wrenSetSlotHandle(vm, 0, handle_Time);
-		wrenSetSlotDouble(vm, 1, time);
-		wrenSetSlotDouble(vm, 2, deltaTime);
-		wrenCall(vm, callHandle_update_2);
-	}
+		for (uint32_t i = 0; i < count; i++, record += recordSize) {
+			if (transformed) memcpy(recordTransform.matrix, record + QUAD_RECORD_SIZE, sizeof(recordTransform.matrix));
 
-	void wren_Time_epoch(WrenVM* vm) {
-		wrenSetSlotDouble(vm, 0, (double)_time64(NULL));
+			primitiveBatcherDrawRect(
+				pb,
+				record[0], record[1],
+				record[0] + record[2], record[1] + record[3],
+				0,
+				((uint32_t*)record)[4],
+				transformed ? &recordTransform : NULL
+			);
+		}
+
+		if (singleBatch) renderQueueEndPrimitives();
 	}
 
-	// INPUT
+	// STATIC BATCH
 
-	void updateInputMouse() {
-		double x = floor((mouseWindowPosX - game_renderRect.x) / game_renderScale);
-		double y = floor((mouseWindowPosY - game_renderRect.y) / game_renderScale);
+	void wren_staticBatchAllocate(WrenVM* vm) {
+		StaticBatch* batch = (StaticBatch*)wrenSetSlotNewForeign(vm, 0, 0, sizeof(StaticBatch));
+		memset(batch, 0, sizeof(StaticBatch));
+	}
 
-		wrenEnsureSlots(vm, 4);
-		wrenSetSlotHandle(vm, 0, handle_Input);
-		wrenSetSlotDouble(vm, 1, x);
-		wrenSetSlotDouble(vm, 2, y);
-		wrenSetSlotDouble(vm, 3, (double)mouseWheel);
-		wrenCall(vm, callHandle_updateMouse_3);
+	void wren_staticBatchFinalize(void* data) {
+		StaticBatch* batch = (StaticBatch*)data;
 
-		mouseWheel = 0;
-	}
+		// Drop an unfinished recording.
+		if (renderQueue.recording == batch) staticBatchDropRecording();
 
-	bool updateInput(const char* id, float value) {
-		wrenEnsureSlots(vm, 3);
-		wrenSetSlotHandle(vm, 0, handle_Input);
-		wrenSetSlotString(vm, 1, id);
-		wrenSetSlotDouble(vm, 2, value);
-		return wrenCall(vm, callHandle_update_2) == WREN_RESULT_SUCCESS;
+		staticBatchClear(batch);
 	}
 
-	void wren_Input_localize(WrenVM* vm) {
-		int idType = wrenGetSlotType(vm, 1);
-		if (idType == WREN_TYPE_NULL) {
-			wrenSetSlotNull(vm, 0);
+	void wren_staticBatch_begin(WrenVM* vm) {
+		StaticBatch* batch = (StaticBatch*)wrenGetSlotForeign(vm, 0);
+
+		if (renderQueue.recording) {
+			wrenAbort(vm, "already recording a StaticBatch");
 			return;
 		}
-		if (idType != WREN_TYPE_STRING) {
-			wrenAbort(vm, "input ID must be a String");
+
+		staticBatchBegin(batch);
+	}
+
+	void wren_staticBatch_end(WrenVM* vm) {
+		StaticBatch* batch = (StaticBatch*)wrenGetSlotForeign(vm, 0);
+
+		if (renderQueue.recording != batch) {
+			wrenAbort(vm, "StaticBatch not recording");
 			return;
 		}
 
-		const char* id = wrenGetSlotString(vm, 1);
+		staticBatchEnd();
+	}
 
-		// Use SDL_GetKeyFromScancode() to do keyboard layout mapping.
-		//   ID -> Scancode
-		//   Scancode -> KeyCode (via keyboard layout)
-		//   KeyCode -> Scancode (direct mapping)
-		//   Scancode -> ID
-		SDL_Scancode scancode = inputIDToSDLScancode(id);
-		if (scancode != SDL_SCANCODE_UNKNOWN) {
-			SDL_KeyCode localizedKeycode = SDL_GetKeyFromScancode(scancode);
-			SDL_Scancode localizedScancode = sdlDirectKeyCodeToScancode(localizedKeycode);
-			if (localizedScancode != SDL_SCANCODE_UNKNOWN) {
-				const char* localizedID = sdlScancodeToInputID(localizedScancode);
-				if (localizedID) {
-					id = localizedID;
-				}
-			}
+	void wren_staticBatch_draw(WrenVM* vm) {
+		StaticBatch* batch = (StaticBatch*)wrenGetSlotForeign(vm, 0);
+
+		if (renderQueue.recording) {
+			wrenAbort(vm, "cannot draw a StaticBatch while recording one");
+			return;
 		}
 
-		wrenSetSlotString(vm, 0, id);
+		staticBatchDraw(batch);
 	}
 
-	#define TEXT_INPUT_VALUE_SIZE 512
-	static bool textInputActive = false;
-	static char* textInputValue = NULL;
-	static int textInputValueLen = 0;
-	static int textInputSelectionStart = 0;
-	static int textInputSelectionEnd = 0;
-	static char* textInputDescription = NULL;
+	void wren_staticBatch_clear(WrenVM* vm) {
+		StaticBatch* batch = (StaticBatch*)wrenGetSlotForeign(vm, 0);
 
-	void textInputStop() {
-		textInputActive = false;
-		SDL_StopTextInput();
+		if (renderQueue.recording == batch) {
+			wrenAbort(vm, "cannot clear a StaticBatch while recording it");
+			return;
+		}
+
+		staticBatchClear(batch);
 	}
 
-	void textInputInsert(const char* value) {
-		int len = value == NULL ? 0 : (int)strlen(value);
-		int left = min(textInputSelectionStart, textInputSelectionEnd);
-		int right = max(textInputSelectionStart, textInputSelectionEnd);
-		int width = right - left;
+	void wren_staticBatch_drawCalls(WrenVM* vm) {
+		StaticBatch* batch = (StaticBatch*)wrenGetSlotForeign(vm, 0);
+		wrenSetSlotDouble(vm, 0, batch->drawCount);
+	}
 
-		// Collapse selection.
-		if (width != 0) {
-			for (int i = right; i < textInputValueLen; i++) {
-				textInputValue[i - width] = textInputValue[i];
-			}
-			textInputValueLen -= width;
-		}
+	// TILEMAP
 
-		// Insert characters.
-		if (len != 0) {
-			if (textInputValueLen + len >= TEXT_INPUT_VALUE_SIZE) {
-				len = 0;
-			} else {
-				for (int i = textInputValueLen - 1; i >= left; i--) {
-					textInputValue[i + len] = textInputValue[i];
-				}
+	// Tiles per chunk side. Each chunk is a static batch, rebuilt when one of its tiles changes.
+	#define TILEMAP_CHUNK_SIZE 32
 
-				for (int i = 0; i < len; i++) {
-					textInputValue[left + i] = value[i];
-				}
+	typedef struct {
+		StaticBatch batch;
+		bool dirty;
+	} TilemapChunk;
 
-				textInputValueLen += len;
+	typedef struct {
+		uint32_t columns;
+		uint32_t rows;
+		uint32_t chunkColumns;
+		uint32_t chunkRows;
+		TilemapChunk* chunks;
+		// The tileset the chunks were built from, which rebuilds them all when it changes.
+		GLuint texture;
+		float uv[4];
+		float tileWidth;
+		float tileHeight;
+	} Tilemap;
+
+	void tilemapInvalidate(Tilemap* map) {
+		for (uint32_t i = 0; i < map->chunkColumns * map->chunkRows; i++) {
+			map->chunks[i].dirty = true;
+		}
+	}
+
+	// Builds the instances of the non-empty tiles in chunk [cx], [cy].
+	void tilemapBuildChunk(Tilemap* map, uint32_t cx, uint32_t cy, const uint32_t* tiles, Sprite* tileset) {
+		TilemapChunk* chunk = &map->chunks[cy * map->chunkColumns + cx];
+		chunk->dirty = false;
+
+		uint32_t x1 = cx * TILEMAP_CHUNK_SIZE;
+		uint32_t y1 = cy * TILEMAP_CHUNK_SIZE;
+		uint32_t x2 = x1 + TILEMAP_CHUNK_SIZE < map->columns ? x1 + TILEMAP_CHUNK_SIZE : map->columns;
+		uint32_t y2 = y1 + TILEMAP_CHUNK_SIZE < map->rows ? y1 + TILEMAP_CHUNK_SIZE : map->rows;
+
+		SpriteBatcher sb;
+		sb.capacity = (x2 - x1) * (y2 - y1);
+		sb.instanceCount = 0;
+		sb.instanceData = frameAlloc(sb.capacity * SPRITE_INSTANCE_SIZE);
+		if (!sb.instanceData) return;
+
+		float tw = map->tileWidth;
+		float th = map->tileHeight;
+		uint32_t perRow = (uint32_t)(tileset->texture.width / tw);
+		float uScale = tileset->uv[2] / tileset->texture.width;
+		float vScale = tileset->uv[3] / tileset->texture.height;
+
+		for (uint32_t y = y1; y < y2; y++) {
+			for (uint32_t x = x1; x < x2; x++) {
+				// Tiles count from 1, 0 is empty.
+				uint32_t tile = tiles[y * map->columns + x];
+				if (tile == 0 || perRow == 0) continue;
+
+				tile--;
+				float u1 = tileset->uv[0] + (tile % perRow) * tw * uScale;
+				float v1 = tileset->uv[1] + (tile / perRow) * th * vScale;
+
+				spriteBatcherAddInstance(&sb, x * tw, y * th, tw, 0, 0, th, 0xffffffffU, u1, v1, u1 + tw * uScale, v1 + th * vScale);
 			}
 		}
 
-		textInputSelectionStart = textInputSelectionEnd = left + len;
+		staticBatchSetSprites(&chunk->batch, sb.instanceData, sb.instanceCount, tileset->texture.id);
 	}
 
-	void wren_Input_textBegin(WrenVM* vm) {
-		if (textInputActive) {
-			return;
+	// Queues the chunks of [map] that the camera can see, with tile 0, 0 at [x], [y].
+	void tilemapDraw(Tilemap* map, const uint32_t* tiles, Sprite* tileset, float x, float y) {
+		if (
+			map->texture != tileset->texture.id ||
+			memcmp(map->uv, tileset->uv, sizeof(map->uv)) != 0
+		) {
+			map->texture = tileset->texture.id;
+			memcpy(map->uv, tileset->uv, sizeof(map->uv));
+			tilemapInvalidate(map);
+		}
+
+		uint32_t cx1 = 0;
+		uint32_t cy1 = 0;
+		uint32_t cx2 = map->chunkColumns;
+		uint32_t cy2 = map->chunkRows;
+
+		float rect[4];
+		if (getCameraRect(rect)) {
+			float cw = map->tileWidth * TILEMAP_CHUNK_SIZE;
+			float ch = map->tileHeight * TILEMAP_CHUNK_SIZE;
+
+			// Chunks are drawn with an offset, so cull in the map's space.
+			float fx1 = floorf((rect[0] - x) / cw);
+			float fy1 = floorf((rect[1] - y) / ch);
+			float fx2 = ceilf((rect[2] - x) / cw);
+			float fy2 = ceilf((rect[3] - y) / ch);
+
+			if (fx1 > 0) cx1 = fx1 < cx2 ? (uint32_t)fx1 : cx2;
+			if (fy1 > 0) cy1 = fy1 < cy2 ? (uint32_t)fy1 : cy2;
+			cx2 = fx2 <= 0 ? 0 : (fx2 < cx2 ? (uint32_t)fx2 : cx2);
+			cy2 = fy2 <= 0 ? 0 : (fy2 < cy2 ? (uint32_t)fy2 : cy2);
+		}
+
+		// The chunks are built at the origin, draw them through a camera moved by the offset.
+		bool offset = x != 0 || y != 0;
+		float camera[9];
+		if (offset) {
+			float* m = getCameraMatrix();
+			memcpy(camera, m, sizeof(camera));
+			m[6] += m[0] * x + m[3] * y;
+			m[7] += m[1] * x + m[4] * y;
+			renderStateDirty = true;
+			renderCameraVersion++;
+		}
+
+		for (uint32_t cy = cy1; cy < cy2; cy++) {
+			for (uint32_t cx = cx1; cx < cx2; cx++) {
+				TilemapChunk* chunk = &map->chunks[cy * map->chunkColumns + cx];
+				if (chunk->dirty) tilemapBuildChunk(map, cx, cy, tiles, tileset);
+
+				staticBatchDraw(&chunk->batch);
+			}
 		}
 
-		int argType = wrenGetSlotType(vm, 1);
-		if (argType == WREN_TYPE_NULL || argType == WREN_TYPE_STRING) {
-			// Type is unused.
-		} else {
-			wrenAbort(vm, "type must be String");
-			return;
+		if (offset) {
+			memcpy(getCameraMatrix(), camera, sizeof(camera));
+			renderStateDirty = true;
+			renderCameraVersion++;
 		}
+	}
 
-		// Init value buffer.
-		if (!textInputValue) {
-			textInputValue = malloc(TEXT_INPUT_VALUE_SIZE);
-			if (!textInputValue) {
+	void wren_tilemapAllocate(WrenVM* vm) {
+		Tilemap* map = (Tilemap*)wrenSetSlotNewForeign(vm, 0, 0, sizeof(Tilemap));
+		memset(map, 0, sizeof(Tilemap));
+
+		for (int i = 1; i <= 4; i++) {
+			if (wrenGetSlotType(vm, i) != WREN_TYPE_NUM) {
+				wrenAbort(vm, "args must be Nums");
 				return;
 			}
 		}
-		textInputValueLen = 0;
-		textInputSelectionStart = 0;
-		textInputSelectionEnd = 0;
-
-		// Start capturing text inputs.
-		SDL_StartTextInput();
 
-		SDL_Rect rect;
-		rect.x = game_windowWidth / 2;
-		rect.y = game_windowHeight / 2 - 8;
-		rect.w = game_windowWidth / 2 - 4;
-		rect.h = 16;
-		SDL_SetTextInputRect(&rect);
+		double columns = wrenGetSlotDouble(vm, 1);
+		double rows = wrenGetSlotDouble(vm, 2);
+		double tileWidth = wrenGetSlotDouble(vm, 3);
+		double tileHeight = wrenGetSlotDouble(vm, 4);
 
-		textInputActive = true;
-	}
+		if (columns < 1 || rows < 1 || columns != trunc(columns) || rows != trunc(rows) || columns * rows > UINT32_MAX) {
+			wrenAbort(vm, "columns and rows must be positive integers");
+			return;
+		}
 
-	void wren_Input_textDescription(WrenVM* vm) {
-		wrenSetSlotString(vm, 0, textInputDescription == NULL ? "Text" : textInputDescription);
-	}
-	void wren_Input_textDescriptionSet(WrenVM* vm) {
-		if (wrenGetSlotType(vm, 1) != WREN_TYPE_STRING) {
-			wrenAbort(vm, "description must be String");
+		if (!(tileWidth > 0 && tileHeight > 0)) {
+			wrenAbort(vm, "tile size must be positive");
 			return;
 		}
 
-		if (textInputDescription) {
-			free(textInputDescription);
+		map->columns = (uint32_t)columns;
+		map->rows = (uint32_t)rows;
+		map->chunkColumns = (map->columns + TILEMAP_CHUNK_SIZE - 1) / TILEMAP_CHUNK_SIZE;
+		map->chunkRows = (map->rows + TILEMAP_CHUNK_SIZE - 1) / TILEMAP_CHUNK_SIZE;
+		map->tileWidth = (float)tileWidth;
+		map->tileHeight = (float)tileHeight;
+
+		map->chunks = (TilemapChunk*)calloc(map->chunkColumns * map->chunkRows, sizeof(TilemapChunk));
+		if (!map->chunks) {
+			wrenAbort(vm, "out of memory");
+			return;
 		}
 
-		textInputDescription = _strdup(wrenGetSlotString(vm, 1));
+		tilemapInvalidate(map);
 	}
 
-	void wren_Input_textIsActive(WrenVM* vm) {
-		wrenSetSlotBool(vm, 0, textInputActive);
-	}
-	
-	void wren_Input_textSelection(WrenVM* vm) {
-		wrenSetSlotRange(vm, 0, textInputSelectionStart, textInputSelectionEnd, 1, true);
-	}
+	void wren_tilemapFinalize(void* data) {
+		Tilemap* map = (Tilemap*)data;
 
-	void wren_Input_textString(WrenVM* vm) {
-		wrenSetSlotBytes(vm, 0, textInputValue ? textInputValue : "", textInputValueLen);
-	}
+		if (map->chunks) {
+			for (uint32_t i = 0; i < map->chunkColumns * map->chunkRows; i++) {
+				staticBatchClear(&map->chunks[i].batch);
+			}
 
+			free(map->chunks);
+		}
+	}
 
-	// AUDIO
+	void wren_tilemap_draw(WrenVM* vm) {
+		Tilemap* map = (Tilemap*)wrenGetSlotForeign(vm, 0);
+		Sprite* tileset = (Sprite*)wrenGetSlotForeign(vm, 1);
+		Buffer* tiles = (Buffer*)wrenGetSlotForeign(vm, 2);
 
-	void wren_audio_load(WrenVM* vm) {
-		if (wrenGetSlotType(vm, 1) != WREN_TYPE_STRING) {
-			wrenAbort(vm, "path must be a string");
+		if (wrenGetSlotType(vm, 3) != WREN_TYPE_NUM || wrenGetSlotType(vm, 4) != WREN_TYPE_NUM) {
+			wrenAbort(vm, "position must be Nums");
 			return;
 		}
 
-		const char* path = wrenGetSlotString(vm, 1);
+		if (renderQueue.recording) {
+			wrenAbort(vm, "cannot draw a Tilemap while recording a StaticBatch");
+			return;
+		}
 
-		int64_t len;
-		char* data = readAsset(path, &len);
-		if (!data) {
-			wrenAbort(vm, quitError);
-			quitError = NULL;
+		if (tiles->length / 4 < map->columns * map->rows) {
+			wrenAbort(vm, "tiles Buffer too small for the map");
 			return;
 		}
 
-		printf("file size = %d\n", (int)len);
+		tilemapDraw(map, (const uint32_t*)tiles->data, tileset, (float)wrenGetSlotDouble(vm, 3), (float)wrenGetSlotDouble(vm, 4));
+	}
 
-		if (!wren_audio_loadHandler(vm, data, (unsigned int)len)) {
-			free(data);
-		}
+	void wren_tilemap_markDirty(WrenVM* vm) {
+		Tilemap* map = (Tilemap*)wrenGetSlotForeign(vm, 0);
+
+		// The tile was already range checked.
+		uint32_t x = (uint32_t)wrenGetSlotDouble(vm, 1);
+		uint32_t y = (uint32_t)wrenGetSlotDouble(vm, 2);
+
+		map->chunks[(y / TILEMAP_CHUNK_SIZE) * map->chunkColumns + x / TILEMAP_CHUNK_SIZE].dirty = true;
 	}
 
-	// ARRAY
+	void wren_tilemap_invalidate(WrenVM* vm) {
+		tilemapInvalidate((Tilemap*)wrenGetSlotForeign(vm, 0));
+	}
 
-	void wren_Buffer_load(WrenVM* vm) {
-		if (wrenGetSlotType(vm, 1) != WREN_TYPE_STRING) {
-			wrenAbort(vm, "path must be a string");
-			return;
-		}
+	// PARTICLES
 
-		const char* path = wrenGetSlotString(vm, 1);
+	// Particles are stored as structure-of-arrays, so they can be integrated 4 at a time with SSE2.
+	// Color and size aren't stored, they are looked up from the over-life curves when drawn.
 
-		// Load from file.
-		int64_t arrayLength;
-		char* data = readAsset(path, &arrayLength);
-		if (!data) {
-			wrenAbort(vm, quitError);
-			quitError = NULL;
-			return;
+	// Entries in the color and size over-life lookup tables.
+	#define PARTICLE_CURVE_SIZE 64
+
+	#define PARTICLE_SPAWN_POINT 0
+	#define PARTICLE_SPAWN_CIRCLE 1
+	#define PARTICLE_SPAWN_RECT 2
+
+	// Float arrays per particle.
+	#define PARTICLE_ARRAYS 8
+
+	typedef struct {
+		uint32_t capacity;
+		uint32_t count;
+		// [PARTICLE_ARRAYS] arrays of [capacity] floats in one allocation.
+		float* data;
+		float* px;
+		float* py;
+		float* vx;
+		float* vy;
+		// Seconds left to live, and 1 / the seconds lived in total.
+		float* life;
+		float* invLife;
+		float* rotation;
+		float* spin;
+
+		float x;
+		float y;
+		// Particles spawned per second, and the fraction of one owed.
+		float rate;
+		float rateDebt;
+		float lifeMin, lifeMax;
+		float angle, spread;
+		float speedMin, speedMax;
+		float gravityX, gravityY;
+		float drag;
+		float rotationMin, rotationMax;
+		float spinMin, spinMax;
+		int spawnShape;
+		float spawnWidth, spawnHeight;
+
+		uint32_t colorCurve[PARTICLE_CURVE_SIZE];
+		float sizeCurve[PARTICLE_CURVE_SIZE];
+
+		uint32_t random;
+	} ParticleEmitter;
+
+	static uint32_t particleEmitterSeed = 1;
+
+	// xorshift32, in [0, 1).
+	float particleRandom(ParticleEmitter* pe) {
+		uint32_t x = pe->random;
+		x ^= x << 13;
+		x ^= x >> 17;
+		x ^= x << 5;
+		pe->random = x;
+		return (x >> 8) * (1.0f / 16777216.0f);
+	}
+
+	float particleRandomRange(ParticleEmitter* pe, float a, float b) {
+		return a + (b - a) * particleRandom(pe);
+	}
+
+	// Adds up to [n] particles, returning how many were added.
+	uint32_t particleEmitterSpawn(ParticleEmitter* pe, uint32_t n) {
+		if (n > pe->capacity - pe->count) n = pe->capacity - pe->count;
+
+		for (uint32_t k = 0; k < n; k++) {
+			uint32_t i = pe->count++;
+			float x = pe->x;
+			float y = pe->y;
+
+			if (pe->spawnShape == PARTICLE_SPAWN_CIRCLE) {
+				// sqrt spreads them evenly over the area.
+				float r = pe->spawnWidth * sqrtf(particleRandom(pe));
+				float a = (float)TAU * particleRandom(pe);
+				x += r * cosf(a);
+				y += r * sinf(a);
+			} else if (pe->spawnShape == PARTICLE_SPAWN_RECT) {
+				x += (particleRandom(pe) - 0.5f) * pe->spawnWidth;
+				y += (particleRandom(pe) - 0.5f) * pe->spawnHeight;
+			}
+
+			float a = pe->angle + (particleRandom(pe) - 0.5f) * pe->spread;
+			float speed = particleRandomRange(pe, pe->speedMin, pe->speedMax);
+			float life = particleRandomRange(pe, pe->lifeMin, pe->lifeMax);
+
+			pe->px[i] = x;
+			pe->py[i] = y;
+			pe->vx[i] = speed * cosf(a);
+			pe->vy[i] = speed * sinf(a);
+			pe->life[i] = life;
+			pe->invLife[i] = life > 0 ? 1.0f / life : 0;
+			pe->rotation[i] = particleRandomRange(pe, pe->rotationMin, pe->rotationMax);
+			pe->spin[i] = particleRandomRange(pe, pe->spinMin, pe->spinMax);
+		}
+
+		return n;
+	}
+
+	// Moves the particles [dt] seconds on, removes the dead, and spawns new ones at [rate].
+	void particleEmitterUpdate(ParticleEmitter* pe, float dt) {
+		float drag = 1.0f / (1.0f + pe->drag * dt);
+		float gx = pe->gravityX * dt;
+		float gy = pe->gravityY * dt;
+
+		// Capacity is a multiple of 4, so the last group can run past [count].
+		uint32_t n = (pe->count + 3) & ~3U;
+		uint32_t i = 0;
+
+		#ifdef SOCK_SSE2
+			__m128 vdt = _mm_set1_ps(dt);
+			__m128 vdrag = _mm_set1_ps(drag);
+			__m128 vgx = _mm_set1_ps(gx);
+			__m128 vgy = _mm_set1_ps(gy);
+
+			for ( ; i < n; i += 4) {
+				__m128 vx = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(pe->vx + i), vdrag), vgx);
+				__m128 vy = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(pe->vy + i), vdrag), vgy);
+				_mm_storeu_ps(pe->vx + i, vx);
+				_mm_storeu_ps(pe->vy + i, vy);
+				_mm_storeu_ps(pe->px + i, _mm_add_ps(_mm_loadu_ps(pe->px + i), _mm_mul_ps(vx, vdt)));
+				_mm_storeu_ps(pe->py + i, _mm_add_ps(_mm_loadu_ps(pe->py + i), _mm_mul_ps(vy, vdt)));
+				_mm_storeu_ps(pe->life + i, _mm_sub_ps(_mm_loadu_ps(pe->life + i), vdt));
+				_mm_storeu_ps(pe->rotation + i, _mm_add_ps(_mm_loadu_ps(pe->rotation + i), _mm_mul_ps(_mm_loadu_ps(pe->spin + i), vdt)));
+			}
+		#endif
+
+		for ( ; i < n; i++) {
+			pe->vx[i] = pe->vx[i] * drag + gx;
+			pe->vy[i] = pe->vy[i] * drag + gy;
+			pe->px[i] += pe->vx[i] * dt;
+			pe->py[i] += pe->vy[i] * dt;
+			pe->life[i] -= dt;
+			pe->rotation[i] += pe->spin[i] * dt;
 		}
 
-		if (arrayLength >= (int64_t)UINT32_MAX) {
-			free(data);
-			wrenAbort(vm, "Buffer cannot hold more than ~4GB");
-			return;
+		// Remove the dead by moving the last particle into their place.
+		for (i = 0; i < pe->count; ) {
+			if (pe->life[i] > 0) {
+				i++;
+				continue;
+			}
+
+			uint32_t last = --pe->count;
+			for (int a = 0; a < PARTICLE_ARRAYS; a++) {
+				float* array = pe->data + a * pe->capacity;
+				array[i] = array[last];
+			}
 		}
 
-		// Save to new buffer.
-		Buffer* buffer = (Buffer*)wrenSetSlotNewForeign(vm, 0, 0, sizeof(Buffer));
-		buffer->length = (uint32_t)arrayLength;
-		buffer->data = data;
+		pe->rateDebt += pe->rate * dt;
+		if (pe->rateDebt >= 1) {
+			uint32_t owed = pe->rateDebt < (float)pe->capacity ? (uint32_t)pe->rateDebt : pe->capacity;
+			pe->rateDebt -= owed;
+
+			// Don't bank particles while full.
+			if (particleEmitterSpawn(pe, owed) < owed) pe->rateDebt = 0;
+		}
 	}
 
-	// ASSET
+	// Writes the particles into the render queue as sprites of [spr], centered on their position.
+	void particleEmitterDraw(ParticleEmitter* pe, Sprite* spr) {
+		if (pe->count == 0) return;
 
-	void wren_Asset_exists(WrenVM* vm) {
-		if (wrenGetSlotType(vm, 1) != WREN_TYPE_STRING) {
-			wrenAbort(vm, "path must be a string");
-			return;
-		}
+		SpriteBatcher* sb = renderQueueBeginSprites();
+		if (!spriteBatcherCheckResize(sb, pe->count)) return;
 
-		const char* path = wrenGetSlotString(vm, 1);
-		char* fileName = resolveAssetPath(path);
+		float w = (float)spr->texture.width;
+		float h = (float)spr->texture.height;
+		float u1 = spr->uv[0];
+		float v1 = spr->uv[1];
+		float u2 = u1 + spr->uv[2];
+		float v2 = v1 + spr->uv[3];
 
-		if (fileName) {
-			wrenSetSlotBool(vm, 0, fileExists(fileName));
+		// Skip the trig if nothing rotates.
+		bool rotates = pe->rotationMin != 0 || pe->rotationMax != 0 || pe->spinMin != 0 || pe->spinMax != 0;
 
-			free(fileName);
-		} else {
-			wrenAbort(vm, quitError);
-		}
-	}
+		for (uint32_t i = 0; i < pe->count; i++) {
+			float t = 1.0f - pe->life[i] * pe->invLife[i];
+			int curve = (int)(t * (PARTICLE_CURVE_SIZE - 1) + 0.5f);
+			if (curve < 0) curve = 0;
+			if (curve > PARTICLE_CURVE_SIZE - 1) curve = PARTICLE_CURVE_SIZE - 1;
 
-	void wren_Asset_loadString(WrenVM* vm) {
-		if (wrenGetSlotType(vm, 1) != WREN_TYPE_STRING) {
-			wrenAbort(vm, "path must be a string");
-			return;
-		}
+			float size = pe->sizeCurve[curve];
+			float ax = w * size, ay = 0;
+			float bx = 0, by = h * size;
 
-		const char* path = wrenGetSlotString(vm, 1);
+			if (rotates) {
+				float c = cosf(pe->rotation[i]);
+				float s = sinf(pe->rotation[i]);
+				ay = ax * s;
+				ax = ax * c;
+				bx = -by * s;
+				by = by * c;
+			}
 
-		// Load from asset.
-		int64_t strLength;
-		char* str = readAsset(path, &strLength);
-		if (!str) {
-			wrenAbort(vm, quitError);
-			quitError = NULL;
-			return;
+			float x = pe->px[i] - (ax + bx) * 0.5f;
+			float y = pe->py[i] - (ay + by) * 0.5f;
+
+			if (renderCullQuad(x, y, x + ax, y + ay, x + bx, y + by, x + ax + bx, y + ay + by)) continue;
+
+			spriteBatcherAddInstance(sb, x, y, ax, ay, bx, by, pe->colorCurve[curve], u1, v1, u2, v2);
 		}
 
-		wrenSetSlotBytes(vm, 0, str, strLength);
-	}
-	
-	void wren_Asset_loadBundle(WrenVM* vm) {
-		// TODO
+		renderQueueEndSprites(spr->texture.id);
 	}
 
-	// CAMERA
-
-	void setCameraOrigin(float x, float y, float* tf) {
-		float sx =  2.0f / game_resolutionWidth;
-		float sy = -2.0f / game_resolutionHeight;
+	// Reads a List of Nums in [slot] into a curve of [PARTICLE_CURVE_SIZE] entries, keys spaced evenly over
+	// life and interpolated linearly. Colors are interpolated per channel.
+	// Returns false and aborts if the List is invalid.
+	bool wren_getParticleCurve(WrenVM* vm, int slot, bool colors, uint32_t* colorCurve, float* sizeCurve) {
+		if (wrenGetSlotType(vm, slot) != WREN_TYPE_LIST || wrenGetListCount(vm, slot) == 0) {
+			wrenAbort(vm, "curve must be a non-empty List");
+			return false;
+		}
 
-		if (tf) {
-			cameraMatrix[0] = sx * tf[0];
-			cameraMatrix[1] = sy * tf[1];
-			cameraMatrix[2] = 0;
-			
-			cameraMatrix[3] = sx * tf[2];
-			cameraMatrix[4] = sy * tf[3];
-			cameraMatrix[5] = 0;
-		
-			cameraMatrix[6] = x * sx - 1.0f + sx * tf[4];
-			cameraMatrix[7] = y * sy + 1.0f + sy * tf[5];
-			cameraMatrix[8] = 1.0f;
-		} else {
-			cameraMatrix[0] = sx;
-			cameraMatrix[1] = 0;
-			cameraMatrix[2] = 0;
-			
-			cameraMatrix[3] = 0;
-			cameraMatrix[4] = sy;
-			cameraMatrix[5] = 0;
-		
-			cameraMatrix[6] = x * sx - 1.0f;
-			cameraMatrix[7] = y * sy + 1.0f;
-			cameraMatrix[8] = 1.0f;
+		int count = wrenGetListCount(vm, slot);
+		if (count > PARTICLE_CURVE_SIZE) {
+			wrenAbort(vm, "curve has too many keys");
+			return false;
 		}
-	}
 
-	void cameraLookAt(float x, float y, float* tf) {
-		float sx =  2.0f / game_resolutionWidth;
-		float sy = -2.0f / game_resolutionHeight;
+		double keys[PARTICLE_CURVE_SIZE];
+		wrenEnsureSlots(vm, slot + 2);
 
-		// If dimensions are not even, need shift origin by half a pixel.
-		float dx = game_resolutionWidth  % 2 == 0 ? 0.0f : 0.5f;
-		float dy = game_resolutionHeight % 2 == 0 ? 0.0f : 0.5f;
+		for (int i = 0; i < count; i++) {
+			wrenGetListElement(vm, slot, i, slot + 1);
+			if (wrenGetSlotType(vm, slot + 1) != WREN_TYPE_NUM) {
+				wrenAbort(vm, "curve keys must be Nums");
+				return false;
+			}
+			keys[i] = wrenGetSlotDouble(vm, slot + 1);
 
-		if (tf) {
-			cameraMatrix[0] = sx * tf[0];
-			cameraMatrix[1] = sy * tf[1];
-			cameraMatrix[2] = 0;
-			
-			cameraMatrix[3] = sx * tf[2];
-			cameraMatrix[4] = sy * tf[3];
-			cameraMatrix[5] = 0;
+			// Casting a color outside the uint32 range is undefined.
+			if (colors) keys[i] = fmin(fmax(keys[i], 0), UINT32_MAX);
+		}
 
-			cameraMatrix[6] = sx * (tf[4] - tf[0] * x - tf[2] * y + dx);
-			cameraMatrix[7] = sy * (tf[5] - tf[1] * x - tf[3] * y + dy);
-			cameraMatrix[8] = 1.0f;
-		} else {
-			cameraMatrix[0] = sx;
-			cameraMatrix[1] = 0;
-			cameraMatrix[2] = 0;
-			
-			cameraMatrix[3] = 0;
-			cameraMatrix[4] = sy;
-			cameraMatrix[5] = 0;
+		for (int i = 0; i < PARTICLE_CURVE_SIZE; i++) {
+			float k = count == 1 ? 0 : (float)i * (count - 1) / (PARTICLE_CURVE_SIZE - 1);
+			int a = (int)k;
+			int b = a + 1 < count ? a + 1 : a;
+			float t = k - a;
 
-			cameraMatrix[6] = (dx - x) * sx;
-			cameraMatrix[7] = (dy - y) * sy;
-			cameraMatrix[8] = 1.0f;
+			if (colors) {
+				uint32_t ca = (uint32_t)keys[a];
+				uint32_t cb = (uint32_t)keys[b];
+				uint32_t c = 0;
+
+				for (int shift = 0; shift < 32; shift += 8) {
+					float ea = (float)((ca >> shift) & 0xff);
+					float eb = (float)((cb >> shift) & 0xff);
+					c |= (uint32_t)(ea + (eb - ea) * t + 0.5f) << shift;
+				}
+
+				colorCurve[i] = c;
+			} else {
+				sizeCurve[i] = (float)(keys[a] + (keys[b] - keys[a]) * t);
+			}
 		}
+
+		return true;
 	}
 
-	void wren_Camera_setter(WrenVM* vm, int type) {
-		if (wrenGetSlotType(vm, 1) != WREN_TYPE_NUM || wrenGetSlotType(vm, 2) != WREN_TYPE_NUM) {
-			wrenAbort(vm, "x/y must be Num");
+	void wren_particleEmitterAllocate(WrenVM* vm) {
+		ParticleEmitter* pe = (ParticleEmitter*)wrenSetSlotNewForeign(vm, 0, 0, sizeof(ParticleEmitter));
+		memset(pe, 0, sizeof(ParticleEmitter));
+
+		if (wrenGetSlotType(vm, 1) != WREN_TYPE_NUM) {
+			wrenAbort(vm, "capacity must be a Num");
 			return;
 		}
 
-		float x = (float)wrenGetSlotDouble(vm, 1);
-		float y = (float)wrenGetSlotDouble(vm, 2);
-		
-		float* tf = NULL;
-		if (wrenGetSlotType(vm, 3) != WREN_TYPE_NULL) {
-			transform_putClassHandle(vm);
-			if (!wrenGetSlotIsInstanceOf(vm, 3, 0)) {
-				wrenAbort(vm, "transform must be Transform");
-				return;
-			}
+		double capacity = wrenGetSlotDouble(vm, 1);
+		if (capacity < 1 || capacity > BATCHER_MAX_CAPACITY || capacity != trunc(capacity)) {
+			wrenAbort(vm, "capacity must be a positive integer");
+			return;
+		}
 
-			tf = (float*)wrenGetSlotForeign(vm, 3);
+		// A multiple of 4, for SSE.
+		pe->capacity = ((uint32_t)capacity + 3) & ~3U;
+		pe->data = (float*)malloc((size_t)pe->capacity * PARTICLE_ARRAYS * sizeof(float));
+		if (!pe->data) {
+			pe->capacity = 0;
+			wrenAbort(vm, "out of memory");
+			return;
 		}
 
-		if (!tf) {
-			x = floorf(x);
-			y = floorf(y);
+		// Slack past [count] is integrated too, so keep it finite.
+		memset(pe->data, 0, (size_t)pe->capacity * PARTICLE_ARRAYS * sizeof(float));
+
+		float** arrays[PARTICLE_ARRAYS] = { &pe->px, &pe->py, &pe->vx, &pe->vy, &pe->life, &pe->invLife, &pe->rotation, &pe->spin };
+		for (int a = 0; a < PARTICLE_ARRAYS; a++) {
+			*arrays[a] = pe->data + a * pe->capacity;
 		}
-		
-		if (type == 0) {
-			setCameraOrigin(x, y, tf);
-		} else {
-			cameraLookAt(x, y, tf);
+
+		pe->lifeMin = pe->lifeMax = 1;
+		pe->spread = (float)TAU;
+		pe->speedMin = pe->speedMax = 50;
+
+		for (int i = 0; i < PARTICLE_CURVE_SIZE; i++) {
+			pe->colorCurve[i] = 0xffffffffU;
+			pe->sizeCurve[i] = 1;
 		}
-	}
 
-	void wren_Camera_setOrigin(WrenVM* vm) {
-		wren_Camera_setter(vm, 0);
-	}
-	
-	void wren_Camera_lookAt(WrenVM* vm) {
-		wren_Camera_setter(vm, 1);
+		pe->random = 0x9e3779b9U * particleEmitterSeed++;
+		if (pe->random == 0) pe->random = 1;
 	}
 
-	void wren_Camera_reset(WrenVM* vm) {
-		setCameraOrigin(0, 0, NULL);
+	void wren_particleEmitterFinalize(void* data) {
+		ParticleEmitter* pe = (ParticleEmitter*)data;
+		free(pe->data);
 	}
 
-	float* getCameraMatrix() {
-		if (isnan(cameraMatrix[0])) {
-			setCameraOrigin(0, 0, NULL);
+	// Gets [count] Nums from slot 1 on into [values].
+	bool wren_getParticleArgs(WrenVM* vm, int count, float* values) {
+		for (int i = 0; i < count; i++) {
+			if (wrenGetSlotType(vm, i + 1) != WREN_TYPE_NUM) {
+				wrenAbort(vm, "args must be Nums");
+				return false;
+			}
+			values[i] = (float)wrenGetSlotDouble(vm, i + 1);
 		}
 
-		return cameraMatrix;
+		return true;
 	}
 
-	// SPRITE
-
-	Sprite* spriteAllocate(WrenVM* vm) {
-		Sprite* spr = (Sprite*)wrenSetSlotNewForeign(vm, 0, 0, sizeof(Sprite));
-		
-		spr->texture.width = 0;
-		spr->texture.height = 0;
-		spr->texture.filter = defaultSpriteFilter;
-		spr->texture.wrap = defaultSpriteWrap;
-		spr->texture.id = 0;
-		spr->transform.matrix[0] = NAN;
-		spr->transform.matrix[1] = 0.0f;
-		spr->transform.matrix[2] = 0.0f;
-		spr->transform.matrix[3] = 0.0f;
-		spr->transform.matrix[4] = 0.0f;
-		spr->transform.matrix[5] = 0.0f;
-		spr->transform.originX = NAN;
-		spr->transform.originY = 0.0f;
-		spr->path = NULL;
-		spr->color = 0xffffffff;
-
-		return spr;
+	void wren_particles_count(WrenVM* vm) {
+		ParticleEmitter* pe = (ParticleEmitter*)wrenGetSlotForeign(vm, 0);
+		wrenSetSlotDouble(vm, 0, pe->count);
 	}
 
-	void wren_spriteAllocate(WrenVM* vm) {
-		spriteAllocate(vm);
+	void wren_particles_capacity(WrenVM* vm) {
+		ParticleEmitter* pe = (ParticleEmitter*)wrenGetSlotForeign(vm, 0);
+		wrenSetSlotDouble(vm, 0, pe->capacity);
 	}
 
-	void wren_spriteFinalize(void* data) {
-		Sprite* spr = (Sprite*)data;
-		
-		// glDeleteTextures silently ignores 0's.
-		glDeleteTextures(1, &spr->texture.id);
-
-		if (spr->path) {
-			free(spr->path);
-		}
-	}
+	void wren_particles_setPosition(WrenVM* vm) {
+		ParticleEmitter* pe = (ParticleEmitter*)wrenGetSlotForeign(vm, 0);
+		float v[2];
+		if (!wren_getParticleArgs(vm, 2, v)) return;
 
-	void wren_sprite_width(WrenVM* vm) {
-		Sprite* spr = (Sprite*)wrenGetSlotForeign(vm, 0);
-		wrenSetSlotDouble(vm, 0, spr->texture.width);
-	}
-	
-	void wren_sprite_height(WrenVM* vm) {
-		Sprite* spr = (Sprite*)wrenGetSlotForeign(vm, 0);
-		wrenSetSlotDouble(vm, 0, spr->texture.height);
+		pe->x = v[0];
+		pe->y = v[1];
 	}
 
-	void wren_Sprite_load(WrenVM* vm) {
-		if (wrenGetSlotType(vm, 1) != WREN_TYPE_STRING) {
-			wrenAbort(vm, "path must be a string");
-			return;
-		}
+	void wren_particles_rate_set(WrenVM* vm) {
+		ParticleEmitter* pe = (ParticleEmitter*)wrenGetSlotForeign(vm, 0);
+		float v[1];
+		if (!wren_getParticleArgs(vm, 1, v)) return;
 
-		const char* path = wrenGetSlotString(vm, 1);
+		pe->rate = v[0] > 0 ? v[0] : 0;
+	}
 
-		// Load from file.
-		int64_t imgSize;
-		char* img = readAsset(path, &imgSize);
-		if (!img) {
-			wrenAbort(vm, quitError);
-			quitError = NULL;
-			return;
-		}
+	void wren_particles_setLife(WrenVM* vm) {
+		ParticleEmitter* pe = (ParticleEmitter*)wrenGetSlotForeign(vm, 0);
+		float v[2];
+		if (!wren_getParticleArgs(vm, 2, v)) return;
 
-		int width, height, channelCount;
-		stbi_uc* data = stbi_load_from_memory(img, (int)imgSize, &width, &height, &channelCount, 4);
-		
-		free(img);
+		pe->lifeMin = v[0];
+		pe->lifeMax = v[1];
+	}
 
-		if (!data) {
-			wrenAbort(vm, stbi_failure_reason());
-			return;
-		}
+	void wren_particles_setVelocity(WrenVM* vm) {
+		ParticleEmitter* pe = (ParticleEmitter*)wrenGetSlotForeign(vm, 0);
+		float v[4];
+		if (!wren_getParticleArgs(vm, 4, v)) return;
 
-		// Load into WebGL texture.
-		GLuint id;
-		glGenTextures(1, &id);
-		glBindTexture(GL_TEXTURE_2D, id);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, defaultSpriteWrap);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, defaultSpriteWrap);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, defaultSpriteFilter);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, defaultSpriteFilter);
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
+		pe->angle = v[0];
+		pe->spread = v[1];
+		pe->speedMin = v[2];
+		pe->speedMax = v[3];
+	}
 
-		stbi_image_free(data);
+	void wren_particles_setGravity(WrenVM* vm) {
+		ParticleEmitter* pe = (ParticleEmitter*)wrenGetSlotForeign(vm, 0);
+		float v[2];
+		if (!wren_getParticleArgs(vm, 2, v)) return;
 
-		// Save to new Sprite.
-		Sprite* spr = spriteAllocate(vm);
-		spr->texture.width = width;
-		spr->texture.height = height;
-		spr->texture.id = id;
-		spr->path = _strdup(path);
+		pe->gravityX = v[0];
+		pe->gravityY = v[1];
 	}
 
-	void wren_sprite_scaleFilter(WrenVM* vm) {
-		Sprite* spr = (Sprite*)wrenGetSlotForeign(vm, 0);
-		wrenSetSlotString(vm, 0, glFilterEnumToString(spr->texture.filter));
-	}
-	
-	void wren_sprite_scaleFilter_set(WrenVM* vm) {
-		GLuint filter = wren_filterStringToGlEnum(vm, 1);
+	void wren_particles_drag_set(WrenVM* vm) {
+		ParticleEmitter* pe = (ParticleEmitter*)wrenGetSlotForeign(vm, 0);
+		float v[1];
+		if (!wren_getParticleArgs(vm, 1, v)) return;
 
-		if (filter != 0) {
-			Sprite* spr = (Sprite*)wrenGetSlotForeign(vm, 0);
+		pe->drag = v[0] > 0 ? v[0] : 0;
+	}
 
-			if (filter != spr->texture.filter) {
-				spr->texture.filter = filter;
+	void wren_particles_setRotation(WrenVM* vm) {
+		ParticleEmitter* pe = (ParticleEmitter*)wrenGetSlotForeign(vm, 0);
+		float v[2];
+		if (!wren_getParticleArgs(vm, 2, v)) return;
 
-				if (spr->texture.id != 0) {
-					glBindTexture(GL_TEXTURE_2D, spr->texture.id);
-					glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter);
-					glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filter);
-				}
-			}
-		}
-	}
-	
-	void wren_sprite_wrapMode(WrenVM* vm) {
-		Sprite* spr = (Sprite*)wrenGetSlotForeign(vm, 0);
-		wrenSetSlotString(vm, 0, glWrapEnumToString(spr->texture.wrap));
+		pe->rotationMin = v[0];
+		pe->rotationMax = v[1];
 	}
-	
-	void wren_sprite_wrapMode_set(WrenVM* vm) {
-		GLuint wrap = wren_wrapStringToGlEnum(vm, 1);
-		
-		if (wrap != 0) {
-			Sprite* spr = (Sprite*)wrenGetSlotForeign(vm, 0);
-			spr->texture.wrap = wrap;
 
-			if (spr->texture.id != 0) {
-				glBindTexture(GL_TEXTURE_2D, spr->texture.id);
-				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, wrap);
-				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, wrap);
-			}
-		}
+	void wren_particles_setSpin(WrenVM* vm) {
+		ParticleEmitter* pe = (ParticleEmitter*)wrenGetSlotForeign(vm, 0);
+		float v[2];
+		if (!wren_getParticleArgs(vm, 2, v)) return;
+
+		pe->spinMin = v[0];
+		pe->spinMax = v[1];
 	}
-	
-	void wren_sprite_beginBatch(WrenVM* vm) {
-		Sprite* spr = (Sprite*)wrenGetSlotForeign(vm, 0);
-		
-		if (spr->batcher) {
-			wrenAbort(vm, "batch already started");
-		} else {
-			spr->batcher = spriteBatcherGet();
-			spriteBatcherBegin(spr->batcher);
-		}
+
+	void wren_particles_colors_set(WrenVM* vm) {
+		ParticleEmitter* pe = (ParticleEmitter*)wrenGetSlotForeign(vm, 0);
+		wren_getParticleCurve(vm, 1, true, pe->colorCurve, NULL);
 	}
-	
-	void wren_sprite_endBatch(WrenVM* vm) {
-		Sprite* spr = (Sprite*)wrenGetSlotForeign(vm, 0);
-		
-		if (spr->batcher) {
-			spriteBatcherEnd(spr->batcher, spr->texture.id);
-			spriteBatcherPut(spr->batcher);
-			spr->batcher = NULL;
-		} else {
-			wrenAbort(vm, "batch not yet started");
-		}
+
+	void wren_particles_sizes_set(WrenVM* vm) {
+		ParticleEmitter* pe = (ParticleEmitter*)wrenGetSlotForeign(vm, 0);
+		wren_getParticleCurve(vm, 1, false, NULL, pe->sizeCurve);
 	}
 
-	void wren_sprite_color(WrenVM* vm) {
-		Sprite* spr = (Sprite*)wrenGetSlotForeign(vm, 0);
+	void wren_particles_spawnPoint(WrenVM* vm) {
+		ParticleEmitter* pe = (ParticleEmitter*)wrenGetSlotForeign(vm, 0);
+		pe->spawnShape = PARTICLE_SPAWN_POINT;
+	}
 
-		wrenSetSlotDouble(vm, 0, spr->color);
+	void wren_particles_spawnCircle(WrenVM* vm) {
+		ParticleEmitter* pe = (ParticleEmitter*)wrenGetSlotForeign(vm, 0);
+		float v[1];
+		if (!wren_getParticleArgs(vm, 1, v)) return;
+
+		pe->spawnShape = PARTICLE_SPAWN_CIRCLE;
+		pe->spawnWidth = v[0];
 	}
-	
-	void wren_sprite_color_set(WrenVM* vm) {
-		Sprite* spr = (Sprite*)wrenGetSlotForeign(vm, 0);
 
-		if (wrenGetSlotType(vm, 1) == WREN_TYPE_NUM) {
-			spr->color = (uint32_t)wrenGetSlotDouble(vm, 1);
-		} else {
-			wrenAbort(vm, "color must be Num");
-		}
+	void wren_particles_spawnRect(WrenVM* vm) {
+		ParticleEmitter* pe = (ParticleEmitter*)wrenGetSlotForeign(vm, 0);
+		float v[2];
+		if (!wren_getParticleArgs(vm, 2, v)) return;
+
+		pe->spawnShape = PARTICLE_SPAWN_RECT;
+		pe->spawnWidth = v[0];
+		pe->spawnHeight = v[1];
 	}
 
-	void wren_sprite_transform(WrenVM* vm) {
-		Sprite* spr = (Sprite*)wrenGetSlotForeign(vm, 0);
+	void wren_particles_emit(WrenVM* vm) {
+		ParticleEmitter* pe = (ParticleEmitter*)wrenGetSlotForeign(vm, 0);
+		float v[1];
+		if (!wren_getParticleArgs(vm, 1, v)) return;
 
-		if (isnan(spr->transform.matrix[0])) {
-			wrenSetSlotNull(vm, 0);
-		} else {
-			transform_putClassHandle(vm);
+		wrenSetSlotDouble(vm, 0, v[0] >= 1 ? particleEmitterSpawn(pe, v[0] < pe->capacity ? (uint32_t)v[0] : pe->capacity) : 0);
+	}
 
-			float* t = (float*)wrenSetSlotNewForeign(vm, 0, 0, TRANSFORM_SIZE);
+	void wren_particles_update(WrenVM* vm) {
+		ParticleEmitter* pe = (ParticleEmitter*)wrenGetSlotForeign(vm, 0);
+		float v[1];
+		if (!wren_getParticleArgs(vm, 1, v)) return;
 
-			for (int i = 0; i < 6; i++) {
-				t[i] = spr->transform.matrix[i];
-			}
-		}
+		if (v[0] > 0) particleEmitterUpdate(pe, v[0]);
 	}
-	
-	void wren_sprite_transform_set(WrenVM* vm) {
-		Sprite* spr = (Sprite*)wrenGetSlotForeign(vm, 0);
 
-		if (wrenGetSlotType(vm, 1) == WREN_TYPE_NULL) {
-			spr->transform.matrix[0] = NAN;
-		} else {
-			transform_putClassHandle(vm);
+	void wren_particles_draw(WrenVM* vm) {
+		ParticleEmitter* pe = (ParticleEmitter*)wrenGetSlotForeign(vm, 0);
+		particleEmitterDraw(pe, (Sprite*)wrenGetSlotForeign(vm, 1));
+	}
 
-			if (wrenGetSlotIsInstanceOf(vm, 1, 0)) {
-				float* t = (float*)wrenGetSlotForeign(vm, 1);
+	void wren_particles_clear(WrenVM* vm) {
+		ParticleEmitter* pe = (ParticleEmitter*)wrenGetSlotForeign(vm, 0);
+		pe->count = 0;
+		pe->rateDebt = 0;
+	}
 
-				for (int i = 0; i < 6; i++) {
-					spr->transform.matrix[i] = t[i];
-				}
-			} else {
-				wrenAbort(vm, "transform must be a Transform");
-				return;
-			}
-		}
+	// TEXT
 
-		spr->transform.originX = 0;
-		spr->transform.originY = 0;
+	void wren_fontAllocate(WrenVM* vm) {
+		Font** font = (Font**)wrenSetSlotNewForeign(vm, 0, 0, sizeof(Font*));
+		*font = NULL;
 	}
-	
-	void wren_sprite_setTransform(WrenVM* vm) {
-		if (wrenGetSlotType(vm, 1) != WREN_TYPE_NUM || wrenGetSlotType(vm, 2) != WREN_TYPE_NUM) {
-			wrenAbort(vm, "x/y must be Nums");
-			return;
-		}
 
-		Sprite* spr = (Sprite*)wrenGetSlotForeign(vm, 0);
-		float x = (float)wrenGetSlotDouble(vm, 1);
-		float y = (float)wrenGetSlotDouble(vm, 2);
+	void wren_Font_load(WrenVM* vm) {
+		if (wrenEnsureArgString(vm, 1, "path")) return;
 
-		transform_putClassHandle(vm);
-		if (wrenGetSlotIsInstanceOf(vm, 3, 0)) {
-			spr->transform.originX = x;
-			spr->transform.originY = y;
+		Font* font = fontLoad(vm, wrenGetSlotString(vm, 1));
+		if (font) *(Font**)wrenSetSlotNewForeign(vm, 0, 0, sizeof(Font*)) = font;
+	}
 
-			float* t = (float*)wrenGetSlotForeign(vm, 3);
+	void wren_Font_system_(WrenVM* vm) {
+		Font* font = fontGetSystem();
+		if (font) *(Font**)wrenSetSlotNewForeign(vm, 0, 0, sizeof(Font*)) = font;
+	}
 
-			for (int i = 0; i < 6; i++) {
-				spr->transform.matrix[i] = t[i];
-			}
-		} else {
-			wrenAbort(vm, "transform must be a Transform");
-		}
+	void wren_font_lineHeight(WrenVM* vm) {
+		Font* font = *(Font**)wrenGetSlotForeign(vm, 0);
+		wrenSetSlotDouble(vm, 0, font->lineHeight);
 	}
 
-	void wren_sprite_draw_4(WrenVM* vm) {
-		for (int i = 1; i <= 4; i++) {
-			if (wrenGetSlotType(vm, i) != WREN_TYPE_NUM) {
-				wrenAbort(vm, "args must be numbers");
-				return;
-			}
-		}
+	void wren_textAllocate(WrenVM* vm) {
+		Text* text = (Text*)wrenSetSlotNewForeign(vm, 0, 0, sizeof(Text));
+		memset(text, 0, sizeof(Text));
 
-		Sprite* spr = (Sprite*)wrenGetSlotForeign(vm, 0);
-		float x1 = (float)wrenGetSlotDouble(vm, 1);
-		float y1 = (float)wrenGetSlotDouble(vm, 2);
-		float x2 = x1 + (float)wrenGetSlotDouble(vm, 3);
-		float y2 = y1 + (float)wrenGetSlotDouble(vm, 4);
+		// The Text wrapper checks the Font and String.
+		text->font = *(Font**)wrenGetSlotForeign(vm, 1);
+		text->string = _strdup(wrenGetSlotString(vm, 2));
+		text->color = 0xffffffffU;
+		text->dirty = true;
+		text->glyphs = spriteBatcherGet();
+		text->pageCounts = (uint32_t*)calloc(text->font->pageCount, sizeof(uint32_t));
 
-		SpriteBatcher* sb = spr->batcher;
-		if (!sb) {
-			sb = spriteBatcherTemp();
-			spriteBatcherBegin(sb);
+		if (!text->string || !text->glyphs || !text->pageCounts) {
+			wrenAbort(vm, "out of memory");
 		}
+	}
 
-		spriteBatcherDrawRect(sb, x1, y1, x2, y2, 0, 0, 0, 1, 1, spr->color, isnan(spr->transform.matrix[0]) ? NULL : &spr->transform);
+	void wren_textFinalize(void* data) {
+		Text* text = (Text*)data;
 
-		if (!spr->batcher) spriteBatcherEnd(sb, spr->texture.id);
+		free(text->string);
+		free(text->pageCounts);
+		if (text->glyphs) spriteBatcherPut(text->glyphs);
 	}
-	
-	void wren_sprite_draw_8(WrenVM* vm) {
-		for (int i = 1; i <= 9; i++) {
-			if (wrenGetSlotType(vm, i) != WREN_TYPE_NUM) {
-				wrenAbort(vm, "args must be numbers");
-				return;
-			}
+
+	// Lays out [text] if it has changed.
+	// Returns false on error, aborting the current fiber.
+	bool wren_textLayout(WrenVM* vm, Text* text) {
+		if (text->dirty && !textLayout(text)) {
+			text->dirty = true;
+			wrenAbort(vm, "out of memory");
+			return false;
 		}
 
-		Sprite* spr = (Sprite*)wrenGetSlotForeign(vm, 0);
-		float x1 = (float)wrenGetSlotDouble(vm, 1);
-		float y1 = (float)wrenGetSlotDouble(vm, 2);
-		float x2 = x1 + (float)wrenGetSlotDouble(vm, 3);
-		float y2 = y1 + (float)wrenGetSlotDouble(vm, 4);
-		float u1 = (float)(wrenGetSlotDouble(vm, 5) / spr->texture.width);
-		float v1 = (float)(wrenGetSlotDouble(vm, 6) / spr->texture.height);
-		float u2 = u1 + (float)(wrenGetSlotDouble(vm, 7) / spr->texture.width);
-		float v2 = v1 + (float)(wrenGetSlotDouble(vm, 8) / spr->texture.height);
+		return true;
+	}
 
-		SpriteBatcher* sb = spr->batcher;
-		if (!sb) {
-			sb = spriteBatcherTemp();
-			spriteBatcherBegin(sb);
+	void wren_text_string_set(WrenVM* vm) {
+		Text* text = (Text*)wrenGetSlotForeign(vm, 0);
+		if (wrenEnsureArgString(vm, 1, "string")) return;
+
+		const char* string = wrenGetSlotString(vm, 1);
+		if (strcmp(string, text->string) == 0) return;
+
+		char* copy = _strdup(string);
+		if (!copy) {
+			wrenAbort(vm, "out of memory");
+			return;
 		}
 
-		spriteBatcherDrawRect(sb, x1, y1, x2, y2, 0, u1, v1, u2, v2, spr->color, isnan(spr->transform.matrix[0]) ? NULL : &spr->transform);
+		free(text->string);
+		text->string = copy;
+		text->dirty = true;
+	}
+
+	void wren_text_maxWidth_set(WrenVM* vm) {
+		Text* text = (Text*)wrenGetSlotForeign(vm, 0);
+		if (wrenEnsureArgNum(vm, 1, "maxWidth")) return;
+
+		float maxWidth = (float)wrenGetSlotDouble(vm, 1);
+		if (maxWidth < 0) maxWidth = 0;
 
-		if (!spr->batcher) spriteBatcherEnd(sb, spr->texture.id);
+		if (maxWidth != text->maxWidth) {
+			text->maxWidth = maxWidth;
+			text->dirty = true;
+		}
 	}
 
-	void wren_sprite_toString(WrenVM* vm) {
-		Sprite* spr = (Sprite*)wrenGetSlotForeign(vm, 0);
+	void wren_text_align_set(WrenVM* vm) {
+		Text* text = (Text*)wrenGetSlotForeign(vm, 0);
+		if (wrenEnsureArgString(vm, 1, "align")) return;
 
-		if (spr->path) {
-			wrenSetSlotString(vm, 0, spr->path);
+		const char* align = wrenGetSlotString(vm, 1);
+		int value;
+
+		if (strcmp(align, "left") == 0) {
+			value = TEXT_ALIGN_LEFT;
+		} else if (strcmp(align, "center") == 0) {
+			value = TEXT_ALIGN_CENTER;
+		} else if (strcmp(align, "right") == 0) {
+			value = TEXT_ALIGN_RIGHT;
 		} else {
-			char buffer[32];
-			snprintf(buffer, 32, "Sprite#%p", &spr);
-			wrenSetSlotString(vm, 0, buffer);
+			wrenAbort(vm, "align must be \"left\", \"center\" or \"right\"");
+			return;
+		}
+
+		if (value != text->align) {
+			text->align = value;
+			text->dirty = true;
 		}
 	}
 
-	void wren_Sprite_defaultScaleFilter(WrenVM* vm) {
-		wrenSetSlotString(vm, 0, glFilterEnumToString(defaultSpriteFilter));
+	void wren_text_color_set(WrenVM* vm) {
+		Text* text = (Text*)wrenGetSlotForeign(vm, 0);
+		if (wrenEnsureArgNum(vm, 1, "color")) return;
+
+		// Recolors the laid out glyphs in place.
+		textSetColor(text, (uint32_t)wrenGetSlotDouble(vm, 1));
 	}
-	
-	void wren_Sprite_defaultScaleFilter_set(WrenVM* vm) {
-		GLuint filter = wren_filterStringToGlEnum(vm, 1);
 
-		if (filter != 0) {
-			defaultSpriteFilter = filter;
-		}
+	void wren_text_width(WrenVM* vm) {
+		Text* text = (Text*)wrenGetSlotForeign(vm, 0);
+		if (!wren_textLayout(vm, text)) return;
+		wrenSetSlotDouble(vm, 0, text->width);
 	}
-	
-	void wren_Sprite_defaultWrapMode(WrenVM* vm) {
-		wrenSetSlotString(vm, 0, glWrapEnumToString(defaultSpriteWrap));
+
+	void wren_text_height(WrenVM* vm) {
+		Text* text = (Text*)wrenGetSlotForeign(vm, 0);
+		if (!wren_textLayout(vm, text)) return;
+		wrenSetSlotDouble(vm, 0, text->height);
 	}
-	
-	void wren_Sprite_defaultWrapMode_set(WrenVM* vm) {
-		GLuint wrap = wren_wrapStringToGlEnum(vm, 1);
-		
-		if (wrap != 0) {
-			defaultSpriteWrap = wrap;
-		}
+
+	void wren_text_draw(WrenVM* vm) {
+		Text* text = (Text*)wrenGetSlotForeign(vm, 0);
+		if (wrenEnsureArgNum(vm, 1, "x") || wrenEnsureArgNum(vm, 2, "y")) return;
+		if (!wren_textLayout(vm, text)) return;
+
+		textDraw(text, (float)wrenGetSlotDouble(vm, 1), (float)wrenGetSlotDouble(vm, 2));
 	}
 
-	// QUAD
+	// CANVAS
 
-	void wren_Quad_beginBatch(WrenVM* vm) {
-		if (quadBatcher.vertexCount == UINT32_MAX) {
-			primitiveBatcherBegin(&quadBatcher);
-		} else {
-			wrenAbort(vm, "batch already started");
+	void wren_canvasAllocate(WrenVM* vm) {
+		Canvas* canvas = (Canvas*)wrenSetSlotNewForeign(vm, 0, 0, sizeof(Canvas));
+		memset(canvas, 0, sizeof(Canvas));
+
+		if (wrenGetSlotType(vm, 1) != WREN_TYPE_NUM || wrenGetSlotType(vm, 2) != WREN_TYPE_NUM) {
+			wrenAbort(vm, "width/height must be Num");
+			return;
 		}
-	}
-	
-	void wren_Quad_endBatch(WrenVM* vm) {
-		if (quadBatcher.vertexCount == UINT32_MAX) {
-			wrenAbort(vm, "batch not yet started");
-		} else {
-			primitiveBatcherEnd(&quadBatcher, GL_TRIANGLES);
+
+		double width = wrenGetSlotDouble(vm, 1);
+		double height = wrenGetSlotDouble(vm, 2);
+
+		GLint maxSize;
+		glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxSize);
+
+		if (width < 1 || height < 1 || width > maxSize || height > maxSize || width != trunc(width) || height != trunc(height)) {
+			snprintf(printBuffer, PRINT_BUFFER_SIZE, "width/height must be integers from 1 to %d", maxSize);
+			wrenAbort(vm, printBuffer);
+			return;
 		}
-	}
 
-	void wren_Quad_draw5(WrenVM* vm) {
-		for (int i = 1; i <= 5; i++) {
-			if (wrenGetSlotType(vm, i) != WREN_TYPE_NUM) {
-				wrenAbort(vm, "args must be Nums");
-				return;
-			}
+		canvas->width = (int)width;
+		canvas->height = (int)height;
+
+		// Starts out transparent.
+		void* data = calloc((size_t)canvas->width * canvas->height, 4);
+		if (!data) {
+			wrenAbort(vm, "out of memory");
+			return;
 		}
 
-		float x = (float)wrenGetSlotDouble(vm, 1);
-		float y = (float)wrenGetSlotDouble(vm, 2);
-		float w = (float)wrenGetSlotDouble(vm, 3);
-		float h = (float)wrenGetSlotDouble(vm, 4);
-		uint32_t color = (uint32_t)wrenGetSlotDouble(vm, 5);
+		glGenTextures(1, &canvas->texture);
+		glCacheEditTexture(canvas->texture);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, defaultSpriteFilter);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, defaultSpriteFilter);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, canvas->width, canvas->height, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
+		renderStats_textureMemory += (int64_t)canvas->width * canvas->height * 4;
 
-		bool singleBatch = quadBatcher.vertexCount == UINT32_MAX;
+		free(data);
 
-		if (singleBatch) primitiveBatcherBegin(&quadBatcher);
-		
-		primitiveBatcherDrawRect(
-			&quadBatcher,
-			x, y,
-			x + w, y + h,
-			0,
-			color,
-			NULL
-		);
+		glGenFramebuffers(1, &canvas->framebuffer);
+		glBindFramebuffer(GL_FRAMEBUFFER, canvas->framebuffer);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, canvas->texture, 0);
+
+		GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+		canvasBindTarget();
 
-		if (singleBatch) primitiveBatcherEnd(&quadBatcher, GL_TRIANGLES);
+		if (status != GL_FRAMEBUFFER_COMPLETE) {
+			wrenAbort(vm, "Canvas framebuffer incomplete");
+		}
 	}
-	
-	void wren_Quad_draw9(WrenVM* vm) {
-		for (int i = 1; i <= 9; i++) {
-			if (wrenGetSlotType(vm, i) != WREN_TYPE_NUM) {
-				wrenAbort(vm, "args must be Nums");
-				return;
-			}
+
+	void wren_canvasFinalize(void* data) {
+		Canvas* canvas = (Canvas*)data;
+
+		if (canvasCurrent == canvas) canvasEnd();
+
+		// The texture is freed with the Sprite.
+		if (canvas->framebuffer != 0) glDeleteFramebuffers(1, &canvas->framebuffer);
+	}
+
+	// Creates the Sprite that owns and draws the Canvas's texture.
+	// Only called once, by the Canvas wrapper.
+	void wren_canvas_sprite_(WrenVM* vm) {
+		Canvas* canvas = (Canvas*)wrenGetSlotForeign(vm, 0);
+
+		wrenGetVariable(vm, "sock", "Sprite", 0);
+		Sprite* spr = spriteAllocate(vm);
+		spr->texture.width = canvas->width;
+		spr->texture.height = canvas->height;
+		spr->texture.wrap = GL_CLAMP_TO_EDGE;
+		spr->texture.id = canvas->texture;
+	}
+
+	void wren_canvas_begin(WrenVM* vm) {
+		Canvas* canvas = (Canvas*)wrenGetSlotForeign(vm, 0);
+
+		if (canvasCurrent) {
+			wrenAbort(vm, "already drawing to a Canvas");
+			return;
 		}
 
-		float x1 = (float)wrenGetSlotDouble(vm, 1);
-		float y1 = (float)wrenGetSlotDouble(vm, 2);
-		float x2 = (float)wrenGetSlotDouble(vm, 3);
-		float y2 = (float)wrenGetSlotDouble(vm, 4);
-		float x3 = (float)wrenGetSlotDouble(vm, 5);
-		float y3 = (float)wrenGetSlotDouble(vm, 6);
-		float x4 = (float)wrenGetSlotDouble(vm, 7);
-		float y4 = (float)wrenGetSlotDouble(vm, 8);
-		uint32_t color = (uint32_t)wrenGetSlotDouble(vm, 9);
+		if (renderQueue.recording) {
+			wrenAbort(vm, "can't draw to a Canvas while recording a StaticBatch");
+			return;
+		}
 
-		bool singleBatch = quadBatcher.vertexCount == UINT32_MAX;
+		canvasBegin(canvas);
+	}
 
-		if (singleBatch) primitiveBatcherBegin(&quadBatcher);
+	void wren_canvas_end(WrenVM* vm) {
+		Canvas* canvas = (Canvas*)wrenGetSlotForeign(vm, 0);
 
-		primitiveBatcherDrawQuad(
-			&quadBatcher,
-			x1, y1,
-			x2, y2,
-			x4, y4,
-			x3, y3,
-			0,
-			color,
-			NULL
-		);
+		if (canvasCurrent != canvas) {
+			wrenAbort(vm, "not drawing to this Canvas");
+			return;
+		}
+
+		canvasEnd();
+	}
 
-		if (singleBatch) primitiveBatcherEnd(&quadBatcher, GL_TRIANGLES);
+	void wren_canvas_isDrawing(WrenVM* vm) {
+		Canvas* canvas = (Canvas*)wrenGetSlotForeign(vm, 0);
+		wrenSetSlotBool(vm, 0, canvasCurrent == canvas);
 	}
 
 	// SCREEN
@@ -3957,17 +8611,41 @@ const char* wren_resolveModule(WrenVM* vm, const char* importer, const char* nam
 	// GAME
 
 	void resizeFramebuffer() {
-		glBindTexture(GL_TEXTURE_2D, mainFramebufferTex);
+		renderQueueFlush();
+
+		glCacheEditTexture(mainFramebufferTex);
 		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, game_resolutionWidth, game_resolutionHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
-	}
+		renderStatsFramebufferResized(game_resolutionWidth, game_resolutionHeight);
+	}
+
+	// Copies the main framebuffer into [game_renderRect] of the window.
+	// Nearest and integer scales are a glBlitFramebuffer with the scale filter, only linear filtering at
+	// fractional scales, where blit filtering is left to the driver, uses the shader pass.
+	void mainFramebufferPresent() {
+		SockIntRect r = game_renderRect;
+		bool integerScale = r.w % game_resolutionWidth == 0 && r.h % game_resolutionHeight == 0;
+
+		if (!mainFramebufferAlwaysShader && (mainFramebufferScaleFilter == GL_NEAREST || integerScale)) {
+			// Blits ignore blending, but are clipped by the scissor test, which is reset for the frame.
+			glBindFramebuffer(GL_READ_FRAMEBUFFER, mainFramebuffer);
+			glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+			glBlitFramebuffer(
+				0, 0, game_resolutionWidth, game_resolutionHeight,
+				r.x, r.y, r.x + r.w, r.y + r.h,
+				GL_COLOR_BUFFER_BIT, (GLenum)mainFramebufferScaleFilter
+			);
+			return;
+		}
 
-	void resetGlBlending() {
-		glBlendEquation(GL_FUNC_ADD);
-		glBlendFuncSeparate(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
-	}
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		glViewport(r.x, r.y, r.w, r.h);
+
+		glCacheUseProgram(shaderFramebuffer.program);
+		glCacheBindVertexArray(mainFramebufferVertexArray);
+		if (glCacheBindTexture(0, mainFramebufferTex)) renderStats.textureBinds++;
 
-	void resetGlScissor() {
-		glDisable(GL_SCISSOR_TEST);
+		glDrawArrays(GL_TRIANGLES, 0, 6);
+		renderStatsDraw(6);
 	}
 
 	void doScreenLayout() {
@@ -4044,6 +8722,57 @@ const char* wren_resolveModule(WrenVM* vm, const char* importer, const char* nam
 		}
 	}
 
+	static const char* VSYNC_ADAPTIVE = "adaptive";
+
+	void wren_Game_vsync(WrenVM* vm) {
+		if (game_swapInterval < 0) {
+			wrenSetSlotString(vm, 0, VSYNC_ADAPTIVE);
+		} else {
+			wrenSetSlotBool(vm, 0, game_swapInterval != 0);
+		}
+	}
+
+	void wren_Game_vsync_set(WrenVM* vm) {
+		WrenType argType = wrenGetSlotType(vm, 1);
+
+		if (argType == WREN_TYPE_BOOL) {
+			pacingSetSwapInterval(wrenGetSlotBool(vm, 1) ? 1 : 0);
+		} else if (argType == WREN_TYPE_STRING && strcmp(wrenGetSlotString(vm, 1), VSYNC_ADAPTIVE) == 0) {
+			pacingSetSwapInterval(-1);
+		} else {
+			wrenAbort(vm, "vsync must be Bool or \"adaptive\"");
+		}
+	}
+
+	void wren_Game_frameTimeBudget(WrenVM* vm) {
+		double period = pacingFramePeriod();
+
+		if (period > 0) {
+			wrenSetSlotDouble(vm, 0, period);
+		} else {
+			wrenSetSlotNull(vm, 0);
+		}
+	}
+
+	void wren_Game_layer(WrenVM* vm) {
+		wrenSetSlotDouble(vm, 0, renderLayer);
+	}
+
+	void wren_Game_layer_set(WrenVM* vm) {
+		if (wrenGetSlotType(vm, 1) != WREN_TYPE_NUM) {
+			wrenAbort(vm, "layer must be a Num");
+			return;
+		}
+
+		double layer = wrenGetSlotDouble(vm, 1);
+		if (layer != trunc(layer) || layer < INT32_MIN || layer > INT32_MAX) {
+			wrenAbort(vm, "layer must be a 32 bit integer");
+			return;
+		}
+
+		renderLayer = (int32_t)layer;
+	}
+
 	static const char* CURSOR_DEFAULT = "default";
 	static const char* CURSOR_POINTER = "pointer";
 	static const char* CURSOR_WAIT = "wait";
@@ -4168,6 +8897,15 @@ const char* wren_resolveModule(WrenVM* vm, const char* importer, const char* nam
 		float g = (float)wrenGetSlotDouble(vm, 2);
 		float b = (float)wrenGetSlotDouble(vm, 3);
 
+		if (!canvasCurrent) {
+			if (!render_frameDrawn && renderQueue.commandCount == 0 && !renderState.scissor) render_frameCleared = true;
+			render_frameDrawn = true;
+		}
+
+		// Clearing is affected by the clip, and must happen after everything queued before it.
+		renderQueueFlush();
+		renderStateApply(&renderState);
+
 		glClearColor(r, g, b, 1.0f);
 		glClear(GL_COLOR_BUFFER_BIT);
 	}
@@ -4185,17 +8923,21 @@ const char* wren_resolveModule(WrenVM* vm, const char* importer, const char* nam
 		int w = (int)wrenGetSlotDouble(vm, 3);
 		int h = (int)wrenGetSlotDouble(vm, 4);
 
-		glEnable(GL_SCISSOR_TEST);
-		glScissor(x, game_resolutionHeight - h - y, w, h);
+		renderState.scissor = true;
+		renderState.scissorRect[0] = x;
+		// Canvases are upside down, like the camera.
+		renderState.scissorRect[1] = canvasCurrent ? y : game_resolutionHeight - h - y;
+		renderState.scissorRect[2] = w;
+		renderState.scissorRect[3] = h;
+		renderStateDirty = true;
 	}
 
 	void wren_Game_clearClip(WrenVM* vm) {
-		resetGlScissor();
+		renderStateResetScissor();
 	}
 
 	void wren_Game_blendColor(WrenVM* vm) {
-		float rgba[4];
-		glGetFloatv(GL_BLEND_COLOR, rgba);
+		float* rgba = renderState.blendColor;
 
 		Color color;
 		color.parts.r = (uint8_t)(rgba[0] * 255.999f);
@@ -4219,7 +8961,11 @@ const char* wren_resolveModule(WrenVM* vm, const char* importer, const char* nam
 		float b = (float)wrenGetSlotDouble(vm, 3);
 		float a = (float)wrenGetSlotDouble(vm, 4);
 
-		glBlendColor(r, g, b, a);
+		renderState.blendColor[0] = r;
+		renderState.blendColor[1] = g;
+		renderState.blendColor[2] = b;
+		renderState.blendColor[3] = a;
+		renderStateDirty = true;
 	}
 	
 	void wren_Game_setBlendMode(WrenVM* vm) {
@@ -4242,22 +8988,17 @@ const char* wren_resolveModule(WrenVM* vm, const char* importer, const char* nam
 		GLenum dstAlpha = wren_blendConstantStringToGlEnum(vm, 6);
 		if (dstAlpha == 2) return;
 
-		// Set GL state.
-		if (eqRGB == eqAlpha) {
-			glBlendEquation(eqRGB);
-		} else {
-			glBlendEquationSeparate(eqRGB, eqAlpha);
-		}
-
-		if (srcRGB == srcAlpha && dstRGB == dstAlpha) {
-			glBlendFunc(srcRGB, dstRGB);
-		} else {
-			glBlendFuncSeparate(srcRGB, dstRGB, srcAlpha, dstAlpha);
-		}
+		renderState.blendEquationRGB = eqRGB;
+		renderState.blendEquationAlpha = eqAlpha;
+		renderState.blendSrcRGB = srcRGB;
+		renderState.blendSrcAlpha = srcAlpha;
+		renderState.blendDstRGB = dstRGB;
+		renderState.blendDstAlpha = dstAlpha;
+		renderStateDirty = true;
 	}
 
 	void wren_Game_resetBlendMode(WrenVM* vm) {
-		resetGlBlending();
+		renderStateResetBlending();
 	}
 
 	void wren_Game_openURL(WrenVM* vm) {
@@ -4332,7 +9073,7 @@ const char* wren_resolveModule(WrenVM* vm, const char* importer, const char* nam
 		if (filter != 0 && filter != mainFramebufferScaleFilter) {
 			mainFramebufferScaleFilter = filter;
 
-			glBindTexture(GL_TEXTURE_2D, mainFramebufferTex);
+			glCacheEditTexture(mainFramebufferTex);
 			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter);
 			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filter);
 		}
@@ -4342,6 +9083,175 @@ const char* wren_resolveModule(WrenVM* vm, const char* importer, const char* nam
 		game_quit = true;
 	}
 
+	void wren_Game_heap_(WrenVM* vm) {
+		wrenEnsureSlots(vm, 2);
+		wrenSetSlotNewList(vm, 0);
+
+		wrenSetSlotDouble(vm, 1, (double)heap_bytes);
+		wrenInsertInList(vm, 0, -1, 1);
+
+		wrenSetSlotDouble(vm, 1, (double)heap_lastAllocated);
+		wrenInsertInList(vm, 0, -1, 1);
+
+		wrenSetSlotBool(vm, 1, heap_lastCollected);
+		wrenInsertInList(vm, 0, -1, 1);
+	}
+
+	void wren_Game_idleGC(WrenVM* vm) {
+		wrenSetSlotBool(vm, 0, heap_idleGC);
+	}
+
+	void wren_Game_idleGC_set(WrenVM* vm) {
+		if (wrenGetSlotType(vm, 1) != WREN_TYPE_BOOL) {
+			wrenAbort(vm, "idleGC must be Bool");
+			return;
+		}
+
+		heap_idleGC = wrenGetSlotBool(vm, 1);
+	}
+
+	void wren_Game_culling(WrenVM* vm) {
+		wrenSetSlotBool(vm, 0, render_culling);
+	}
+
+	void wren_Game_culling_set(WrenVM* vm) {
+		if (wrenGetSlotType(vm, 1) != WREN_TYPE_BOOL) {
+			wrenAbort(vm, "culling must be Bool");
+			return;
+		}
+
+		render_culling = wrenGetSlotBool(vm, 1);
+	}
+
+	void wren_Game_redrawMode(WrenVM* vm) {
+		wrenSetSlotString(vm, 0, game_redrawOnDemand ? "onDemand" : "always");
+	}
+
+	void wren_Game_redrawMode_set(WrenVM* vm) {
+		const char* mode = wrenGetSlotType(vm, 1) == WREN_TYPE_STRING ? wrenGetSlotString(vm, 1) : "";
+
+		if (strcmp(mode, "always") == 0) {
+			game_redrawOnDemand = false;
+		} else if (strcmp(mode, "onDemand") == 0) {
+			game_redrawOnDemand = true;
+		} else {
+			wrenAbort(vm, "redrawMode must be \"always\" or \"onDemand\"");
+		}
+	}
+
+	void wren_Game_requestRedraw(WrenVM* vm) {
+		game_redrawAt = 0;
+	}
+
+	void wren_Game_requestRedraw_1(WrenVM* vm) {
+		if (wrenGetSlotType(vm, 1) != WREN_TYPE_NUM) {
+			wrenAbort(vm, "seconds must be Num");
+			return;
+		}
+
+		double at = pacingNow() + fmax(wrenGetSlotDouble(vm, 1), 0);
+		if (at < game_redrawAt) game_redrawAt = at;
+	}
+
+	void wren_Game_stats_(WrenVM* vm) {
+		double values[7] = {
+			renderStatsLast.drawCalls,
+			renderStatsLast.vertices,
+			(double)renderStatsLast.bufferBytesUploaded,
+			renderStatsLast.textureBinds,
+			renderStatsLast.stateChanges,
+			(double)renderStats_textureMemory,
+			renderStatsLast.culled,
+		};
+
+		wrenEnsureSlots(vm, 2);
+		wrenSetSlotNewList(vm, 0);
+
+		for (int i = 0; i < 7; i++) {
+			wrenSetSlotDouble(vm, 1, values[i]);
+			wrenInsertInList(vm, 0, -1, 1);
+		}
+	}
+
+	// PROFILER
+
+	void wren_Profiler_enabled(WrenVM* vm) {
+		wrenSetSlotBool(vm, 0, profiler_enabled);
+	}
+
+	void wren_Profiler_enabled_set(WrenVM* vm) {
+		if (wrenGetSlotType(vm, 1) != WREN_TYPE_BOOL) {
+			wrenAbort(vm, "enabled must be Bool");
+			return;
+		}
+
+		if (!profilerSetEnabled(wrenGetSlotBool(vm, 1))) {
+			wrenAbort(vm, "alloc profiler zones");
+		}
+	}
+
+	void wren_Profiler_overlay(WrenVM* vm) {
+		wrenSetSlotBool(vm, 0, profiler_overlay);
+	}
+
+	void wren_Profiler_overlay_set(WrenVM* vm) {
+		if (wrenGetSlotType(vm, 1) != WREN_TYPE_BOOL) {
+			wrenAbort(vm, "overlay must be Bool");
+			return;
+		}
+
+		profiler_overlay = wrenGetSlotBool(vm, 1);
+		profiler_overlayText[0] = '\0';
+		profiler_overlayRowCount = 0;
+		profiler_overlayFrames = 0;
+
+		if (profiler_overlay && !profiler_enabled && !profilerSetEnabled(true)) {
+			wrenAbort(vm, "alloc profiler zones");
+		}
+	}
+
+	void wren_Profiler_begin(WrenVM* vm) {
+		if (!profiler_enabled) return;
+
+		if (wrenEnsureArgString(vm, 1, "name")) return;
+
+		const char* name = profilerInternName(wrenGetSlotString(vm, 1));
+		if (!name) {
+			wrenAbort(vm, "too many profiler zone names");
+			return;
+		}
+
+		uint32_t depth = profiler_depth;
+		profilerBegin(name);
+
+		if (profiler_depth == depth) {
+			profiler_scriptDropped++;
+		} else {
+			profiler_scriptDepth++;
+		}
+	}
+
+	void wren_Profiler_end(WrenVM* vm) {
+		if (!profiler_enabled) return;
+
+		if (profiler_scriptDropped > 0) {
+			profiler_scriptDropped--;
+		} else if (profiler_scriptDepth > 0) {
+			profiler_scriptDepth--;
+			profilerEnd();
+		} else {
+			wrenAbort(vm, "Profiler.end() called without a matching Profiler.begin()");
+		}
+	}
+
+	void wren_Profiler_dump(WrenVM* vm) {
+		if (wrenEnsureArgString(vm, 1, "path")) return;
+
+		if (!profilerWriteTrace(wrenGetSlotString(vm, 1))) {
+			wrenAbort(vm, "could not write profiler trace");
+		}
+	}
+
 	// PLATFORM
 
 	void wren_Platform_os(WrenVM* vm) {
@@ -4453,6 +9363,15 @@ const char* wren_resolveModule(WrenVM* vm, const char* importer, const char* nam
 					if (strcmp(signature, "textIsActive") == 0) return wren_Input_textIsActive;
 					if (strcmp(signature, "textSelection") == 0) return wren_Input_textSelection;
 					if (strcmp(signature, "textString") == 0) return wren_Input_textString;
+					if (strcmp(signature, "code_(_)") == 0) return wren_Input_code_;
+					if (strcmp(signature, "value_(_)") == 0) return wren_Input_value_;
+					if (strcmp(signature, "held_(_)") == 0) return wren_Input_held_;
+					if (strcmp(signature, "pressed_(_)") == 0) return wren_Input_pressed_;
+					if (strcmp(signature, "released_(_)") == 0) return wren_Input_released_;
+					if (strcmp(signature, "whichPressed") == 0) return wren_Input_whichPressed;
+					if (strcmp(signature, "holdCutoff") == 0) return wren_Input_holdCutoff;
+					if (strcmp(signature, "holdCutoff_(_)") == 0) return wren_Input_holdCutoff_;
+					if (strcmp(signature, "advance_()") == 0) return wren_Input_advance_;
 				}
 			} else if (strcmp(className, "AudioBus") == 0) {
 				if (!isStatic) {
@@ -4512,6 +9431,7 @@ const char* wren_resolveModule(WrenVM* vm, const char* importer, const char* nam
 			} else if (strcmp(className, "Sprite") == 0) {
 				if (isStatic) {
 					if (strcmp(signature, "load(_)") == 0) return wren_Sprite_load;
+					if (strcmp(signature, "load(_,_)") == 0) return wren_Sprite_load_2;
 					if (strcmp(signature, "defaultScaleFilter") == 0) return wren_Sprite_defaultScaleFilter;
 					if (strcmp(signature, "defaultScaleFilter=(_)") == 0) return wren_Sprite_defaultScaleFilter_set;
 					if (strcmp(signature, "defaultWrapMode") == 0) return wren_Sprite_defaultWrapMode;
@@ -4527,6 +9447,7 @@ const char* wren_resolveModule(WrenVM* vm, const char* importer, const char* nam
 					if (strcmp(signature, "endBatch()") == 0) return wren_sprite_endBatch;
 					if (strcmp(signature, "draw(_,_,_,_)") == 0) return wren_sprite_draw_4;
 					if (strcmp(signature, "draw(_,_,_,_,_,_,_,_)") == 0) return wren_sprite_draw_8;
+					if (strcmp(signature, "drawBuffer(_,_,_)") == 0) return wren_sprite_drawBuffer;
 					if (strcmp(signature, "color") == 0) return wren_sprite_color;
 					if (strcmp(signature, "color=(_)") == 0) return wren_sprite_color_set;
 					if (strcmp(signature, "transform") == 0) return wren_sprite_transform;
@@ -4540,6 +9461,67 @@ const char* wren_resolveModule(WrenVM* vm, const char* importer, const char* nam
 					if (strcmp(signature, "endBatch()") == 0) return wren_Quad_endBatch;
 					if (strcmp(signature, "draw(_,_,_,_,_)") == 0) return wren_Quad_draw5;
 					if (strcmp(signature, "draw(_,_,_,_,_,_,_,_,_)") == 0) return wren_Quad_draw9;
+					if (strcmp(signature, "drawBuffer(_,_,_)") == 0) return wren_Quad_drawBuffer;
+				}
+			} else if (strcmp(className, "StaticBatch") == 0) {
+				if (!isStatic) {
+					if (strcmp(signature, "begin_()") == 0) return wren_staticBatch_begin;
+					if (strcmp(signature, "end_()") == 0) return wren_staticBatch_end;
+					if (strcmp(signature, "draw()") == 0) return wren_staticBatch_draw;
+					if (strcmp(signature, "clear()") == 0) return wren_staticBatch_clear;
+					if (strcmp(signature, "drawCalls") == 0) return wren_staticBatch_drawCalls;
+				}
+			} else if (strcmp(className, "TilemapChunks_") == 0) {
+				if (!isStatic) {
+					if (strcmp(signature, "draw_(_,_,_,_)") == 0) return wren_tilemap_draw;
+					if (strcmp(signature, "markDirty_(_,_)") == 0) return wren_tilemap_markDirty;
+					if (strcmp(signature, "invalidate()") == 0) return wren_tilemap_invalidate;
+				}
+			} else if (strcmp(className, "Particles_") == 0) {
+				if (!isStatic) {
+					if (strcmp(signature, "count") == 0) return wren_particles_count;
+					if (strcmp(signature, "capacity") == 0) return wren_particles_capacity;
+					if (strcmp(signature, "setPosition(_,_)") == 0) return wren_particles_setPosition;
+					if (strcmp(signature, "rate=(_)") == 0) return wren_particles_rate_set;
+					if (strcmp(signature, "setLife(_,_)") == 0) return wren_particles_setLife;
+					if (strcmp(signature, "setVelocity(_,_,_,_)") == 0) return wren_particles_setVelocity;
+					if (strcmp(signature, "setGravity(_,_)") == 0) return wren_particles_setGravity;
+					if (strcmp(signature, "drag=(_)") == 0) return wren_particles_drag_set;
+					if (strcmp(signature, "setRotation(_,_)") == 0) return wren_particles_setRotation;
+					if (strcmp(signature, "setSpin(_,_)") == 0) return wren_particles_setSpin;
+					if (strcmp(signature, "colors=(_)") == 0) return wren_particles_colors_set;
+					if (strcmp(signature, "sizes=(_)") == 0) return wren_particles_sizes_set;
+					if (strcmp(signature, "spawnPoint()") == 0) return wren_particles_spawnPoint;
+					if (strcmp(signature, "spawnCircle(_)") == 0) return wren_particles_spawnCircle;
+					if (strcmp(signature, "spawnRect(_,_)") == 0) return wren_particles_spawnRect;
+					if (strcmp(signature, "emit(_)") == 0) return wren_particles_emit;
+					if (strcmp(signature, "update(_)") == 0) return wren_particles_update;
+					if (strcmp(signature, "draw_(_)") == 0) return wren_particles_draw;
+					if (strcmp(signature, "clear()") == 0) return wren_particles_clear;
+				}
+			} else if (strcmp(className, "Font") == 0) {
+				if (isStatic) {
+					if (strcmp(signature, "load(_)") == 0) return wren_Font_load;
+					if (strcmp(signature, "system_") == 0) return wren_Font_system_;
+				} else {
+					if (strcmp(signature, "lineHeight") == 0) return wren_font_lineHeight;
+				}
+			} else if (strcmp(className, "TextLayout_") == 0) {
+				if (!isStatic) {
+					if (strcmp(signature, "string=(_)") == 0) return wren_text_string_set;
+					if (strcmp(signature, "maxWidth=(_)") == 0) return wren_text_maxWidth_set;
+					if (strcmp(signature, "align=(_)") == 0) return wren_text_align_set;
+					if (strcmp(signature, "color=(_)") == 0) return wren_text_color_set;
+					if (strcmp(signature, "width") == 0) return wren_text_width;
+					if (strcmp(signature, "height") == 0) return wren_text_height;
+					if (strcmp(signature, "draw(_,_)") == 0) return wren_text_draw;
+				}
+			} else if (strcmp(className, "CanvasTarget_") == 0) {
+				if (!isStatic) {
+					if (strcmp(signature, "sprite_") == 0) return wren_canvas_sprite_;
+					if (strcmp(signature, "begin()") == 0) return wren_canvas_begin;
+					if (strcmp(signature, "end()") == 0) return wren_canvas_end;
+					if (strcmp(signature, "isDrawing") == 0) return wren_canvas_isDrawing;
 				}
 			} else if (strcmp(className, "Screen") == 0) {
 				if (isStatic) {
@@ -4557,6 +9539,11 @@ const char* wren_resolveModule(WrenVM* vm, const char* importer, const char* nam
 					if (strcmp(signature, "scaleFilter=(_)") == 0) return wren_Game_scaleFilter_set;
 					if (strcmp(signature, "fps") == 0) return wren_Game_fps;
 					if (strcmp(signature, "fps=(_)") == 0) return wren_Game_fps_set;
+					if (strcmp(signature, "vsync") == 0) return wren_Game_vsync;
+					if (strcmp(signature, "vsync=(_)") == 0) return wren_Game_vsync_set;
+					if (strcmp(signature, "frameTimeBudget") == 0) return wren_Game_frameTimeBudget;
+					if (strcmp(signature, "layer") == 0) return wren_Game_layer;
+					if (strcmp(signature, "layer=(_)") == 0) return wren_Game_layer_set;
 					if (strcmp(signature, "layoutChanged_(_,_,_,_,_)") == 0) return wren_Game_layoutChanged_;
 					if (strcmp(signature, "cursor") == 0) return wren_Game_cursor;
 					if (strcmp(signature, "cursor=(_)") == 0) return wren_Game_cursor_set;
@@ -4576,6 +9563,26 @@ const char* wren_resolveModule(WrenVM* vm, const char* importer, const char* nam
 					if (strcmp(signature, "arguments") == 0) return wren_Game_arguments;
 					if (strcmp(signature, "ready_()") == 0) return wren_Game_ready_;
 					if (strcmp(signature, "quit()") == 0) return wren_Game_quit_;
+					if (strcmp(signature, "stats_") == 0) return wren_Game_stats_;
+					if (strcmp(signature, "heap_") == 0) return wren_Game_heap_;
+					if (strcmp(signature, "idleGC") == 0) return wren_Game_idleGC;
+					if (strcmp(signature, "idleGC=(_)") == 0) return wren_Game_idleGC_set;
+					if (strcmp(signature, "culling") == 0) return wren_Game_culling;
+					if (strcmp(signature, "culling=(_)") == 0) return wren_Game_culling_set;
+					if (strcmp(signature, "redrawMode") == 0) return wren_Game_redrawMode;
+					if (strcmp(signature, "redrawMode=(_)") == 0) return wren_Game_redrawMode_set;
+					if (strcmp(signature, "requestRedraw()") == 0) return wren_Game_requestRedraw;
+					if (strcmp(signature, "requestRedraw(_)") == 0) return wren_Game_requestRedraw_1;
+				}
+			} else if (strcmp(className, "Profiler") == 0) {
+				if (isStatic) {
+					if (strcmp(signature, "enabled") == 0) return wren_Profiler_enabled;
+					if (strcmp(signature, "enabled=(_)") == 0) return wren_Profiler_enabled_set;
+					if (strcmp(signature, "overlay") == 0) return wren_Profiler_overlay;
+					if (strcmp(signature, "overlay=(_)") == 0) return wren_Profiler_overlay_set;
+					if (strcmp(signature, "begin(_)") == 0) return wren_Profiler_begin;
+					if (strcmp(signature, "end()") == 0) return wren_Profiler_end;
+					if (strcmp(signature, "dump(_)") == 0) return wren_Profiler_dump;
 				}
 			} else if (strcmp(className, "Platform") == 0) {
 				if (isStatic) {
@@ -4612,6 +9619,23 @@ const char* wren_resolveModule(WrenVM* vm, const char* importer, const char* nam
 				if (strcmp(className, "Sprite") == 0) {
 					methods.allocate = wren_spriteAllocate;
 					methods.finalize = wren_spriteFinalize;
+				} else if (strcmp(className, "StaticBatch") == 0) {
+					methods.allocate = wren_staticBatchAllocate;
+					methods.finalize = wren_staticBatchFinalize;
+				} else if (strcmp(className, "TilemapChunks_") == 0) {
+					methods.allocate = wren_tilemapAllocate;
+					methods.finalize = wren_tilemapFinalize;
+				} else if (strcmp(className, "Particles_") == 0) {
+					methods.allocate = wren_particleEmitterAllocate;
+					methods.finalize = wren_particleEmitterFinalize;
+				} else if (strcmp(className, "Font") == 0) {
+					methods.allocate = wren_fontAllocate;
+				} else if (strcmp(className, "TextLayout_") == 0) {
+					methods.allocate = wren_textAllocate;
+					methods.finalize = wren_textFinalize;
+				} else if (strcmp(className, "CanvasTarget_") == 0) {
+					methods.allocate = wren_canvasAllocate;
+					methods.finalize = wren_canvasFinalize;
 				} else if (strcmp(className, "AudioBus") == 0) {
 					methods.allocate = wren_audioBusAllocate;
 					methods.finalize = wren_audioBusFinalize;
@@ -4621,6 +9645,9 @@ const char* wren_resolveModule(WrenVM* vm, const char* importer, const char* nam
 				} else if (strcmp(className, "Voice") == 0) {
 					methods.allocate = wren_voiceAllocate;
 					methods.finalize = wren_voiceFinalize;
+				} else if (strcmp(className, "HeapSentinel_") == 0) {
+					methods.allocate = wren_heapSentinelAllocate;
+					methods.finalize = wren_heapSentinelFinalize;
 				}
 			}
 		}
@@ -4666,6 +9693,198 @@ const char* wren_resolveModule(WrenVM* vm, const char* importer, const char* nam
 
 
 
+	// === RUNTIME ARGUMENTS ===
+
+	// Reads runtime flags from the command line.
+	// All arguments are still passed on to [Game.arguments].
+	void readRuntimeArguments(int argc, char** argv) {
+		for (int argi = 1; argi < argc; argi++) {
+			const char* arg = argv[argi];
+
+			if (strcmp(arg, "--headless") == 0) {
+				game_headless = true;
+			} else if (strncmp(arg, "--bench=", 8) == 0) {
+				long frames = strtol(arg + 8, NULL, 10);
+				if (frames > 0) {
+					bench_frameCount = (uint32_t)frames;
+				}
+			} else if (strcmp(arg, "--profile") == 0) {
+				profilerSetEnabled(true);
+			} else if (strncmp(arg, "--profile-out=", 14) == 0) {
+				profiler_outPath = arg + 14;
+				profilerSetEnabled(true);
+			} else if (strncmp(arg, "--heap-initial=", 15) == 0) {
+				heap_initialSize = (size_t)strtoull(arg + 15, NULL, 10);
+			} else if (strncmp(arg, "--heap-min=", 11) == 0) {
+				heap_minSize = (size_t)strtoull(arg + 11, NULL, 10);
+			} else if (strncmp(arg, "--heap-growth=", 14) == 0) {
+				heap_growthPercent = (int)strtol(arg + 14, NULL, 10);
+			} else if (strcmp(arg, "--alloc=system") == 0) {
+				pool_enabled = false;
+			} else if (strcmp(arg, "--alloc=pool") == 0) {
+				pool_enabled = true;
+			} else if (strncmp(arg, "--texture-slots=", 16) == 0) {
+				long slots = strtol(arg + 16, NULL, 10);
+				if (slots >= 1 && slots <= RENDER_TEXTURE_SLOTS) {
+					renderQueue_textureSlots = (int)slots;
+				}
+			} else if (strcmp(arg, "--present=shader") == 0) {
+				mainFramebufferAlwaysShader = true;
+			} else if (strcmp(arg, "--present=direct") == 0) {
+				mainFramebufferAllowDirect = true;
+			} else if (strcmp(arg, "--bench-paced") == 0) {
+				bench_paced = true;
+			} else if (strncmp(arg, "--bench-out=", 12) == 0) {
+				bench_outPath = arg + 12;
+			}
+		}
+	}
+
+
+	// === BENCHMARK ===
+
+	// [RenderStats] summed over all benchmark frames.
+	// 64 bit, as per frame counts summed over thousands of frames overflow 32 bits.
+	typedef struct {
+		uint64_t drawCalls;
+		uint64_t vertices;
+		uint64_t bufferBytesUploaded;
+		uint64_t textureBinds;
+		uint64_t stateChanges;
+		uint64_t culled;
+	} BenchRenderTotals;
+
+	// Render and heap stats summed over all benchmark frames.
+	static BenchRenderTotals bench_renderTotals = { 0 };
+	static uint64_t bench_heapAllocated = 0;
+	// Frames in which at least one garbage collection ran.
+	static uint32_t bench_heapCollectedFrames = 0;
+
+	int benchCompareDouble(const void* a, const void* b) {
+		double da = *(const double*)a;
+		double db = *(const double*)b;
+		return da < db ? -1 : (da > db ? 1 : 0);
+	}
+
+	// Nearest-rank percentile of a sorted array, [p] is in the range 0..1.
+	double benchPercentile(const double* sorted, uint32_t count, double p) {
+		uint32_t rank = (uint32_t)ceil(p * count);
+		if (rank < 1) rank = 1;
+		if (rank > count) rank = count;
+		return sorted[rank - 1];
+	}
+
+	// Adds a top level number field to the results object.
+	void benchAddNumber(StringBuilder* sb, const char* name, double value) {
+		char buffer[96];
+		snprintf(buffer, 96, ",\n\t\"%s\": %.6g", name, value);
+		sbAddStr(sb, buffer);
+	}
+
+	// Adds a top level object field to the results object, summarizing the distribution of [values].
+	bool benchAddStats(StringBuilder* sb, const char* name, const double* values, uint32_t count) {
+		double* sorted = (double*)malloc(count * sizeof(double));
+		if (!sorted) return false;
+
+		memcpy(sorted, values, count * sizeof(double));
+		qsort(sorted, count, sizeof(double), benchCompareDouble);
+
+		double total = 0;
+		for (uint32_t i = 0; i < count; i++) {
+			total += sorted[i];
+		}
+		double mean = total / count;
+
+		double variance = 0;
+		for (uint32_t i = 0; i < count; i++) {
+			variance += (sorted[i] - mean) * (sorted[i] - mean);
+		}
+		variance /= count;
+
+		char buffer[256];
+		snprintf(buffer, 256,
+			",\n\t\"%s\": { \"mean\": %.4f, \"stddev\": %.4f, \"min\": %.4f, \"p50\": %.4f, \"p95\": %.4f, \"p99\": %.4f, \"max\": %.4f }",
+			name,
+			mean,
+			sqrt(variance),
+			sorted[0],
+			benchPercentile(sorted, count, 0.50),
+			benchPercentile(sorted, count, 0.95),
+			benchPercentile(sorted, count, 0.99),
+			sorted[count - 1]
+		);
+		sbAddStr(sb, buffer);
+
+		free(sorted);
+
+		return true;
+	}
+
+	// Writes frame time stats as JSON to [bench_outPath], or STDOUT if no path was given.
+	// Frame times and intervals are in milliseconds, other times are in seconds.
+	bool benchWriteResults(uint32_t frameCount, double delta) {
+		StringBuilder sb;
+		sbInit(&sb);
+
+		char buffer[64];
+		snprintf(buffer, 64, "{\n\t\"frames\": %u", frameCount);
+		sbAddStr(&sb, buffer);
+
+		benchAddNumber(&sb, "delta", delta);
+
+		double total = 0;
+		for (uint32_t i = 0; i < frameCount; i++) {
+			total += bench_frameTimes[i];
+		}
+		benchAddNumber(&sb, "totalTime", total / 1000.0);
+
+		benchAddNumber(&sb, "drawCalls", (double)bench_renderTotals.drawCalls / frameCount);
+		benchAddNumber(&sb, "vertices", (double)bench_renderTotals.vertices / frameCount);
+		benchAddNumber(&sb, "bufferBytesUploaded", (double)bench_renderTotals.bufferBytesUploaded / frameCount);
+		benchAddNumber(&sb, "textureBinds", (double)bench_renderTotals.textureBinds / frameCount);
+		benchAddNumber(&sb, "stateChanges", (double)bench_renderTotals.stateChanges / frameCount);
+		benchAddNumber(&sb, "culled", (double)bench_renderTotals.culled / frameCount);
+		benchAddNumber(&sb, "textureMemory", (double)renderStats_textureMemory);
+
+		benchAddNumber(&sb, "heapBytes", (double)heap_bytes);
+		benchAddNumber(&sb, "heapAllocated", (double)bench_heapAllocated / frameCount);
+		benchAddNumber(&sb, "gcFrames", bench_heapCollectedFrames);
+
+		benchAddNumber(&sb, "poolEnabled", pool_enabled);
+		benchAddNumber(&sb, "poolAllocs", (double)pool_allocCount);
+		benchAddNumber(&sb, "systemAllocs", (double)pool_systemAllocCount);
+		benchAddNumber(&sb, "poolChunkBytes", (double)pool_chunkBytes);
+		benchAddNumber(&sb, "frameArenaPeak", (double)frameArena_peak);
+
+		benchAddNumber(&sb, "textureSlots", renderQueue_textureSlots);
+		benchAddNumber(&sb, "streamPersistent", streamBufferMapped != NULL);
+		benchAddNumber(&sb, "streamWaits", streamBuffer_waitCount);
+
+		benchAddNumber(&sb, "swapInterval", game_swapInterval);
+		benchAddNumber(&sb, "sleepTime", pacing_sleepTime);
+		benchAddNumber(&sb, "spinTime", pacing_spinTime);
+
+		bool ok = benchAddStats(&sb, "frameTime", bench_frameTimes, frameCount);
+		if (ok && frameCount > 1) {
+			ok = benchAddStats(&sb, "frameInterval", bench_frameIntervals, frameCount - 1);
+		}
+
+		sbAddStr(&sb, "\n}\n");
+
+		if (ok) {
+			if (bench_outPath) {
+				ok = fileWrite(bench_outPath, sb.data, sb.size);
+			} else {
+				fwrite(sb.data, 1, sb.size, stdout);
+			}
+		}
+
+		sbFree(&sb);
+
+		return ok;
+	}
+
+
 	// === MAIN ===
 
 	int mainWithSDL(int argc, char** argv) {
@@ -4718,6 +9937,12 @@ const char* wren_resolveModule(WrenVM* vm, const char* importer, const char* nam
 			return -1;
 		}
 
+		// Setup frame pacing.
+		pacing_perfFrequency = (double)SDL_GetPerformanceFrequency();
+		pacingUpdateDisplayPeriod();
+		// Vsync is on by default, set Game.vsync = false to turn it off.
+		pacingSetSwapInterval(1);
+
 		#ifdef DEBUG
 
 			printf("Loaded Glad %d.%d\n", GLAD_VERSION_MAJOR(gladVersion), GLAD_VERSION_MINOR(gladVersion));
@@ -4777,12 +10002,18 @@ const char* wren_resolveModule(WrenVM* vm, const char* importer, const char* nam
 		glBindBuffer(GL_ARRAY_BUFFER, mainFramebufferTriangles);
 		glBufferData(GL_ARRAY_BUFFER, sizeof(triangles), triangles, GL_STATIC_DRAW);
 
+		glBindVertexArray(mainFramebufferVertexArray);
+		glVertexAttribPointer(0, 2, GL_FLOAT, false, 0, (void*)0);
+		glEnableVertexAttribArray(0);
+		glBindVertexArray(0);
+
 		glGenFramebuffers(1, &mainFramebuffer);
 		glBindFramebuffer(GL_FRAMEBUFFER, mainFramebuffer);
 
 		glGenTextures(1, &mainFramebufferTex);
-		glBindTexture(GL_TEXTURE_2D, mainFramebufferTex);
+		glCacheEditTexture(mainFramebufferTex);
 		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, game_windowWidth, game_windowHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+		renderStatsFramebufferResized(game_windowWidth, game_windowHeight);
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
 
@@ -4798,6 +10029,20 @@ const char* wren_resolveModule(WrenVM* vm, const char* importer, const char* nam
 		}
 
 		// Init custom draw buffers.
+		if (!streamBufferInit()) {
+			quitError = "create stream buffer";
+			return -1;
+		}
+
+		if (!renderQueueInit()) {
+			quitError = "allocate render queue";
+			return -1;
+		}
+
+		// The blit always samples texture unit 0.
+		glCacheUseProgram(shaderFramebuffer.program);
+		glUniform1i(shaderFramebuffer.uniforms[0], 0);
+
 		if (!primitiveBatcherInit(&quadBatcher)) {
 			quitError = "allocate quad batcher";
 			return -1;
@@ -4815,6 +10060,14 @@ const char* wren_resolveModule(WrenVM* vm, const char* importer, const char* nam
 		config.bindForeignClassFn = wren_bindForeignClass;
 		config.loadModuleFn = wren_loadModule;
 		config.resolveModuleFn = wren_resolveModule;
+		config.reallocateFn = wren_reallocate;
+
+		if (heap_initialSize > 0) config.initialHeapSize = heap_initialSize;
+		if (heap_minSize > 0) config.minHeapSize = heap_minSize;
+		if (heap_growthPercent > 0) config.heapGrowthPercent = heap_growthPercent;
+
+		// Wren doesn't collect until the heap reaches [initialHeapSize].
+		heap_bytesAfterGC = config.initialHeapSize * 100 / (100 + config.heapGrowthPercent);
 
 		vm = wrenNewVM(&config);
 
@@ -4823,7 +10076,7 @@ const char* wren_resolveModule(WrenVM* vm, const char* importer, const char* nam
 		callHandle_update_0 = wrenMakeCallHandle(vm, "update_()");
 		callHandle_update_2 = wrenMakeCallHandle(vm, "update_(_,_)");
 		callHandle_update_3 = wrenMakeCallHandle(vm, "update_(_,_,_)");
-		callHandle_updateMouse_3 = wrenMakeCallHandle(vm, "updateMouse_(_,_,_)");
+		callHandle_frame_5 = wrenMakeCallHandle(vm, "frame_(_,_,_,_,_)");
 
 		// Create [Game.arguments] map.
 		wrenEnsureSlots(vm, 3);
@@ -4874,9 +10127,8 @@ const char* wren_resolveModule(WrenVM* vm, const char* importer, const char* nam
 		wrenAddImplicitImportModule(vm, "sock");
 
 		// Get handles.
-		handle_Time = wrenGetVariableHandle("sock", "Time");
-		handle_Input = wrenGetVariableHandle("sock", "Input");
 		handle_Game = wrenGetVariableHandle("sock", "Game");
+		handle_HeapSentinel = wrenGetVariableHandle("sock", "HeapSentinel_");
 
 		// Init modules.
 		initGameModule();
@@ -4893,21 +10145,59 @@ const char* wren_resolveModule(WrenVM* vm, const char* importer, const char* nam
 		}
 
 		// We can show the window now!
-		SDL_ShowWindow(window);
+		if (!game_headless) {
+			SDL_ShowWindow(window);
+		}
 
 		// Setup
 		int inLoop = 1;
-		uint64_t prevTime = 0;
-		uint64_t startTime = 0;
-		uint64_t totalTime = 0;
-		double remainingTime = 0;
+		double startTime = -1;
+		double prevFrameTime = -1;
+		double nextFrame = 0;
+		// Set when on demand mode waited for a redraw, so the time spent idle isn't passed on as a delta.
+		bool idled = false;
 		bool windowResized = false;
 
+		// Benchmarks run uncapped, but always step time by the same amount.
+		// Paced benchmarks run as normal, to measure frame pacing.
+		bool benchmarking = bench_frameCount > 0;
+		bool paced = !benchmarking || bench_paced;
+		uint32_t benchFrame = 0;
+		double benchDelta = game_fps > 0 ? 1.0 / game_fps : 1.0 / 60.0;
+
+		if (benchmarking) {
+			bench_frameTimes = (double*)malloc(bench_frameCount * sizeof(double));
+			bench_frameIntervals = (double*)malloc(bench_frameCount * sizeof(double));
+			if (!bench_frameTimes || !bench_frameIntervals) {
+				quitError = "alloc benchmark frame times";
+				return -1;
+			}
+
+			if (!paced) {
+				pacingSetSwapInterval(0);
+			}
+		}
+
 		while (inLoop) {
 			// Get SDL events.
 			bool anyInputs = false;
 			SDL_Event event;
-			while ( SDL_PollEvent(&event) ) {
+
+			// In on demand mode, sleep until there's an event or a redraw is due.
+			// Waits are capped, so a far off redraw doesn't rely on long timeouts.
+			bool waited = false;
+			if (game_ready && game_redrawOnDemand && paced) {
+				double wait = game_redrawAt - pacingNow();
+				if (wait > 0) {
+					idled = true;
+					waited = SDL_WaitEventTimeout(&event, wait >= 1.0 ? 1000 : (int)ceil(wait * 1000.0)) != 0;
+				}
+			}
+
+			while (waited || SDL_PollEvent(&event)) {
+				waited = false;
+				anyInputs = true;
+
 				switch (event.type) {
 					case SDL_QUIT:
 					{
@@ -5013,17 +10303,16 @@ const char* wren_resolveModule(WrenVM* vm, const char* importer, const char* nam
 										}
 										break;
 									}
+									default: break;
 								}
 							}
 						}
 
 						// Game input.
 						if (!event.key.repeat) {
-							const char* id = sdlScancodeToInputID(event.key.keysym.scancode);
-							if (id) {
-								if (!updateInput(id, event.type == SDL_KEYDOWN ? 1.0f : 0.0f)) {
-									inLoop = 0;
-								}
+							SDL_Scancode code = event.key.keysym.scancode;
+							if (sdlScancodeToInputID(code)) {
+								inputSetValue(code, event.type == SDL_KEYDOWN ? 1.0f : 0.0f);
 							}
 						}
 						
@@ -5032,20 +10321,18 @@ const char* wren_resolveModule(WrenVM* vm, const char* importer, const char* nam
 					case SDL_MOUSEBUTTONDOWN:
 					case SDL_MOUSEBUTTONUP:
 					{
-						const char* id = NULL;
+						int code = -1;
 
 						if (event.button.button == SDL_BUTTON_LEFT) {
-							id = INPUT_ID_MOUSE_LEFT;
+							code = INPUT_CODE_MOUSE_LEFT;
 						} else if (event.button.button == SDL_BUTTON_MIDDLE) {
-							id = INPUT_ID_MOUSE_MIDDLE;
+							code = INPUT_CODE_MOUSE_MIDDLE;
 						} else if (event.button.button == SDL_BUTTON_RIGHT) {
-							id = INPUT_ID_MOUSE_RIGHT;
+							code = INPUT_CODE_MOUSE_RIGHT;
 						}
 						
-						if (id) {
-							if (!updateInput(id, event.type == SDL_MOUSEBUTTONDOWN ? 1.0f : 0.0f)) {
-								inLoop = 0;
-							}
+						if (code >= 0) {
+							inputSetValue(code, event.type == SDL_MOUSEBUTTONDOWN ? 1.0f : 0.0f);
 						}
 
 						break;
@@ -5069,6 +10356,9 @@ const char* wren_resolveModule(WrenVM* vm, const char* importer, const char* nam
 								game_windowWidth = event.window.data1;
 								game_windowHeight = event.window.data2;
 							} break;
+							case SDL_WINDOWEVENT_DISPLAY_CHANGED: {
+								pacingUpdateDisplayPeriod();
+							} break;
 						}
 						break;
 					}
@@ -5100,93 +10390,204 @@ const char* wren_resolveModule(WrenVM* vm, const char* importer, const char* nam
 				wrenCall(vm, callHandle_update_2);
 			}
 
-			// Update time stuff..
-			uint64_t now = SDL_GetTicks64();
-			if (startTime == 0) startTime = now;
-			now -= startTime;
+			// Any event redraws in on demand mode, e.g. a window exposed or the mouse moved.
+			bool redraw = !game_redrawOnDemand || !paced || anyInputs || pacingNow() >= game_redrawAt;
 
-			uint64_t tickDelta = prevTime == 0 ? 0 : min(66, now - prevTime);
-			prevTime = now;
+			if (game_ready && redraw) {
+				double period = pacingFramePeriod();
 
-			if (game_ready) {
-				if (game_fps > 0) {
-					remainingTime -= (double)tickDelta / 1000.0;
-				} else {
-					remainingTime = 0;
+				// Wait until the frame deadline.
+				// When vsynced, swapping buffers waits for the display instead.
+				if (paced && period > 0 && !pacingIsVsynced()) {
+					pacingWaitUntil(nextFrame);
 				}
 
-				if (game_fps <= 0 || remainingTime <= 0) {
-					// Increment frame timer.
-					if (game_fps > 0) {
-						remainingTime += 1.0 / game_fps;
-					}
+				double frameStart = pacingNow();
 
-					// Do update.
-					// Update Sock time state.
-					updateTimeModule((double)now / 1000.0, (double)(now - totalTime) / 1000.0);
-					totalTime = now;
+				profilerBegin("frame");
 
-					// Update mouse position.
-					updateInputMouse();
+				// Advance the deadline, but don't try to catch up on missed frames.
+				nextFrame += period;
+				if (nextFrame < frameStart) {
+					nextFrame = frameStart + period;
+				}
 
-					// Prepare WebGL.
-					glBindFramebuffer(GL_FRAMEBUFFER, mainFramebuffer);
-					glViewport(0, 0, game_resolutionWidth, game_resolutionHeight);
+				// Do update.
+				// Get Sock time state.
+				if (startTime < 0) startTime = frameStart;
+				double now = frameStart - startTime;
 
-					// Call update fn.
-					wrenEnsureSlots(vm, 1);
-					wrenSetSlotHandle(vm, 0, handle_Game);
-					WrenInterpretResult updateResult = wrenCall(vm, callHandle_update_0);
+				double time = now;
+				double deltaTime = prevFrameTime < 0 ? 0 : fmin(now - prevFrameTime, PACING_MAX_DELTA);
 
-					if (updateResult != WREN_RESULT_SUCCESS) {
-						inLoop = 0;
-					}
-					if (game_quit) {
-						inLoop = 0;
-					}
-					
-					// Finalize GL.
-					resetGlBlending();
-					resetGlScissor();
+				// Waking up from idle counts as a single frame.
+				if (idled) {
+					deltaTime = fmin(deltaTime, period > 0 ? period : pacing_displayPeriod);
+					idled = false;
+				}
 
-					glBindFramebuffer(GL_FRAMEBUFFER, 0);
-					glViewport(game_renderRect.x, game_renderRect.y, game_renderRect.w, game_renderRect.h);
+				if (!paced) {
+					time = benchFrame * benchDelta;
+					deltaTime = benchFrame == 0 ? 0 : benchDelta;
+				}
+
+				if (benchmarking && prevFrameTime >= 0) {
+					bench_frameIntervals[benchFrame - 1] = (now - prevFrameTime) * 1000.0;
+				}
+				prevFrameTime = now;
+
+				// Prepare WebGL.
+				// If allowed, and the last frame didn't depend on the one before, assume this one won't either,
+				// and draw it straight into the window when it doesn't need scaling.
+				mainFramebufferDirect =
+					mainFramebufferAllowDirect && !mainFramebufferAlwaysShader && render_frameCleared &&
+					game_renderRect.x == 0 && game_renderRect.y == 0 &&
+					game_renderRect.w == game_resolutionWidth && game_renderRect.h == game_resolutionHeight;
+				render_frameDrawn = false;
+				render_frameCleared = false;
+				canvasBindTarget();
+
+				// Call update fn, passing time and mouse state along with it.
+				profilerBegin("update");
+
+				// The update requests the next redraw, if it wants one.
+				game_redrawAt = INFINITY;
+
+				wrenEnsureSlots(vm, 6);
+				wrenSetSlotHandle(vm, 0, handle_Game);
+				wrenSetSlotDouble(vm, 1, time);
+				wrenSetSlotDouble(vm, 2, deltaTime);
+				wrenSetSlotDouble(vm, 3, floor((mouseWindowPosX - game_renderRect.x) / game_renderScale));
+				wrenSetSlotDouble(vm, 4, floor((mouseWindowPosY - game_renderRect.y) / game_renderScale));
+				wrenSetSlotDouble(vm, 5, (double)mouseWheel);
+				WrenInterpretResult updateResult = wrenCall(vm, callHandle_frame_5);
 
-					glUseProgram(shaderFramebuffer.program);
+				mouseWheel = 0;
 
-					glBindVertexArray(mainFramebufferVertexArray);
+				// Profiler.begin() without a matching end() only lasts until the end of the update.
+				profilerEndScriptZones();
+				profilerEnd();
 
-					glActiveTexture(GL_TEXTURE0);
-					glBindTexture(GL_TEXTURE_2D, mainFramebufferTex);
-					glUniform1i(shaderFramebuffer.uniforms[0], 0);
+				if (updateResult != WREN_RESULT_SUCCESS) {
+					inLoop = 0;
+				}
+				if (game_quit) {
+					inLoop = 0;
+				}
 
-					glBindBuffer(GL_ARRAY_BUFFER, mainFramebufferTriangles);
-					glVertexAttribPointer(0, 2, GL_FLOAT, false, 0, (void*)0);
-					glEnableVertexAttribArray(0);
+				// A recording left open, e.g. by an aborted record fn, ends with the frame.
+				staticBatchEnd();
 
-					glDrawArrays(GL_TRIANGLES, 0, 6);
+				// As does a Canvas left drawing.
+				canvasEnd();
+				
+				// Finalize GL.
+				renderStateResetBlending();
+				renderStateResetScissor();
 
-					glUseProgram(0);
-					glBindVertexArray(0);
-					glDisableVertexAttribArray(0);
+				if (profiler_overlay) {
+					setCameraOrigin(0, 0, NULL);
+					systemFontDraw(profiler_overlayText, 4, 4, 0xffffffffU);
+				}
+
+				renderQueueFlush();
+				renderFreeDeleted();
+				renderStateApply(&renderState);
+
+				if (!mainFramebufferDirect) {
+					profilerBegin("blit");
+					mainFramebufferPresent();
+					profilerEnd();
+				}
+
+				profilerBegin("swap");
+				SDL_GL_SwapWindow(window);
+				profilerEnd();
+
+				// Check for GL errors.
+				if (debug_checkGlError("post update")) inLoop = 0;
+
+				profilerEnd();
+				profilerEndFrame();
+
+				if (benchmarking) {
+					bench_renderTotals.drawCalls += renderStats.drawCalls;
+					bench_renderTotals.vertices += renderStats.vertices;
+					bench_renderTotals.bufferBytesUploaded += renderStats.bufferBytesUploaded;
+					bench_renderTotals.textureBinds += renderStats.textureBinds;
+					bench_renderTotals.stateChanges += renderStats.stateChanges;
+					bench_renderTotals.culled += renderStats.culled;
+				}
+
+				renderStatsEndFrame();
+
+				// Use the time left before the next frame to collect garbage.
+				if (heap_idleGC && paced && period > 0) {
+					heapCollectIdle(&config, nextFrame - pacingNow());
+				}
 
-					SDL_GL_SwapWindow(window);
+				heapEndFrame();
+				frameArenaReset();
 
-					// Check for GL errors.
-					if (debug_checkGlError("post update")) inLoop = 0;
+				if (benchmarking) {
+					bench_heapAllocated += heap_lastAllocated;
+					if (heap_lastCollected) bench_heapCollectedFrames++;
+
+					// Include the GPU's work in the frame time.
+					glFinish();
+
+					bench_frameTimes[benchFrame] = (pacingNow() - frameStart) * 1000.0;
+					benchFrame++;
+
+					if (benchFrame == bench_frameCount) {
+						inLoop = 0;
+					}
 				}
 			}
 
-			// Wait and loop.
-			SDL_Delay(2);
+			// Wait for the game to be ready.
+			if (!game_ready) {
+				SDL_Delay(2);
+			}
+		}
+
+		if (benchmarking && benchFrame > 0) {
+			if (!benchWriteResults(benchFrame, benchDelta)) {
+				quitError = "write benchmark results";
+				return -1;
+			}
+		}
+
+		if (profiler_outPath) {
+			if (!profilerWriteTrace(profiler_outPath)) {
+				quitError = "write profiler trace";
+				return -1;
+			}
 		}
 
 		return 0;
 	}
 
 	int main(int argc, char** argv) {
+		readRuntimeArguments(argc, argv);
+
+		// Headless runs prefer SDL's offscreen video driver (EGL, e.g. Mesa software rendering) and silent audio.
+		// The SDL_VIDEODRIVER and SDL_AUDIODRIVER environment variables take priority over these hints.
+		if (game_headless) {
+			SDL_SetHint(SDL_HINT_VIDEODRIVER, "offscreen");
+			SDL_SetHint(SDL_HINT_AUDIODRIVER, "dummy");
+		}
+
 		// Init SDL.
-		if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_AUDIO) < 0) {
+		int initResult = SDL_Init(SDL_INIT_VIDEO | SDL_INIT_AUDIO);
+
+		if (initResult < 0 && game_headless) {
+			// Offscreen driver may not be available, fallback to a hidden window.
+			SDL_SetHint(SDL_HINT_VIDEODRIVER, NULL);
+			initResult = SDL_Init(SDL_INIT_VIDEO | SDL_INIT_AUDIO);
+		}
+
+		if (initResult < 0) {
 			printf("ERR SDL_Init %s", SDL_GetError());
 		} else {
 			int code = mainWithSDL(argc, argv);
@@ -5285,11 +10686,7 @@ const char* wren_resolveModule(WrenVM* vm, const char* importer, const char* nam
 	void sock_new_buffer(void* data, uint32_t length) {
 		wrenEnsureSlots(vm, 1);
 
-		if (handle_Buffer) {
-			wrenSetSlotHandle(vm, 0, handle_Buffer);
-		} else {
-			handle_Buffer = wrenGetVariableHandle("sock", "Buffer");
-		}
+		buffer_putClassHandle(vm);
 
 		Buffer* buffer = (Buffer*)wrenSetSlotNewForeign(vm, 0, 0, sizeof(Buffer));
 
@@ -0,0 +1,124 @@
+// Skyline rect packer, shared by the runtime's sprite atlases and sock-bake, so baked pages are
+// packed exactly like the runtime packs its own.
+//
+// The skyline is the top edge of the packed rects, left to right, covering the whole width. Each rect
+// is placed at the lowest point it fits, and the space under the skyline isn't reclaimed.
+
+#ifndef SOCK_SKYLINE_H
+#define SOCK_SKYLINE_H
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+	int x;
+	int y;
+	int width;
+} SkylineNode;
+
+typedef struct {
+	// Width and height of the area packed into.
+	int size;
+	SkylineNode* nodes;
+	int nodeCount;
+	int nodeCapacity;
+} Skyline;
+
+// Starts an empty [size] x [size] skyline. Returns false on allocation failure.
+static bool skylineInit(Skyline* sky, int size) {
+	sky->nodeCapacity = 16;
+	sky->nodes = malloc(sky->nodeCapacity * sizeof(SkylineNode));
+	if (!sky->nodes) return false;
+
+	sky->size = size;
+	sky->nodes[0].x = 0;
+	sky->nodes[0].y = 0;
+	sky->nodes[0].width = size;
+	sky->nodeCount = 1;
+
+	return true;
+}
+
+// Returns the y a [width] x [height] rect would be placed at if its left edge is at node [index],
+// or -1 if it doesn't fit there.
+static int skylineFit(const Skyline* sky, int index, int width, int height) {
+	if (sky->nodes[index].x + width > sky->size) return -1;
+
+	int y = 0;
+	for (int i = index, remaining = width; remaining > 0; i++) {
+		if (sky->nodes[i].y > y) y = sky->nodes[i].y;
+		if (y + height > sky->size) return -1;
+		remaining -= sky->nodes[i].width;
+	}
+
+	return y;
+}
+
+// Finds the lowest place a [width] x [height] rect fits and raises the skyline over it.
+// Returns false if the area is too full, or on allocation failure.
+static bool skylineInsert(Skyline* sky, int width, int height, int* x, int* y) {
+	int bestIndex = -1;
+	int bestY = sky->size;
+	int bestWidth = 0;
+
+	for (int i = 0; i < sky->nodeCount; i++) {
+		int fitY = skylineFit(sky, i, width, height);
+
+		if (fitY >= 0 && (fitY < bestY || (fitY == bestY && sky->nodes[i].width < bestWidth))) {
+			bestIndex = i;
+			bestY = fitY;
+			bestWidth = sky->nodes[i].width;
+		}
+	}
+
+	if (bestIndex < 0) return false;
+
+	if (sky->nodeCount == sky->nodeCapacity) {
+		int capacity = sky->nodeCapacity * 2;
+		SkylineNode* nodes = realloc(sky->nodes, capacity * sizeof(SkylineNode));
+		if (!nodes) return false;
+		sky->nodes = nodes;
+		sky->nodeCapacity = capacity;
+	}
+
+	*x = sky->nodes[bestIndex].x;
+	*y = bestY;
+
+	SkylineNode* nodes = sky->nodes;
+	memmove(nodes + bestIndex + 1, nodes + bestIndex, (sky->nodeCount - bestIndex) * sizeof(SkylineNode));
+	nodes[bestIndex].x = *x;
+	nodes[bestIndex].y = bestY + height;
+	nodes[bestIndex].width = width;
+	sky->nodeCount++;
+
+	// Trim the nodes now under the new one.
+	int i = bestIndex + 1;
+	while (i < sky->nodeCount) {
+		int overlap = nodes[i - 1].x + nodes[i - 1].width - nodes[i].x;
+		if (overlap <= 0) break;
+
+		if (overlap < nodes[i].width) {
+			nodes[i].x += overlap;
+			nodes[i].width -= overlap;
+			break;
+		}
+
+		memmove(nodes + i, nodes + i + 1, (sky->nodeCount - i - 1) * sizeof(SkylineNode));
+		sky->nodeCount--;
+	}
+
+	// Merge neighbours at the same height.
+	for (i = 0; i < sky->nodeCount - 1; i++) {
+		if (nodes[i].y == nodes[i + 1].y) {
+			nodes[i].width += nodes[i + 1].width;
+			memmove(nodes + i + 1, nodes + i + 2, (sky->nodeCount - i - 2) * sizeof(SkylineNode));
+			sky->nodeCount--;
+			i--;
+		}
+	}
+
+	return true;
+}
+
+#endif